@@ -20,6 +20,7 @@ namespace std { using std::tr1::unordered_map; using std::tr1::unordered_set; }
 #include <boost/functional/hash.hpp>
 
 #include "node_state_hash.h"
+#include "parallel_for.h"
 #include "verbose.h"
 #include "hg.h"
 #include "ff.h"
@@ -90,7 +91,10 @@ struct Candidate {
                            const ModelSet& models,
                            const bool is_goal) {
     const Hypergraph::Edge& in_edge = *in_edge_;
-    out_edge_.rule_ = in_edge.rule_;
+    // a non-owning pointer (no reference counting): in_edge keeps the rule
+    // alive, and only candidates that are added to the output hypergraph
+    // get a counted reference (see IncorporateIntoPlusLMForest)
+    out_edge_.rule_ = TRulePtr(TRulePtr(), in_edge.rule_.get());
     out_edge_.feature_values_ = in_edge.feature_values_;
     out_edge_.i_ = in_edge.i_;
     out_edge_.j_ = in_edge.j_;
@@ -168,6 +172,18 @@ struct CandidateUniquenessEquals {
 typedef unordered_set<const Candidate*, CandidateUniquenessHash, CandidateUniquenessEquals> UniqueCandidateSet;
 typedef unordered_map<FFState, Candidate*, boost::hash<FFState> > State2Node;
 
+// the +LM nodes and edges derived from one node of the -LM forest, in the
+// order they were found; they are numbered from 0 (in Candidate::node_index_)
+// until they are added to the +LM forest by MergeIntoPlusLMForest
+struct PlusLMNodes {
+  vector<pair<Candidate*, int> > edges;  // popped candidate, its node
+  FFStates states;                       // state of each node
+  vector<size_t> hashes;                 // hash of each node
+  CandidateList freelist;                // candidates recombined with
+                                         // another one (the edges still
+                                         // refer to them)
+};
+
 class CubePruningRescorer {
 
 public:
@@ -176,15 +192,21 @@ public:
                       const Hypergraph& i,
                       int pop_limit,
                       Hypergraph* o,
-                      int s = NORMAL_CP ) :
+                      int s = NORMAL_CP,
+                      unsigned threads = 1) :
       models(m),
       smeta(sm),
       in(i),
       out(*o),
       D(in.nodes_.size()),
       pop_limit_(pop_limit),
-      strategy_(s){
-    if (!SILENT) cerr << "  Applying feature functions (cube pruning, pop_limit = " << pop_limit_ << ')' << endl;
+      strategy_(s),
+      threads_(threads) {
+    if (!SILENT) {
+      cerr << "  Applying feature functions (cube pruning, pop_limit = " << pop_limit_;
+      if (threads_ > 1) cerr << ", " << threads_ << " threads";
+      cerr << ')' << endl;
+    }
     node_states_.reserve(kRESERVE_NUM_NODES);
   }
 
@@ -195,20 +217,18 @@ public:
     int pregoal = goal_id - 1;
     assert(in.nodes_[pregoal].out_edges_.size() == 1);
     if (!SILENT) cerr << "    ";
-    int has = 0;
-    for (int i = 0; i < in.nodes_.size(); ++i) {
-      if (!SILENT) {
-        int needs = (50 * i / in.nodes_.size());
-        while (has < needs) { cerr << '.'; ++has; }
-      }
-      if (strategy_==NORMAL_CP){
-        KBest(i, i == goal_id);
-      }
-      if (strategy_==FAST_CP){
-        KBestFast(i, i == goal_id);
-      }
-      if (strategy_==FAST_CP_2){
-        KBestFast2(i, i == goal_id);
+    if (threads_ > 1) {
+      ApplyInParallel();
+    } else {
+      int has = 0;
+      PlusLMNodes nodes;
+      for (unsigned i = 0; i < in.nodes_.size(); ++i) {
+        if (!SILENT) {
+          int needs = (50 * i / in.nodes_.size());
+          while (has < needs) { cerr << '.'; ++has; }
+        }
+        ProcessNode(i, &nodes);
+        MergeIntoPlusLMForest(i, &nodes);
       }
     }
     if (!SILENT) {
@@ -221,6 +241,102 @@ public:
   }
 
  private:
+  void ProcessNode(const int vert_index, PlusLMNodes* nodes) {
+    const bool is_goal = (vert_index + 1 == static_cast<int>(in.nodes_.size()));
+    if (strategy_==NORMAL_CP){
+      KBest(vert_index, is_goal, nodes);
+    }
+    if (strategy_==FAST_CP){
+      KBestFast(vert_index, is_goal, nodes);
+    }
+    if (strategy_==FAST_CP_2){
+      KBestFast2(vert_index, is_goal, nodes);
+    }
+  }
+
+  struct ProcessNodes {
+    CubePruningRescorer* rescorer;
+    const vector<int>* ready;
+    vector<PlusLMNodes>* nodes;
+    void operator()(size_t i) const {
+      const int v = (*ready)[i];
+      rescorer->ProcessNode(v, &(*nodes)[v]);
+    }
+  };
+
+  // Nodes of the -LM forest are processed as soon as all their antecedents
+  // are in the +LM forest: in each round, all such nodes are processed at
+  // once, each into its own PlusLMNodes, and then the processed nodes are
+  // added to the +LM forest in the order of the -LM forest (up to the first
+  // node that still has to be processed), so that the result is the same as
+  // with a single thread. During a round, the +LM forest and the nodes in it
+  // are only read.
+  void ApplyInParallel() {
+    const unsigned num_nodes = in.nodes_.size();
+    vector<pair<unsigned, unsigned> > order(num_nodes);  // <nodes that must be merged first, node>
+    for (unsigned i = 0; i < num_nodes; ++i) {
+      unsigned ready_after = 0;
+      const vector<int>& in_edges = in.nodes_[i].in_edges_;
+      for (unsigned j = 0; j < in_edges.size(); ++j) {
+        const Hypergraph::TailNodeVector& tail = in.edges_[in_edges[j]].tail_nodes_;
+        for (unsigned k = 0; k < tail.size(); ++k)
+          ready_after = max<unsigned>(ready_after, tail[k] + 1);
+      }
+      order[i] = make_pair(ready_after, i);
+    }
+    sort(order.begin(), order.end());
+    vector<PlusLMNodes> nodes(num_nodes);
+    vector<bool> done(num_nodes, false);
+    vector<int> ready;
+    unsigned merged = 0;
+    unsigned next = 0;
+    unsigned has = 0;
+    while (merged < num_nodes) {
+      ready.clear();
+      for (; next < num_nodes && order[next].first <= merged; ++next)
+        ready.push_back(order[next].second);
+      ProcessNodes process = { this, &ready, &nodes };
+      ParallelFor(ready.size(), threads_, process);
+      for (unsigned i = 0; i < ready.size(); ++i)
+        done[ready[i]] = true;
+      for (; merged < num_nodes && done[merged]; ++merged) {
+        MergeIntoPlusLMForest(merged, &nodes[merged]);
+        nodes[merged] = PlusLMNodes();
+      }
+      if (!SILENT) {
+        const unsigned needs = 50 * merged / num_nodes;
+        while (has < needs) { cerr << '.'; ++has; }
+      }
+    }
+  }
+
+  // adds the +LM nodes and edges derived from node vert_index to the +LM forest
+  void MergeIntoPlusLMForest(const int vert_index, PlusLMNodes* nodes) {
+    const int first_node = out.nodes_.size();
+    const WordID cat = in.nodes_[vert_index].cat_;
+    for (unsigned i = 0; i < nodes->states.size(); ++i) {
+      Hypergraph::Node* new_node = out.AddNode(cat);
+      new_node->node_hash = nodes->hashes[i];
+      node_states_.push_back(nodes->states[i]);
+    }
+    for (unsigned i = 0; i < nodes->edges.size(); ++i) {
+      const Candidate* item = nodes->edges[i].first;
+      Hypergraph::Edge* new_edge = out.AddEdge(item->out_edge_);
+      new_edge->edge_prob_ = item->out_edge_.edge_prob_;
+      new_edge->rule_ = item->in_edge_->rule_;
+      out.ConnectEdgeToHeadNode(new_edge, first_node + nodes->edges[i].second);
+    }
+    CandidateList& D_v = D[vert_index];
+    for (unsigned i = 0; i < D_v.size(); ++i)
+      D_v[i]->node_index_ += first_node;
+    for (unsigned i = 0; i < nodes->freelist.size(); ++i)
+      delete nodes->freelist[i];
+    nodes->edges.clear();
+    nodes->states.clear();
+    nodes->hashes.clear();
+    nodes->freelist.clear();
+  }
+
   void FreeAll() {
     for (int i = 0; i < D.size(); ++i) {
       CandidateList& D_i = D[i];
@@ -230,10 +346,7 @@ public:
     D.clear();
   }
 
-  void IncorporateIntoPlusLMForest(size_t head_node_hash, Candidate* item, State2Node* s2n, CandidateList* freelist) {
-    Hypergraph::Edge* new_edge = out.AddEdge(item->out_edge_);
-    new_edge->edge_prob_ = item->out_edge_.edge_prob_;
-
+  void IncorporateIntoPlusLMForest(size_t head_node_hash, Candidate* item, State2Node* s2n, PlusLMNodes* nodes) {
     Candidate** o_item_ptr = nullptr;
     if (item->state_.size() && models.NeedsStateErasure()) {
       // When erasure of certain state bytes is needed, we must make a copy of
@@ -251,25 +364,19 @@ public:
 
     int& node_id = o_item->node_index_;
     if (node_id < 0) {
-      Hypergraph::Node* new_node = out.AddNode(in.nodes_[item->in_edge_->head_node_].cat_);
-      new_node->node_hash = cdec::HashNode(head_node_hash, item->state_); // ID is combination of existing state + residual state
-      node_states_.push_back(item->state_);
-      node_id = new_node->id_;
-    }
-#if 0
-    Hypergraph::Node* node = &out.nodes_[node_id];
-    out.ConnectEdgeToHeadNode(new_edge, node);
-#else
-    out.ConnectEdgeToHeadNode(new_edge, node_id);
-#endif
+      node_id = nodes->states.size();
+      nodes->states.push_back(item->state_);
+      nodes->hashes.push_back(cdec::HashNode(head_node_hash, item->state_)); // ID is combination of existing state + residual state
+    }
+    nodes->edges.push_back(make_pair(item, node_id));
     // update candidate if we have a better derivation
     // note: the difference between the vit score and the estimated
     // score is the same for all items with a common residual DP
     // state
     if (item->vit_prob_ > o_item->vit_prob_) {
       if (item->state_.size() && models.NeedsStateErasure()) {
-        // node_states_ should still point to the unerased state.
-        node_states_[o_item->node_index_] = item->state_;
+        // the node's state should still be the unerased state.
+        nodes->states[o_item->node_index_] = item->state_;
         // sanity check!
         FFState item_state(item->state_), o_item_state(o_item->state_);
         models.EraseIgnoredBytes(&item_state);
@@ -282,10 +389,10 @@ public:
       o_item->est_prob_ = item->est_prob_;
       o_item->vit_prob_ = item->vit_prob_;
     }
-    if (item != o_item) freelist->push_back(item);
+    if (item != o_item) nodes->freelist.push_back(item);
   }
 
-  void KBest(const int vert_index, const bool is_goal) {
+  void KBest(const int vert_index, const bool is_goal, PlusLMNodes* nodes) {
     // cerr << "KBest(" << vert_index << ")\n";
     CandidateList& D_v = D[vert_index];
     assert(D_v.empty());
@@ -293,7 +400,6 @@ public:
     // cerr << "  has " << v.in_edges_.size() << " in-coming edges\n";
     const vector<int>& in_edges = v.in_edges_;
     CandidateHeap cand;
-    CandidateList freelist;
     cand.reserve(in_edges.size());
     UniqueCandidateSet unique_cands;
     for (int i = 0; i < in_edges.size(); ++i) {
@@ -313,7 +419,7 @@ public:
       cand.pop_back();
       // cerr << "POPPED: " << *item << endl;
       PushSucc(*item, is_goal, &cand, &unique_cands);
-      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, &freelist);
+      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, nodes);
       ++pops;
     }
     D_v.resize(state2node.size());
@@ -325,13 +431,11 @@ public:
 
     for (int i = 0; i < cand.size(); ++i)
       delete cand[i];
-    // freelist is necessary since even after an item merged, it still stays in
-    // the unique set so it can't be deleted til now
-    for (int i = 0; i < freelist.size(); ++i)
-      delete freelist[i];
+    // the items merged into others (nodes->freelist) are deleted when the
+    // nodes are added to the +LM forest
   }
 
-  void KBestFast(const int vert_index, const bool is_goal) {
+  void KBestFast(const int vert_index, const bool is_goal, PlusLMNodes* nodes) {
     // cerr << "KBest(" << vert_index << ")\n";
     CandidateList& D_v = D[vert_index];
     assert(D_v.empty());
@@ -339,7 +443,6 @@ public:
     // cerr << " has " << v.in_edges_.size() << " in-coming edges\n";
     const vector<int>& in_edges = v.in_edges_;
     CandidateHeap cand;
-    CandidateList freelist;
     cand.reserve(in_edges.size());
     //init with j<0,0> for all rules-edges that lead to node-(NT-span)
     for (int i = 0; i < in_edges.size(); ++i) {
@@ -358,7 +461,7 @@ public:
       // cerr << "POPPED: " << *item << endl;
 
       PushSuccFast(*item, is_goal, &cand);
-      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, &freelist);
+      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, nodes);
       ++pops;
     }
     D_v.resize(state2node.size());
@@ -378,13 +481,11 @@ public:
 
     for (int i = 0; i < cand.size(); ++i)
       delete cand[i];
-    // freelist is necessary since even after an item merged, it still stays in
-    // the unique set so it can't be deleted til now
-    for (int i = 0; i < freelist.size(); ++i)
-      delete freelist[i];
+    // the items merged into others (nodes->freelist) are deleted when the
+    // nodes are added to the +LM forest
   }
 
-  void KBestFast2(const int vert_index, const bool is_goal) {
+  void KBestFast2(const int vert_index, const bool is_goal, PlusLMNodes* nodes) {
     // cerr << "KBest(" << vert_index << ")\n";
     CandidateList& D_v = D[vert_index];
     assert(D_v.empty());
@@ -392,7 +493,6 @@ public:
     // cerr << " has " << v.in_edges_.size() << " in-coming edges\n";
     const vector<int>& in_edges = v.in_edges_;
     CandidateHeap cand;
-    CandidateList freelist;
     cand.reserve(in_edges.size());
     UniqueCandidateSet unique_accepted;
     //init with j<0,0> for all rules-edges that lead to node-(NT-span)
@@ -414,7 +514,7 @@ public:
       // cerr << "POPPED: " << *item << endl;
 
       PushSuccFast2(*item, is_goal, &cand, &unique_accepted);
-      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, &freelist);
+      IncorporateIntoPlusLMForest(v.node_hash, item, &state2node, nodes);
       ++pops;
     }
     D_v.resize(state2node.size());
@@ -434,10 +534,8 @@ public:
 
     for (int i = 0; i < cand.size(); ++i)
       delete cand[i];
-    // freelist is necessary since even after an item merged, it still stays in
-    // the unique set so it can't be deleted til now
-    for (int i = 0; i < freelist.size(); ++i)
-      delete freelist[i];
+    // the items merged into others (nodes->freelist) are deleted when the
+    // nodes are added to the +LM forest
   }
 
   void PushSucc(const Candidate& item, const bool is_goal, CandidateHeap* pcand, UniqueCandidateSet* cs) {
@@ -518,6 +616,7 @@ public:
                              // its q function value?
   const int pop_limit_;
   const int strategy_;       //switch Cube Pruning strategy: 1 normal, 2 fast (alg 2), 3 fast_2 (alg 3). (see: Gesmundo A., Henderson J,. Faster Cube Pruning, IWSLT 2010)
+  const unsigned threads_;
 };
 
 struct NoPruningRescorer {
@@ -633,16 +732,25 @@ void ApplyModelSet(const Hypergraph& in,
       pl = max_pl_for_large;
       cerr << "  Note: reducing pop_limit to " << pl << " for very large forest\n";
     }
+    unsigned threads = config.threads;
+    if (threads > 1 && !models.IsThreadSafe()) {
+      static bool warned = false;
+      if (!warned) {
+        cerr << "  Note: using one cube pruning thread, since not all feature functions are thread safe\n";
+        warned = true;
+      }
+      threads = 1;
+    }
     if      (config.algorithm == IntersectionConfiguration::CUBE) {
-      CubePruningRescorer ma(models, smeta, in, pl, out);
+      CubePruningRescorer ma(models, smeta, in, pl, out, NORMAL_CP, threads);
       ma.Apply();
     }
     else if (config.algorithm == IntersectionConfiguration::FAST_CUBE_PRUNING){
-      CubePruningRescorer ma(models, smeta, in, pl, out, FAST_CP);
+      CubePruningRescorer ma(models, smeta, in, pl, out, FAST_CP, threads);
       ma.Apply();
     }
     else if (config.algorithm == IntersectionConfiguration::FAST_CUBE_PRUNING_2){
-      CubePruningRescorer ma(models, smeta, in, pl, out, FAST_CP_2);
+      CubePruningRescorer ma(models, smeta, in, pl, out, FAST_CP_2, threads);
       ma.Apply();
     }
 
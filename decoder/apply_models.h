@@ -20,8 +20,9 @@ enum {
 
   const int algorithm; // 0 = full intersection, 1 = cube pruning
   const int pop_limit; // max number of pops off the heap at each node
-  IntersectionConfiguration(int alg, int k) : algorithm(alg), pop_limit(k) {}
-  IntersectionConfiguration(exhaustive_t /* t */) : algorithm(0), pop_limit() {}
+  const unsigned threads; // cube pruning: nodes processed at once (if the features allow it)
+  IntersectionConfiguration(int alg, int k, unsigned t = 1) : algorithm(alg), pop_limit(k), threads(t) {}
+  IntersectionConfiguration(exhaustive_t /* t */) : algorithm(0), pop_limit(), threads(1) {}
 };
 
 inline std::ostream& operator<<(std::ostream& os, const IntersectionConfiguration& c) {
@@ -4,8 +4,15 @@
 
 #include "bottom_up_parser.h"
 
+#include <algorithm>
 #include <iostream>
 #include <map>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
 
 #include "node_state_hash.h"
 #include "nt_span.h"
@@ -18,11 +25,42 @@ using namespace std;
 
 static WordID kEPS = 0;
 
+// The unary rules of a set of grammars, sorted topologically (a rule comes
+// before the rules that rewrite its LHS) and indexed by their RHS category.
+// Built once per parser, since it only depends on the grammars.
+struct UnaryRuleIndex {
+  UnaryRuleIndex(WordID goal_cat, const vector<GrammarPtr>& grammars);
+  // the unary rules that rewrite cat, in topological order
+  inline const vector<TRulePtr>* Find(WordID cat) const {
+    const unordered_map<WordID, vector<TRulePtr> >::const_iterator it = rhs2rules_.find(cat);
+    return it == rhs2rules_.end() ? NULL : &it->second;
+  }
+  bool empty() const { return rhs2rules_.empty(); }
+ private:
+  unordered_map<WordID, vector<TRulePtr> > rhs2rules_;
+};
+
+// the nodes of a chart cell by category, as a vector sorted by category
+class Cat2NodeMap {
+ public:
+  // returns the node with category cat, or -1
+  inline int find(WordID cat) const {
+    const vector<pair<WordID, int> >::const_iterator it = lower_bound(map_.begin(), map_.end(), make_pair(cat, -1));
+    return (it != map_.end() && it->first == cat) ? it->second : -1;
+  }
+  inline void insert(WordID cat, int node) {
+    map_.insert(lower_bound(map_.begin(), map_.end(), make_pair(cat, -1)), make_pair(cat, node));
+  }
+ private:
+  vector<pair<WordID, int> > map_;
+};
+
 class ActiveChart;
 class PassiveChart {
  public:
   PassiveChart(const string& goal,
                const vector<GrammarPtr>& grammars,
+               const UnaryRuleIndex& unaries,
                const Lattice& input,
                Hypergraph* forest);
   ~PassiveChart();
@@ -47,19 +85,17 @@ class PassiveChart {
                  const SparseVector<double>& lattice_feats);
 
   void ApplyUnaryRules(const int i, const int j);
-  void TopoSortUnaries();
 
   const vector<GrammarPtr>& grammars_;
   const Lattice& input_;
   Hypergraph* forest_;
   Array2D<vector<int> > chart_;   // chart_(i,j) is the list of nodes derived spanning i,j
-  typedef map<int, int> Cat2NodeMap;
   Array2D<Cat2NodeMap> nodemap_;
   vector<ActiveChart*> act_chart_;
   const WordID goal_cat_;    // category that is being searched for at [0,n]
   TRulePtr goal_rule_;
   int goal_idx_;             // index of goal node, if found
-  vector<TRulePtr> unaries_; // topologically sorted list of unary rules from all grammars
+  const UnaryRuleIndex& unaries_;
 
   static WordID kGOAL;       // [Goal]
 };
@@ -152,6 +188,7 @@ class ActiveChart {
 
 PassiveChart::PassiveChart(const string& goal,
                            const vector<GrammarPtr>& grammars,
+                           const UnaryRuleIndex& unaries,
                            const Lattice& input,
                            Hypergraph* forest) :
     grammars_(grammars),
@@ -162,15 +199,10 @@ PassiveChart::PassiveChart(const string& goal,
     goal_cat_(TD::Convert(goal) * -1),
     goal_rule_(new TRule("[Goal] ||| [" + goal + "] ||| [1]")),
     goal_idx_(-1),
-    unaries_() {
+    unaries_(unaries) {
   act_chart_.resize(grammars_.size());
-  for (unsigned i = 0; i < grammars_.size(); ++i) {
+  for (unsigned i = 0; i < grammars_.size(); ++i)
     act_chart_[i] = new ActiveChart(forest, *this);
-    const vector<TRulePtr>& u = grammars_[i]->GetAllUnaryRules();
-    for (unsigned j = 0; j < u.size(); ++j)
-      unaries_.push_back(u[j]);
-  }
-  TopoSortUnaries();
   if (!kGOAL) kGOAL = TD::Convert("Goal") * -1;
   if (!SILENT) cerr << "  Goal category: [" << goal << ']' << endl;
 }
@@ -202,17 +234,17 @@ static bool TopoSortVisit(int node, vector<TRulePtr>& u, const map<int, vector<T
   return true;
 }
 
-void PassiveChart::TopoSortUnaries() {
-  vector<TRulePtr> u(unaries_.size()); u.clear();
+UnaryRuleIndex::UnaryRuleIndex(WordID goal_cat, const vector<GrammarPtr>& grammars) {
+  vector<TRulePtr> u;
   map<int, vector<TRulePtr> > g;
   map<int, int> mark;
-  //cerr << "GOAL=" << TD::Convert(-goal_cat_) << endl;
-  mark[goal_cat_] = 2;
-  for (unsigned i = 0; i < unaries_.size(); ++i) {
-    //cerr << "Adding: " << unaries_[i]->AsString() << endl;
-    g[unaries_[i]->f()[0]].push_back(unaries_[i]);
+  //cerr << "GOAL=" << TD::Convert(-goal_cat) << endl;
+  mark[goal_cat] = 2;
+  for (unsigned i = 0; i < grammars.size(); ++i) {
+    const vector<TRulePtr>& unaries = grammars[i]->GetAllUnaryRules();
+    for (unsigned j = 0; j < unaries.size(); ++j)
+      g[unaries[j]->f()[0]].push_back(unaries[j]);
   }
-    //m[unaries_[i]->lhs_].push_back(unaries_[i]);
   for (map<int, vector<TRulePtr> >::iterator it = g.begin(); it != g.end(); ++it) {
     //cerr << "PROC: " << TD::Convert(-it->first) << endl;
     if (mark[it->first] > 0) {
@@ -221,9 +253,8 @@ void PassiveChart::TopoSortUnaries() {
       TopoSortVisit(it->first, u, g, mark);
     }
   }
-  unaries_.clear();
   for (int i = u.size() - 1; i >= 0; --i)
-    unaries_.push_back(u[i]);
+    rhs2rules_[u[i]->f()[0]].push_back(u[i]);
 }
 
 void PassiveChart::ApplyRule(const int i,
@@ -241,11 +272,11 @@ void PassiveChart::ApplyRule(const int i,
   new_edge->feature_values_ += lattice_feats;
   Cat2NodeMap& c2n = nodemap_(i,j);
   const bool is_goal = (r->GetLHS() == kGOAL);
-  const Cat2NodeMap::iterator ni = c2n.find(r->GetLHS());
+  const int ni = c2n.find(r->GetLHS());
   Hypergraph::Node* node = NULL;
-  if (ni == c2n.end()) {
+  if (ni < 0) {
     node = forest_->AddNode(r->GetLHS());
-    c2n[r->GetLHS()] = node->id_;
+    c2n.insert(r->GetLHS(), node->id_);
     if (is_goal) {
       assert(goal_idx_ == -1);
       goal_idx_ = node->id_;
@@ -253,7 +284,7 @@ void PassiveChart::ApplyRule(const int i,
       chart_(i,j).push_back(node->id_);
     }
   } else {
-    node = &forest_->nodes_[ni->second];
+    node = &forest_->nodes_[ni];
   }
   forest_->ConnectEdgeToHeadNode(new_edge, node);
 }
@@ -272,16 +303,15 @@ void PassiveChart::ApplyRules(const int i,
 }
 
 void PassiveChart::ApplyUnaryRules(const int i, const int j) {
+  if (unaries_.empty()) return;
   const vector<int>& nodes = chart_(i,j);  // reference is important!
   for (unsigned di = 0; di < nodes.size(); ++di) {
-    const WordID cat = forest_->nodes_[nodes[di]].cat_;
-    for (unsigned ri = 0; ri < unaries_.size(); ++ri) {
-      //cerr << "At (" << i << "," << j << "): applying " << unaries_[ri]->AsString() << endl;
-      if (unaries_[ri]->f()[0] == cat) {
-        //cerr << "  --MATCH\n";
-        const Hypergraph::TailNodeVector ant(1, nodes[di]);
-        ApplyRule(i, j, unaries_[ri], ant, SparseVector<double>());  // may update nodes
-      }
+    const vector<TRulePtr>* rules = unaries_.Find(forest_->nodes_[nodes[di]].cat_);
+    if (!rules) continue;
+    for (unsigned ri = 0; ri < rules->size(); ++ri) {
+      //cerr << "At (" << i << "," << j << "): applying " << (*rules)[ri]->AsString() << endl;
+      const Hypergraph::TailNodeVector ant(1, nodes[di]);
+      ApplyRule(i, j, (*rules)[ri], ant, SparseVector<double>());  // may update nodes
     }
   }
 }
@@ -348,12 +378,27 @@ ExhaustiveBottomUpParser::ExhaustiveBottomUpParser(
     const string& goal_sym,
     const vector<GrammarPtr>& grammars) :
   goal_sym_(goal_sym),
-  grammars_(grammars) {}
+  grammars_(grammars),
+  unaries_(IndexUnaryRules(goal_sym, grammars)) {}
+
+ExhaustiveBottomUpParser::ExhaustiveBottomUpParser(
+    const string& goal_sym,
+    const vector<GrammarPtr>& grammars,
+    const boost::shared_ptr<const UnaryRuleIndex>& unaries) :
+  goal_sym_(goal_sym),
+  grammars_(grammars),
+  unaries_(unaries) {}
+
+boost::shared_ptr<const UnaryRuleIndex> ExhaustiveBottomUpParser::IndexUnaryRules(
+    const string& goal_sym,
+    const vector<GrammarPtr>& grammars) {
+  return boost::shared_ptr<const UnaryRuleIndex>(new UnaryRuleIndex(TD::Convert(goal_sym) * -1, grammars));
+}
 
 bool ExhaustiveBottomUpParser::Parse(const Lattice& input,
                                      Hypergraph* forest) const {
   kEPS = TD::Convert("*EPS*");
-  PassiveChart chart(goal_sym_, grammars_, input, forest);
+  PassiveChart chart(goal_sym_, grammars_, *unaries_, input, forest);
   const bool result = chart.Parse();
 
   if (result) {
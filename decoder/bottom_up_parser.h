@@ -4,15 +4,26 @@
 #include <vector>
 #include <string>
 
+#include <boost/shared_ptr.hpp>
+
 #include "lattice.h"
 #include "grammar.h"
 
 class Hypergraph;
+struct UnaryRuleIndex;
 
 class ExhaustiveBottomUpParser {
  public:
   ExhaustiveBottomUpParser(const std::string& goal_sym,
                            const std::vector<GrammarPtr>& grammars);
+  // unaries must index the unary rules of grammars (see IndexUnaryRules),
+  // so that parsers of the same grammars can share it
+  ExhaustiveBottomUpParser(const std::string& goal_sym,
+                           const std::vector<GrammarPtr>& grammars,
+                           const boost::shared_ptr<const UnaryRuleIndex>& unaries);
+
+  static boost::shared_ptr<const UnaryRuleIndex> IndexUnaryRules(const std::string& goal_sym,
+                                                                 const std::vector<GrammarPtr>& grammars);
 
   // returns true if goal reached spanning the full input
   // forest contains the full (i.e., unpruned) parse forest
@@ -22,6 +33,7 @@ class ExhaustiveBottomUpParser {
  private:
   const std::string goal_sym_;
   const std::vector<GrammarPtr> grammars_;
+  boost::shared_ptr<const UnaryRuleIndex> unaries_;  // of all grammars
 };
 
 #endif
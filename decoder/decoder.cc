@@ -31,6 +31,8 @@ namespace std { using std::tr1::unordered_map; }
 #include "sentence_metadata.h"
 #include "hg_intersect.h"
 #include "hg_union.h"
+#include "hg_mbr.h"
+#include "linear_bleu.h"
 
 #include "oracle_bleu.h"
 #include "apply_models.h"
@@ -44,10 +46,12 @@ namespace std { using std::tr1::unordered_map; }
 #include "sentence_metadata.h"
 #include "sampler.h"
 
+#include "forest_cache.h"
 #include "forest_writer.h" // TODO this section should probably be handled by an Observer
 #include "incremental.h"
 #include "hg_io.h"
 #include "aligner.h"
+#include "rule_lexer.h"
 
 #ifdef CP_TIME
     clock_t CpTime::time_;
@@ -64,7 +68,6 @@ namespace po = boost::program_options;
 static bool verbose_feature_functions=true;
 
 namespace Hack { void MaxTrans(const Hypergraph& in, int beam_size); }
-namespace NgramCache { void Clear(); }
 
 DecoderObserver::~DecoderObserver() {}
 void DecoderObserver::NotifyDecodingStart(const SentenceMetadata&) {}
@@ -291,6 +294,7 @@ struct DecoderImpl {
   bool kbest;
   bool unique_kbest;
   bool get_oracle_forest;
+  boost::shared_ptr<LinearBleu> mbr_bleu;  // set for --mbr output
   boost::shared_ptr<WriteFile> extract_file;
   int combine_size;
   int sent_id;
@@ -304,6 +308,7 @@ struct DecoderImpl {
   bool remove_intersected_rule_annotations;
   bool mr_mira_compat;  // Mr.MIRA compatibility mode.
   boost::scoped_ptr<IncrementalBase> incremental;
+  boost::scoped_ptr<ForestCache> first_pass_cache;
 
 
   static void ConvertSV(const SparseVector<prob_t>& src, SparseVector<double>* trg) {
@@ -336,6 +341,9 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("formalism,f",po::value<string>(),"Decoding formalism; values include SCFG, FST, PB, LexTrans (lexical translation model, also disc training), CSplit (compound splitting), Tagger (sequence labeling), LexAlign (alignment only, or EM training)")
         ("input,i",po::value<string>()->default_value("-"),"Source file")
         ("grammar,g",po::value<vector<string> >()->composing(),"Either SCFG grammar file(s) or phrase tables file(s)")
+        ("grammar_filter_input", po::value<string>(), "Only load the SCFG rules whose source terminals occur in the inputs in this file (e.g. the test set)")
+        ("grammar_filter_order", po::value<unsigned>()->default_value(3), "Check the source terminals of rules for --grammar_filter_input by their n-grams up to this order")
+        ("grammar_load_threads", po::value<unsigned>(), "Parse the lines of SCFG grammar files on this many threads (not for coarse-to-fine grammars)")
         ("per_sentence_grammar_file", po::value<string>(), "Optional (and possibly not implemented) per sentence grammar file enables all per sentence grammars to be stored in a single large file and accessed by offset")
         ("list_feature_functions,L","List available feature functions")
 #ifdef HAVE_CMPH
@@ -346,6 +354,7 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("feature_function,F",po::value<vector<string> >()->composing(), "Pass 1 additional feature function(s) (-L for list)")
         ("intersection_strategy,I",po::value<string>()->default_value("cube_pruning"), "Pass 1 intersection strategy for incorporating finite-state features; values include Cube_pruning, Full, Fast_cube_pruning, Fast_cube_pruning_2")
         ("cubepruning_pop_limit,K",po::value<unsigned>()->default_value(200), "Max number of pops from the candidate heap at each node")
+        ("cubepruning_threads",po::value<unsigned>()->default_value(1), "Run cube pruning on this many threads within a sentence (all passes; requires thread safe feature functions)")
         ("summary_feature", po::value<string>(), "Compute a 'summary feature' at the end of the pass (before any pruning) with name=arg and value=inside-outside/Z")
         ("summary_feature_type", po::value<string>()->default_value("node_risk"), "Summary feature types: node_risk, edge_risk, edge_prob")
         ("density_prune", po::value<double>(), "Pass 1 pruning: keep no more than this many times the number of edges used in the best derivation tree (>=1.0)")
@@ -388,6 +397,7 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("show_tree_structure", "Show the Viterbi derivation structure")
         ("show_expected_length", "Show the expected translation length under the model")
         ("show_partition,z", "Compute and show the partition (inside score)")
+        ("fast_log_sum_exp", "Sum probabilities in inside/outside computations with an approximation of exp() (relative error < 1e-11)")
         ("show_conditional_prob", "Output the conditional log prob to STDOUT instead of a translation")
         ("show_cfg_search_space", "Show the search space as a CFG")
         ("show_cfg_alignment_space", "Show the alignment hypergraph as a CFG")
@@ -410,6 +420,11 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("graphviz","Show (constrained) translation forest in GraphViz format")
         ("max_translation_beam,x", po::value<int>(), "Beam approximation to get max translation from the chart")
         ("max_translation_sample,X", po::value<int>(), "Sample the max translation from the chart")
+        ("mbr", "Output the linear BLEU minimum Bayes risk translation, using n-gram expectations computed from the forest (prune large forests first, e.g. with --density_prune)")
+        ("mbr_scale", po::value<double>()->default_value(1.0), "MBR: scale the model scores by this factor to compute the posterior")
+        ("mbr_unigram_precision", po::value<double>()->default_value(0.8), "MBR: linear BLEU average unigram precision")
+        ("mbr_precision_ratio", po::value<double>()->default_value(0.6), "MBR: linear BLEU ratio of successive n-gram precisions")
+        ("mbr_max_states", po::value<unsigned>()->default_value(16), "MBR: maximum number of distinct boundary word contexts kept per node")
         ("pb_max_distortion,D", po::value<int>()->default_value(4), "Phrase-based decoder: maximum distortion")
         ("cll_gradient,G","Compute conditional log-likelihood gradient and write to STDOUT (src & ref required)")
         ("get_oracle_forest,o", "Calculate rescored hypergraph using approximate BLEU scoring of rules")
@@ -417,6 +432,7 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("vector_format",po::value<string>()->default_value("b64"), "Sparse vector serialization format for feature expectations or gradients, includes (text or b64)")
         ("combine_size,C",po::value<int>()->default_value(1), "When option -G is used, process this many sentence pairs before writing the gradient (1=emit after every sentence pair)")
         ("forest_output,O",po::value<string>(),"Directory to write forests to")
+        ("cache_first_pass",po::value<string>(),"(SCFG) Reuse the first pass (-LM) forest of each input id when it is decoded again: 'memory' (at most 5000 forests, least recently used dropped first), 'memory:N' (at most N forests) or a directory, which persists across runs (clear it when the grammars change)")
         ("remove_intersected_rule_annotations", "After forced decoding is completed, remove nonterminal annotations (i.e., the source side spans)")
         ("mr_mira_compat", "Mr.MIRA compatibility mode (applies weight delta if available; outputs number of lines before k-best)");
 
@@ -518,6 +534,15 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
          << "used with csplit AND --*_prune!\n";
     exit(1);
   }
+  if (conf.count("fast_log_sum_exp")) SetFastLogSumExp(true);
+  if (conf.count("grammar_load_threads")) RuleLexer::SetThreads(conf["grammar_load_threads"].as<unsigned>());
+  if (conf.count("cache_first_pass")) {
+    if (formalism != "scfg" || conf.count("coarse_to_fine_beam_prune")) {
+      cerr << "--cache_first_pass requires --formalism scfg without coarse-to-fine parsing\n";
+      exit(1);
+    }
+    first_pass_cache.reset(new ForestCache(str("cache_first_pass",conf)));
+  }
   csplit_output_plf = conf.count("csplit_output_plf");
   if (csplit_output_plf && formalism != "csplit") {
     cerr << "--csplit_output_plf should only be used with csplit!\n";
@@ -593,7 +618,7 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         palg = 3;
         cerr << "Using Fast Cube Pruning 2 intersection (see Algorithm 3 described in: Gesmundo A., Henderson J,. Faster Cube Pruning, IWSLT 2010).\n";
       }
-      rp.inter_conf.reset(new IntersectionConfiguration(palg, pop_limit));
+      rp.inter_conf.reset(new IntersectionConfiguration(palg, pop_limit, conf["cubepruning_threads"].as<unsigned>()));
     } else {
       break;  // TODO alert user if there are any future configurations
     }
@@ -668,6 +693,9 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
   kbest = conf.count("k_best");
   unique_kbest = conf.count("unique_k_best");
   get_oracle_forest = conf.count("get_oracle_forest");
+  if (conf.count("mbr"))
+    mbr_bleu.reset(new LinearBleu(conf["mbr_unigram_precision"].as<double>(),
+                                  conf["mbr_precision_ratio"].as<double>()));
   oracle.show_derivation=conf.count("show_derivations");
   oracle.show_derivation_mask=conf["show_derivations_mask"].as<int>();
   remove_intersected_rule_annotations = conf.count("remove_intersected_rule_annotations");
@@ -725,7 +753,6 @@ static inline void ApplyWeightDelta(const string &delta_b64, vector<weight_t> *w
 
 bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
   string buf = input;
-  NgramCache::Clear();   // clear ngram cache for remote LM (if used)
   Timer::Summarize();
   ++sent_id;
   map<string, string> sgml;
@@ -763,11 +790,32 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
   smeta.sgml_.swap(sgml);
   o->NotifyDecodingStart(smeta);
   Hypergraph forest;          // -LM forest
-  translator->ProcessMarkupHints(smeta.sgml_);
+  // the first pass does not depend on the weights (without coarse-to-fine
+  // parsing), only on the input and its markup
+  string cache_key;
+  if (first_pass_cache) {
+    cache_key = to_translate;
+    for (map<string, string>::const_iterator it = smeta.sgml_.begin(); it != smeta.sgml_.end(); ++it)
+      if (it->first != "id" && it->first != "delta")
+        cache_key += " ||| " + it->first + "=" + it->second;
+  }
   Timer t("Translation");
-  const bool translation_successful =
-    translator->Translate(to_translate, &smeta, *init_weights, &forest);
-  translator->SentenceComplete();
+  bool translation_successful;
+  if (first_pass_cache && first_pass_cache->Get(sent_id, cache_key, &forest)) {
+    if (!SILENT) cerr << "  Using cached first pass forest" << endl;
+    LatticeTools::ConvertTextOrPLF(to_translate, &smeta.src_lattice_);
+    smeta.SetSourceLength(smeta.src_lattice_.size());
+    smeta.ComputeInputLatticeType();
+    forest.Reweight(*init_weights);
+    translation_successful = true;
+  } else {
+    translator->ProcessMarkupHints(smeta.sgml_);
+    translation_successful =
+      translator->Translate(to_translate, &smeta, *init_weights, &forest);
+    translator->SentenceComplete();
+    if (first_pass_cache && translation_successful)
+      first_pass_cache->Put(sent_id, cache_key, forest);
+  }
 
   if (!translation_successful) {
     if (!SILENT) { cerr << "  NO PARSE FOUND.\n"; }
@@ -978,6 +1026,13 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
       oracle.DumpKBest(sent_id, forest, conf["k_best"].as<int>(), unique_kbest,mr_mira_compat, smeta.GetSourceLength(), "-", deriv_fname);
     } else if (csplit_output_plf) {
       cout << HypergraphIO::AsPLF(forest, false) << endl;
+    } else if (mbr_bleu && !has_ref) {
+      vector<WordID> trans;
+      const double gain = HG::LinearBleuMBR(forest, *mbr_bleu,
+          conf["mbr_scale"].as<double>(), conf["mbr_max_states"].as<unsigned>(),
+          &trans);
+      if (!SILENT) cerr << "  MBR expected gain: " << gain << endl;
+      cout << TD::GetString(trans) << endl << flush;
     } else {
       if (!graphviz && !has_ref && !joshua_viz && !SILENT) {
         vector<WordID> trans;
@@ -1010,9 +1065,8 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
   SparseVector<prob_t> full_exp, ref_exp, gradient;
   double log_z = 0, log_ref_z = 0;
   if (write_gradient) {
-    const prob_t z = InsideOutside<prob_t, EdgeProb, SparseVector<prob_t>, EdgeFeaturesAndProbWeightFunction>(forest, &full_exp);
+    const prob_t z = FeatureExpectations<EdgeProb>(forest, &full_exp);
     log_z = log(z);
-    full_exp /= z;
   }
   if (conf.count("show_cfg_search_space"))
     HypergraphIO::WriteAsCFG(forest);
@@ -1063,8 +1117,7 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
       if (aligner_mode && !output_training_vector)
         AlignerTools::WriteAlignment(smeta.GetSourceLattice(), smeta.GetReference(), forest, &cout, 0 == conf.count("aligner_use_viterbi"), kbest ? conf["k_best"].as<int>() : 0);
       if (write_gradient) {
-        const prob_t ref_z = InsideOutside<prob_t, EdgeProb, SparseVector<prob_t>, EdgeFeaturesAndProbWeightFunction>(forest, &ref_exp);
-        ref_exp /= ref_z;
+        const prob_t ref_z = FeatureExpectations<EdgeProb>(forest, &ref_exp);
 //        if (crf_uniform_empirical)
 //          log_ref_z = ref_exp.dot(last_weights);
         log_ref_z = log(ref_z);
@@ -1080,9 +1133,7 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
         acc_obj += (log_z - log_ref_z);
       }
       if (feature_expectations) {
-        const prob_t z =
-          InsideOutside<prob_t, EdgeProb, SparseVector<prob_t>, EdgeFeaturesAndProbWeightFunction>(forest, &ref_exp);
-        ref_exp /= z;
+        const prob_t z = FeatureExpectations<EdgeProb>(forest, &ref_exp);
         acc_obj += log(z);
         acc_vec += ref_exp;
       }
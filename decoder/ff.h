@@ -68,6 +68,11 @@ class FeatureFunction {
   virtual void FinalTraversalFeatures(const void* residual_state,
                                       SparseVector<double>* final_features) const;
 
+  // whether TraversalFeatures and FinalTraversalFeatures may be called from
+  // several threads at once (see ApplyModelSet). Override this only if they
+  // neither modify the feature function nor convert new feature names.
+  virtual bool IsThreadSafe() const { return false; }
+
  protected:
   // context is a pointer to a buffer of size NumBytesContext() that the
   // feature function can write its state to.  It's up to the feature function
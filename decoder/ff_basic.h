@@ -11,6 +11,7 @@ class WordPenalty : public FeatureFunction {
   static std::string usage(bool p,bool d) {
     return usage_helper("WordPenalty","","number of target words (local feature)",p,d);
   }
+  virtual bool IsThreadSafe() const { return true; }
  protected:
   virtual void TraversalFeaturesImpl(const SentenceMetadata& smeta,
                                      const HG::Edge& edge,
@@ -29,6 +30,7 @@ class SourceWordPenalty : public FeatureFunction {
   static std::string usage(bool p,bool d) {
     return usage_helper("SourceWordPenalty","","number of source words (local feature, and meaningless except when input has non-constant number of source words, e.g. segmentation/morphology/speech recognition lattice)",p,d);
   }
+  virtual bool IsThreadSafe() const { return true; }
  protected:
   virtual void TraversalFeaturesImpl(const SentenceMetadata& smeta,
                                      const HG::Edge& edge,
@@ -53,6 +55,7 @@ class ArityPenalty : public FeatureFunction {
     return usage_helper("ArityPenalty","[MaxArity(default " DEFAULT_MAX_ARITY_STR ")]","Indicator feature Arity_N=1 for rule of arity N (local feature).  0<=N<=MaxArity(default " DEFAULT_MAX_ARITY_STR ")",p,d);
   }
 
+  virtual bool IsThreadSafe() const { return true; }
  protected:
   virtual void TraversalFeaturesImpl(const SentenceMetadata& smeta,
                                      const HG::Edge& edge,
@@ -11,11 +11,14 @@
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include <stdint.h>
 
 using namespace std;
 using namespace const_reorder;
 
-typedef HASH_MAP<std::string, vector<double> > MapClassifier;
+// keyed by GenerateKey(): the span of two adjacent items and their block
+// status
+typedef HASH_MAP<uint64_t, vector<double> > MapClassifier;
 
 inline bool is_inside(int i, int left, int right) {
   if (i < left || i > right) return false;
@@ -273,6 +276,9 @@ struct ConstReorderFeatureImpl {
                            &const_reorder_classifier_left_);
       InitializeClassifier((terms[0] + string(".right")).c_str(),
                            &const_reorder_classifier_right_);
+      InitializeOutcomeIds(const_reorder_classifier_left_, outcome_ids_left_);
+      InitializeOutcomeIds(const_reorder_classifier_right_,
+                           outcome_ids_right_);
     }
 
     if (b_srl_order_feature_) {
@@ -280,6 +286,10 @@ struct ConstReorderFeatureImpl {
                            &srl_reorder_classifier_left_);
       InitializeClassifier((terms[3] + string(".right")).c_str(),
                            &srl_reorder_classifier_right_);
+      InitializeOutcomeIds(srl_reorder_classifier_left_,
+                           srl_outcome_ids_left_);
+      InitializeOutcomeIds(srl_reorder_classifier_right_,
+                           srl_outcome_ids_right_);
     }
 
     parsed_tree_ = NULL;
@@ -332,6 +342,8 @@ struct ConstReorderFeatureImpl {
         // we can do the classifier "off-line"
         map_left_ = new MapClassifier();
         map_right_ = new MapClassifier();
+        HASH_MAP_EMPTY(*map_left_, ~0ULL);
+        HASH_MAP_EMPTY(*map_right_, ~0ULL);
         InitializeConstReorderClassifierOutput();
       }
     }
@@ -342,6 +354,8 @@ struct ConstReorderFeatureImpl {
       if (b_srl_order_feature_) {
         map_srl_left_ = new MapClassifier();
         map_srl_right_ = new MapClassifier();
+        HASH_MAP_EMPTY(*map_srl_left_, ~0ULL);
+        HASH_MAP_EMPTY(*map_srl_right_, ~0ULL);
         InitializeSRLReorderClassifierOutput();
       }
     }
@@ -535,22 +549,20 @@ struct ConstReorderFeatureImpl {
           if (k < vec_node.size()) continue;
 
           // they are not covered bye the same NT
-          string outcome;
-          string key;
-          GenerateKey(pred->vec_items_[j - 1]->tree_item_,
-                      pred->vec_items_[j]->tree_item_, vecBlockStatus[j - 1],
-                      vecBlockStatus[j], key);
-
-          fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j],
-                       outcome);
-          double prob = CalculateConstReorderProb(srl_reorder_classifier_left_,
+          uint64_t key = GenerateKey(pred->vec_items_[j - 1]->tree_item_,
+                                     pred->vec_items_[j]->tree_item_,
+                                     vecBlockStatus[j - 1], vecBlockStatus[j]);
+
+          int outcome =
+              fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j]);
+          double prob = CalculateConstReorderProb(srl_outcome_ids_left_,
                                                   map_srl_left_, key, outcome);
-          // printf("%s %s %f\n", ostr.str().c_str(), outcome.c_str(), prob);
+          // printf("%s %d %f\n", ostr.str().c_str(), outcome, prob);
           logprob_srl_reorder_left += log10(prob);
 
-          fnGetOutcome(vecRelativeRightPosition[j - 1],
-                       vecRelativeRightPosition[j], outcome);
-          prob = CalculateConstReorderProb(srl_reorder_classifier_right_,
+          outcome = fnGetOutcome(vecRelativeRightPosition[j - 1],
+                                 vecRelativeRightPosition[j]);
+          prob = CalculateConstReorderProb(srl_outcome_ids_right_,
                                            map_srl_right_, key, outcome);
           logprob_srl_reorder_right += log10(prob);
         }
@@ -668,22 +680,21 @@ struct ConstReorderFeatureImpl {
           if (k < vec_node.size()) continue;
 
           // they are not covered bye the same NT
-          string outcome;
-          string key;
-          GenerateKey(parent->m_vecChildren[j - 1], parent->m_vecChildren[j],
-                      vecChunkBlock[j - 1], vecChunkBlock[j], key);
-
-          fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j],
-                       outcome);
-          double prob = CalculateConstReorderProb(
-              const_reorder_classifier_left_, map_left_, key, outcome);
-          // printf("%s %s %f\n", ostr.str().c_str(), outcome.c_str(), prob);
+          uint64_t key =
+              GenerateKey(parent->m_vecChildren[j - 1], parent->m_vecChildren[j],
+                          vecChunkBlock[j - 1], vecChunkBlock[j]);
+
+          int outcome =
+              fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j]);
+          double prob = CalculateConstReorderProb(outcome_ids_left_, map_left_,
+                                                  key, outcome);
+          // printf("%s %d %f\n", ostr.str().c_str(), outcome, prob);
           logprob_const_reorder_left += log10(prob);
 
-          fnGetOutcome(vecRelativeRightPosition[j - 1],
-                       vecRelativeRightPosition[j], outcome);
-          prob = CalculateConstReorderProb(const_reorder_classifier_right_,
-                                           map_right_, key, outcome);
+          outcome = fnGetOutcome(vecRelativeRightPosition[j - 1],
+                                 vecRelativeRightPosition[j]);
+          prob = CalculateConstReorderProb(outcome_ids_right_, map_right_, key,
+                                           outcome);
           logprob_const_reorder_right += log10(prob);
         }
       }
@@ -700,54 +711,84 @@ struct ConstReorderFeatureImpl {
   }
 
  private:
-  void Byte_to_Char(unsigned char* str, int n) {
-    str[0] = (n & 255);
-    str[1] = n / 256;
-  }
-  void GenerateKey(const STreeItem* pCon1, const STreeItem* pCon2,
-                   int iBlockStatus1, int iBlockStatus2, string& key) {
+  // the outcomes of fnGetOutcome(), in the order of InitializeOutcomeIds()
+  enum {
+    kMonotone = 0,
+    kSwap,
+    kDisconMonotone,
+    kDisconSwap,
+    kNumOutcomes
+  };
+
+  uint64_t GenerateKey(const STreeItem* pCon1, const STreeItem* pCon2,
+                       int iBlockStatus1, int iBlockStatus2) {
     assert(iBlockStatus1 != 0);
     assert(iBlockStatus2 != 0);
-    unsigned char szTerm[1001];
-    Byte_to_Char(szTerm, pCon1->m_iBegin);
-    Byte_to_Char(szTerm + 2, pCon2->m_iEnd);
-    szTerm[4] = (char)iBlockStatus1;
-    szTerm[5] = (char)iBlockStatus2;
-    szTerm[6] = '\0';
-    // sprintf(szTerm, "%d|%d|%d|%d|%s|%s", pCon1->m_iBegin, pCon1->m_iEnd,
-    // pCon2->m_iBegin, pCon2->m_iEnd, strBlockStatus1.c_str(),
-    // strBlockStatus2.c_str());
-    key = string(szTerm, szTerm + 6);
+    return (static_cast<uint64_t>(pCon1->m_iBegin & 0xffff) << 32) |
+           (static_cast<uint64_t>(pCon2->m_iEnd & 0xffff) << 16) |
+           ((iBlockStatus1 & 0xff) << 8) | (iBlockStatus2 & 0xff);
+  }
+
+  /*
+   * classify every pair of block statuses of two adjacent items.
+   * the context features do not depend on the block statuses, so they are
+   * mapped to feature ids once and only the two block features vary.
+   */
+  void InitializeClassifierOutput(const Tsuruoka_Maxent* classifier,
+                                  const string& context,
+                                  const vector<string>& vecBlockFeature1,
+                                  const vector<string>& vecBlockFeature2,
+                                  const STreeItem* pCon1,
+                                  const STreeItem* pCon2, MapClassifier* map) {
+    vector<int> vecBlockId1(vecBlockFeature1.size());
+    vector<int> vecBlockId2(vecBlockFeature2.size());
+    for (size_t k = 1; k < vecBlockFeature1.size(); k++)
+      vecBlockId1[k] = classifier->fnGetFeatureId(vecBlockFeature1[k]);
+    for (size_t l = 1; l < vecBlockFeature2.size(); l++)
+      vecBlockId2[l] = classifier->fnGetFeatureId(vecBlockFeature2[l]);
+
+    vector<int> vecFeatureIds;
+    classifier->fnGetFeatureIds(context, vecFeatureIds);
+    size_t num_context = vecFeatureIds.size();
+    vecFeatureIds.resize(num_context + 2);
+
+    for (size_t k = 1; k < vecBlockId1.size(); k++) {
+      vecFeatureIds[num_context] = vecBlockId1[k];
+      for (size_t l = 1; l < vecBlockId2.size(); l++) {
+        vecFeatureIds[num_context + 1] = vecBlockId2[l];
+        classifier->fnEval(vecFeatureIds,
+                           (*map)[GenerateKey(pCon1, pCon2, k, l)]);
+      }
+    }
   }
+
   void InitializeConstReorderClassifierOutput() {
     if (!b_order_feature_) return;
     int size_block_status = dict_block_status_->max();
 
+    vector<string> vecBlockFeature1(size_block_status + 1);
+    vector<string> vecBlockFeature2(size_block_status + 1);
     for (size_t i = 0; i < focused_consts_->focus_parents_.size(); i++) {
       STreeItem* parent = focused_consts_->focus_parents_[i];
 
       for (size_t j = 1; j < parent->m_vecChildren.size(); j++) {
+        ostringstream ostr;
+        GenerateContextFeature(parsed_tree_, parent, j, ostr);
         for (size_t k = 1; k <= size_block_status; k++) {
-          for (size_t l = 1; l <= size_block_status; l++) {
-            ostringstream ostr;
-            GenerateFeature(parsed_tree_, parent, j,
-                            dict_block_status_->Convert(k),
-                            dict_block_status_->Convert(l), ostr);
-
-            string strKey;
-            GenerateKey(parent->m_vecChildren[j - 1], parent->m_vecChildren[j],
-                        k, l, strKey);
-
-            vector<double> vecOutput;
-            const_reorder_classifier_left_->fnEval(ostr.str().c_str(),
-                                                   vecOutput);
-            (*map_left_)[strKey] = vecOutput;
-
-            const_reorder_classifier_right_->fnEval(ostr.str().c_str(),
-                                                    vecOutput);
-            (*map_right_)[strKey] = vecOutput;
-          }
+          vecBlockFeature1[k] = GenerateBlockFeature(
+              "f8", parent, j, dict_block_status_->Convert(k));
+          vecBlockFeature2[k] = GenerateBlockFeature(
+              "f9", parent, j, dict_block_status_->Convert(k));
         }
+
+        const STreeItem* pCon1 = parent->m_vecChildren[j - 1];
+        const STreeItem* pCon2 = parent->m_vecChildren[j];
+        InitializeClassifierOutput(const_reorder_classifier_left_, ostr.str(),
+                                   vecBlockFeature1, vecBlockFeature2, pCon1,
+                                   pCon2, map_left_);
+        InitializeClassifierOutput(const_reorder_classifier_right_, ostr.str(),
+                                   vecBlockFeature1, vecBlockFeature2, pCon1,
+                                   pCon2, map_right_);
       }
     }
   }
@@ -756,43 +797,49 @@ struct ConstReorderFeatureImpl {
     if (!b_srl_order_feature_) return;
     int size_block_status = dict_block_status_->max();
 
+    vector<string> vecBlockFeature1(size_block_status + 1);
+    vector<string> vecBlockFeature2(size_block_status + 1);
     for (size_t i = 0; i < focused_srl_->focus_predicates_.size(); i++) {
       const FocusedPredicate* pred = focused_srl_->focus_predicates_[i];
 
       for (size_t j = 1; j < pred->vec_items_.size(); j++) {
+        ostringstream ostr;
+        SArgumentReorderModel::fnGenerateContextFeature(
+            parsed_tree_, pred->pred_, pred, j, ostr);
         for (size_t k = 1; k <= size_block_status; k++) {
-          for (size_t l = 1; l <= size_block_status; l++) {
-            ostringstream ostr;
-
-            SArgumentReorderModel::fnGenerateFeature(
-                parsed_tree_, pred->pred_, pred, j,
-                dict_block_status_->Convert(k), dict_block_status_->Convert(l),
-                ostr);
-
-            string strKey;
-            GenerateKey(pred->vec_items_[j - 1]->tree_item_,
-                        pred->vec_items_[j]->tree_item_, k, l, strKey);
-
-            vector<double> vecOutput;
-            srl_reorder_classifier_left_->fnEval(ostr.str().c_str(), vecOutput);
-            (*map_srl_left_)[strKey] = vecOutput;
-
-            srl_reorder_classifier_right_->fnEval(ostr.str().c_str(),
-                                                  vecOutput);
-            (*map_srl_right_)[strKey] = vecOutput;
-          }
+          vecBlockFeature1[k] = SArgumentReorderModel::fnGenerateBlockFeature(
+              "f10", pred, j, dict_block_status_->Convert(k));
+          vecBlockFeature2[k] = SArgumentReorderModel::fnGenerateBlockFeature(
+              "f11", pred, j, dict_block_status_->Convert(k));
         }
+
+        const STreeItem* pCon1 = pred->vec_items_[j - 1]->tree_item_;
+        const STreeItem* pCon2 = pred->vec_items_[j]->tree_item_;
+        InitializeClassifierOutput(srl_reorder_classifier_left_, ostr.str(),
+                                   vecBlockFeature1, vecBlockFeature2, pCon1,
+                                   pCon2, map_srl_left_);
+        InitializeClassifierOutput(srl_reorder_classifier_right_, ostr.str(),
+                                   vecBlockFeature1, vecBlockFeature2, pCon1,
+                                   pCon2, map_srl_right_);
       }
     }
   }
 
-  double CalculateConstReorderProb(
-      const Tsuruoka_Maxent* const_reorder_classifier, const MapClassifier* map,
-      const string& key, const string& outcome) {
+  void InitializeOutcomeIds(const Tsuruoka_Maxent* classifier,
+                            vector<int>& vecOutcomeIds) {
+    vecOutcomeIds.resize(kNumOutcomes);
+    vecOutcomeIds[kMonotone] = classifier->fnGetClassId("M");
+    vecOutcomeIds[kSwap] = classifier->fnGetClassId("S");
+    vecOutcomeIds[kDisconMonotone] = classifier->fnGetClassId("DM");
+    vecOutcomeIds[kDisconSwap] = classifier->fnGetClassId("DS");
+  }
+
+  double CalculateConstReorderProb(const vector<int>& vecOutcomeIds,
+                                   const MapClassifier* map, uint64_t key,
+                                   int outcome) {
     MapClassifier::const_iterator iter = (*map).find(key);
     assert(iter != map->end());
-    int id = const_reorder_classifier->fnGetClassId(outcome);
-    return iter->second[id];
+    return iter->second[vecOutcomeIds[outcome]];
   }
 
   void FreeSentenceVariables() {
@@ -938,25 +985,33 @@ struct ConstReorderFeatureImpl {
     }
   }
 
-  inline void fnGetOutcome(int i1, int i2, string& strOutcome) {
+  inline int fnGetOutcome(int i1, int i2) {
     assert(i1 != i2);
     if (i1 < i2) {
       if (i2 > i1 + 1)
-        strOutcome = string("DM");
+        return kDisconMonotone;
       else
-        strOutcome = string("M");
+        return kMonotone;
     } else {
       if (i1 > i2 + 1)
-        strOutcome = string("DS");
+        return kDisconSwap;
       else
-        strOutcome = string("S");
+        return kSwap;
     }
   }
 
-  // features in constituent_reorder_model.cc
-  void GenerateFeature(const SParsedTree* pTree, const STreeItem* pParent,
-                       int iPos, const string& strBlockStatus1,
-                       const string& strBlockStatus2, ostringstream& ostr) {
+  // features in constituent_reorder_model.cc; f8 and f9, the only ones that
+  // depend on the block status of the two children, come from
+  // GenerateBlockFeature()
+  string GenerateBlockFeature(const char* pszName, const STreeItem* pParent,
+                              int iPos, const string& strBlockStatus) {
+    return string(pszName) + "=" + pParent->m_vecChildren[iPos - 1]->m_pszTerm +
+           "_" + pParent->m_vecChildren[iPos]->m_pszTerm + "_" + strBlockStatus;
+  }
+
+  void GenerateContextFeature(const SParsedTree* pTree,
+                              const STreeItem* pParent, int iPos,
+                              ostringstream& ostr) {
     STreeItem* pCon1, *pCon2;
     pCon1 = pParent->m_vecChildren[iPos - 1];
     pCon2 = pParent->m_vecChildren[iPos];
@@ -1001,13 +1056,6 @@ struct ConstReorderFeatureImpl {
     // f7
     ostr << " f7=" << left_label << "_" << right_label << "_"
          << pTree->m_vecTerminals[pCon2->m_iHeadWord]->m_pszTerm;
-    // f8
-    ostr << " f8=" << left_label << "_" << right_label << "_"
-         << strBlockStatus1;
-    // f9
-    ostr << " f9=" << left_label << "_" << right_label << "_"
-         << strBlockStatus2;
-
     // f10
     ostr << " f10=" << left_label << "_" << parent_label;
     // f11
@@ -1056,6 +1104,12 @@ struct ConstReorderFeatureImpl {
   FocusedSRL* focused_srl_;
 
   Dict* dict_block_status_;
+
+  // class ids of the outcomes, indexed by fnGetOutcome()
+  vector<int> outcome_ids_left_;
+  vector<int> outcome_ids_right_;
+  vector<int> srl_outcome_ids_left_;
+  vector<int> srl_outcome_ids_right_;
 };
 
 ConstReorderFeature::ConstReorderFeature(const std::string& param) {
@@ -1108,9 +1108,26 @@ struct Tsuruoka_Maxent {
     }
     delete pmes;
   }
+  // same as above, for a context already mapped with fnGetFeatureId()
+  void fnEval(const std::vector<int>& vecFeatureIds,
+              std::vector<double>& vecOutput) const {
+    m_pModel->classify(vecFeatureIds, vecOutput);
+  }
   int fnGetClassId(const std::string& strLabel) const {
     return m_pModel->get_class_id(strLabel);
   }
+  // returns -1 for features unseen in training
+  int fnGetFeatureId(const std::string& strFeature) const {
+    return m_pModel->get_feature_id(strFeature);
+  }
+  void fnGetFeatureIds(const std::string& strContext,
+                       std::vector<int>& vecFeatureIds) const {
+    std::vector<std::string> vecContext;
+    SplitOnWhitespace(strContext, &vecContext);
+    vecFeatureIds.clear();
+    for (size_t i = 0; i < vecContext.size(); i++)
+      vecFeatureIds.push_back(m_pModel->get_feature_id(vecContext[i]));
+  }
 
  private:
   maxent::ME_Model* m_pModel;
@@ -1225,6 +1242,28 @@ struct SArgumentReorderModel {
                                 const std::string &strBlock1,
                                 const std::string &strBlock2,
                                 std::ostringstream &ostr) {
+    fnGenerateContextFeature(pTree, pPred, pPredItem, iPos, ostr);
+    // f10
+    ostr << " " << fnGenerateBlockFeature("f10", pPredItem, iPos, strBlock1);
+    // f11
+    ostr << " " << fnGenerateBlockFeature("f11", pPredItem, iPos, strBlock2);
+  }
+
+  // the f10/f11 features, the only ones that depend on the block status of
+  // the two items
+  static std::string fnGenerateBlockFeature(const char *pszName,
+                                            const SPredicateItem *pPredItem,
+                                            int iPos,
+                                            const std::string &strBlock) {
+    return std::string(pszName) + "=" + pPredItem->vec_items_[iPos - 1]->role_ +
+           "_" + pPredItem->vec_items_[iPos]->role_ + "_" + strBlock;
+  }
+
+  // all features except f10/f11
+  static void fnGenerateContextFeature(const SParsedTree *pTree,
+                                       const SPredicate *pPred,
+                                       const SPredicateItem *pPredItem,
+                                       int iPos, std::ostringstream &ostr) {
     SSRLItem *pSRLItem1 = pPredItem->vec_items_[iPos - 1];
     SSRLItem *pSRLItem2 = pPredItem->vec_items_[iPos];
     const STreeItem *pCon1 = pSRLItem1->tree_item_;
@@ -1285,10 +1324,6 @@ struct SArgumentReorderModel {
          << pTree->m_vecTerminals[pCon2->m_iHeadWord]->m_pszTerm;
     // f9
     ostr << " f9=" << left_role << "_" << right_role << "_" << pCon2->m_pszTerm;
-    // f10
-    ostr << " f10=" << left_role << "_" << right_role << "_" << strBlock1;
-    // f11
-    ostr << " f11=" << left_role << "_" << right_role << "_" << strBlock2;
     // f12
     ostr << " f12=" << left_role << "_" << predicate_term;
     ostr << " f12=" << left_role;
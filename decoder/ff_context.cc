@@ -191,7 +191,6 @@ void RuleContextFeatures::TraversalFeaturesImpl(
   // NOTE: currently, this feature function doesn't allow any label
   // macros except %y[0]. but you can look at as much of the source as you want
   const WordID y0 = rule.e_[0];
-  string y0_str = TD::Convert(y0);
 
   // start of the span in the input being labeled
   const int from_src_index = edge.i_;   
@@ -205,8 +204,7 @@ void RuleContextFeatures::TraversalFeaturesImpl(
     abort();
   }
 
-  string feature_instance = feature_template;
-  // replace token macros with actual token strings
+  key.assign(1, y0);
   for (unsigned i = 0; i < token_relative_locations.size(); ++i) {
     int loc = token_relative_locations[i];
     WordID x = loc < 0? kSOS: kEOS;
@@ -214,18 +212,25 @@ void RuleContextFeatures::TraversalFeaturesImpl(
        from_src_index + loc < current_input.size()) {
       x = current_input[from_src_index + loc];
     }
-    string x_str = TD::Convert(x);
-    ReplaceTokenMacroWithString(feature_instance, loc, x_str);
+    key.push_back(x);
+  }
+  int fid = fkeys.Find(key);
+  if (fid < 0) {
+    string feature_instance = feature_template;
+    // replace token macros with actual token strings
+    for (unsigned i = 0; i < token_relative_locations.size(); ++i) {
+      string x_str = TD::Convert(key[i + 1]);
+      ReplaceTokenMacroWithString(feature_instance, token_relative_locations[i], x_str);
+    }
+    ReplaceLabelMacroWithString(feature_instance, 0, TD::Convert(y0));
+    //   Escape makes sure the feature string doesn't have any bad
+    //     symbols that could confuse a parser somewhere
+    fid = fkeys.Insert(key, Escape(feature_instance));
   }
-    
-  ReplaceLabelMacroWithString(feature_instance, 0, y0_str);
 
   // pick a real value for this feature
   double fval = 1.0; 
 
   // add it to the feature vector
-  //   FD::Convert converts the feature string to a feature int
-  //   Escape makes sure the feature string doesn't have any bad
-  //     symbols that could confuse a parser somewhere
-  features->add_value(FD::Convert(Escape(feature_instance)), fval);
+  features->add_value(fid, fval);
 }
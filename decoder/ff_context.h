@@ -4,6 +4,7 @@
 #include <vector>
 #include <boost/xpressive/xpressive.hpp>
 #include "ff.h"
+#include "feature_key.h"
 
 using namespace boost::xpressive;
 using namespace std;
@@ -39,6 +40,9 @@ class RuleContextFeatures : public FeatureFunction {
   vector<WordID> current_input;
   WordID kSOS, kEOS;
   sregex macro_regex;
+  // instances of the template by (y0, tokens), persist across inputs
+  mutable FeatureKeyMap fkeys;
+  mutable FeatureKeyMap::Key key;
   
 };
 
@@ -156,9 +156,48 @@ class KLanguageModelImpl {
     *oovs = 0;
     *emit = 0;
     const vector<WordID>& e = rule.e();
+    const unsigned n = e.size();
+    // Map all target terminals to the LM's ids first (in reverse order, which
+    // is how KenLM expects contexts), then prefetch every n-gram that lies
+    // entirely within a run of terminals, so that the lookups made while
+    // scoring overlap their cache misses instead of stalling one at a time.
+    lm::WordIndex stack_words[kMAX_STACK_WORDS];
+    vector<lm::WordIndex> heap_words;
+    lm::WordIndex* rwords = stack_words;
+    if (n > kMAX_STACK_WORDS) {
+      heap_words.resize(n);
+      rwords = &heap_words[0];
+    }
+    const bool starts_with_sos = n && e[0] == kCDEC_SOS;
+    for (unsigned j = 0; j < n; ++j) {
+      lm::WordIndex& word = rwords[n - 1 - j];
+      if (e[j] <= 0) {
+        word = kNONTERMINAL;
+      } else if (j == 0 && starts_with_sos) {
+        word = kSOS_;
+      } else {
+        float ep = 0.f;
+        const WordID cdec_word_or_class = ClassifyWordIfNecessary(e[j], &ep);
+        if (ep) { *emit += ep; }
+        word = MapWord(cdec_word_or_class); // map to LM's id
+        if (word == 0) (*oovs) += 1.0;
+      }
+    }
+    if (n) {
+      const lm::WordIndex* rend = rwords + n;
+      for (unsigned j = starts_with_sos ? 1 : 0; j < n; ++j) {
+        const lm::WordIndex* word = &rwords[n - 1 - j];
+        if (*word == kNONTERMINAL) continue;
+        const lm::WordIndex* context_rend = word + 1;
+        while (context_rend != rend && *context_rend != kNONTERMINAL && context_rend - word < order_)
+          ++context_rend;
+        ngram_->Prefetch(word + 1, context_rend, *word);
+      }
+    }
+
     BoundaryRuleScore<Model> ruleScore(*ngram_, *static_cast<BoundaryAnnotatedState*>(remnant));
     unsigned i = 0;
-    if (e.size()) {
+    if (n) {
       if (e[i] == kCDEC_SOS) {
         ++i;
         ruleScore.BeginSentence();
@@ -167,16 +206,11 @@ class KLanguageModelImpl {
         ++i;
       }
     }
-    for (; i < e.size(); ++i) {
+    for (; i < n; ++i) {
       if (e[i] <= 0) {
         ruleScore.NonTerminal(*static_cast<const BoundaryAnnotatedState*>(ant_states[-e[i]]));
       } else {
-        float ep = 0.f;
-        const WordID cdec_word_or_class = ClassifyWordIfNecessary(e[i], &ep);
-        if (ep) { *emit += ep; }
-        const lm::WordIndex cur_word = MapWord(cdec_word_or_class); // map to LM's id
-        if (cur_word == 0) (*oovs) += 1.0;
-        ruleScore.Terminal(cur_word);
+        ruleScore.Terminal(rwords[n - 1 - i]);
       }
     }
     double ret = ruleScore.Finish();
@@ -310,6 +344,10 @@ class KLanguageModelImpl {
 
   int order_;
   vector<lm::WordIndex> cdec2klm_map_;
+  static const lm::WordIndex kNONTERMINAL = static_cast<lm::WordIndex>(-1);
+  // LookupWords keeps the LM ids of the target side of a rule (reversed) on
+  // the stack if it has at most this many words, so it can run concurrently
+  static const unsigned kMAX_STACK_WORDS = 64;
   vector<pair<WordID,float> > word2class_map_; // if this is a class-based LM,
           // .first is the word->class mapping
           // .second is the emission log probability
@@ -19,6 +19,7 @@ class KLanguageModel : public FeatureFunction {
   ~KLanguageModel();
   virtual void FinalTraversalFeatures(const void* context,
                                       SparseVector<double>* features) const;
+  virtual bool IsThreadSafe() const { return true; }
   static std::string usage(bool param,bool verbose);
  protected:
   virtual void TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -47,19 +47,13 @@ char const* usage_verbose="-n determines the name of the feature (and its weight
 
 #include "ff_lm.h"
 
-#include <sstream>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <netinet/in.h>
-#include <netdb.h>
-
 #include <boost/shared_ptr.hpp>
 #include "fast_lexical_cast.hpp"
 
 #include "tdict.h"
 #include "hg.h"
 #include "stringlib.h"
+#include "lm_client.h"
 
 using namespace std;
 
@@ -71,99 +65,6 @@ string LanguageModel::usage(bool param,bool verbose) {
 #include <boost/shared_ptr.hpp>
 using namespace boost;
 
-namespace NgramCache {
-  struct Cache {
-    map<WordID, Cache> tree;
-    float prob;
-    Cache() : prob() {}
-  };
-  static Cache cache_;
-  void Clear() { cache_.tree.clear(); }
-}
-
-struct LMClient {
-
-  LMClient(string hostname) : port(6666) {
-    char const* host=hostname.c_str();
-    strcpy(request_buffer, "prob ");
-    s = const_cast<char*>(strchr(host, ':'));  // TODO fix const_cast
-    if (s != NULL) {
-      *s = '\0';
-      ++s;
-      port = atoi(s);
-    }
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    hp = gethostbyname(host);
-    if (hp == NULL) {
-      cerr << "unknown host " << host << endl;
-      abort();
-    }
-    bzero((char *)&server, sizeof(server));
-    bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
-    server.sin_family = hp->h_addrtype;
-    server.sin_port = htons(port);
-
-    int errors = 0;
-    while (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
-      cerr << "Error: connect()\n";
-      sleep(1);
-      errors++;
-      if (errors > 3) exit(1);
-    }
-    cerr << "Connected to LM on " << host << " on port " << port << endl;
-  }
-
-  float wordProb(int word, WordID const* context) {
-    NgramCache::Cache* cur = &NgramCache::cache_;
-    int i = 0;
-    while (context[i] > 0) {
-      cur = &cur->tree[context[i++]];
-    }
-    cur = &cur->tree[word];
-    if (cur->prob) { return cur->prob; }
-
-    i = 0;
-    int pos = TD::AppendString(word, 5, 16000, request_buffer);
-    while (context[i] > 0) {
-      assert(pos < 15995);
-      request_buffer[pos] = ' ';
-      ++pos;
-      pos = TD::AppendString(context[i], pos, 16000, request_buffer);
-      ++i;
-    }
-    assert(pos < 15999);
-    request_buffer[pos] = '\n';
-    ++pos;
-    request_buffer[pos] = 0;
-    write(sock, request_buffer, pos);
-    int r = read(sock, res, 6);
-    int errors = 0;
-    int cnt = 0;
-    while (1) {
-      if (r < 0) {
-        errors++; sleep(1);
-        cerr << "Error: read()\n";
-        if (errors > 5) exit(1);
-      } else if (r==0 || res[cnt] == '\n') { break; }
-      else {
-        cnt += r;
-        if (cnt==6) break;
-        read(sock, &res[cnt], 6-cnt);
-      }
-    }
-    cur->prob = *reinterpret_cast<float*>(res);
-    return cur->prob;
-  }
-
- private:
-  int sock, port;
-  char *s;
-  struct hostent *hp;
-  struct sockaddr_in server;
-  char res[8];
-  char request_buffer[16000];
-};
-
 class LanguageModelImpl : public LanguageModelInterface {
   void init(int order) {
     //all these used to be const members, but that has no performance implication, and now there's less duplication.
@@ -220,12 +121,32 @@ class LanguageModelImpl : public LanguageModelInterface {
     return -100;
   }
 
-  inline double LookupProbForBufferContents(int i) {
-//    int k = i; cerr << "P("; while(buffer_[k] > 0) { std::cerr << TD::Convert(buffer_[k++]) << " "; }
-    double p = WordProb(buffer_[i], &buffer_[i+1]);
-    if (p < floor_) p = floor_;
-//    cerr << ")=" << p << endl;
-    return p;
+  // probs[k] = WordProb(queries[k][0], queries[k] + 1); ClientLMI answers
+  // the whole batch in one round trip when its server is batched (lmb://)
+  virtual void WordProbs(const vector<const WordID*>& queries, vector<double>* probs) {
+    probs->resize(queries.size());
+    for (unsigned k = 0; k < queries.size(); ++k)
+      (*probs)[k] = WordProb(queries[k][0], queries[k] + 1);
+  }
+
+  // the n-gram starting at buffer_[i] is scored by the next SumLookups()
+  inline void LookupProbForBufferContents(int i) {
+    lookups_.push_back(&buffer_[i]);
+  }
+
+  // sum of the (floored) probabilities of the pending lookups, in the order
+  // they were requested
+  double SumLookups() {
+    if (lookups_.empty()) return 0.0;
+    WordProbs(lookups_, &probs_);
+    double sum = 0.0;
+    for (unsigned k = 0; k < probs_.size(); ++k) {
+      double p = probs_[k];
+      if (p < floor_) p = floor_;
+      sum += p;
+    }
+    lookups_.clear();
+    return sum;
   }
 
   string DebugStateToString(const void* state) const {
@@ -243,7 +164,6 @@ class LanguageModelImpl : public LanguageModelInterface {
   inline double ProbNoRemnant(int i, int len) {
     int edge = len;
     bool flag = true;
-    double sum = 0.0;
     while (i >= 0) {
       if (buffer_[i] == kSTAR) {
         edge = i;
@@ -253,11 +173,11 @@ class LanguageModelImpl : public LanguageModelInterface {
         flag = true;
       } else {
         if ((edge-i >= order_) || (flag && !(i == (len-1) && buffer_[i] == kSTART)))
-          sum += LookupProbForBufferContents(i);
+          LookupProbForBufferContents(i);
       }
       --i;
     }
-    return sum;
+    return SumLookups();
   }
 
   double EstimateProb(const vector<WordID>& phrase) {
@@ -366,7 +286,6 @@ class LanguageModelImpl : public LanguageModelInterface {
       }
     }
 
-    double sum = 0.0;
     int* remnant = reinterpret_cast<int*>(vstate);
     int j = 0;
     i = len - 1;
@@ -376,12 +295,13 @@ class LanguageModelImpl : public LanguageModelInterface {
       if (buffer_[i] == kSTAR) {
         edge = i;
       } else if (edge-i >= order_) {
-        sum += LookupProbForBufferContents(i);
+        LookupProbForBufferContents(i);
       } else if (edge == len && remnant) {
         remnant[j++] = buffer_[i];
       }
       --i;
     }
+    const double sum = SumLookups();
     if (!remnant) return sum;
 
     if (edge != len || len >= order_) {
@@ -407,6 +327,8 @@ public:
 
  protected:
   vector<WordID> buffer_;
+  vector<const WordID*> lookups_;  // pending n-grams (pointers into buffer_)
+  vector<double> probs_;
   int order_;
   int state_size_;
  public:
@@ -419,11 +341,16 @@ public:
 };
 
 struct ClientLMI : public LanguageModelImpl {
-  ClientLMI(int order,string const& server) : LanguageModelImpl(order), client_(server)
+  ClientLMI(int order,string const& server,bool batched) : LanguageModelImpl(order), client_(server, batched)
   {}
 
   virtual double WordProb(int word, WordID const* context) {
-    return client_.wordProb(word, context);
+    return client_.WordProb(word, context);
+  }
+  virtual void WordProbs(const vector<const WordID*>& queries, vector<double>* probs) {
+    fprobs_.resize(queries.size());
+    client_.WordProbs(queries, &fprobs_[0]);
+    probs->assign(fprobs_.begin(), fprobs_.end());
   }
   virtual int ContextSize(WordID const* const, int len) {
     return len;
@@ -434,12 +361,15 @@ struct ClientLMI : public LanguageModelImpl {
 
 protected:
   LMClient client_;
+  vector<float> fprobs_;
 };
 
 LanguageModelImpl *make_lm_impl(int order, string const& f, int load_order)
 {
   if (f.find("lm://") == 0) {
-    return new ClientLMI(order,f.substr(5));
+    return new ClientLMI(order,f.substr(5),false);
+  } else if (f.find("lmb://") == 0) {
+    return new ClientLMI(order,f.substr(6),true);
   } else {
     cerr << "LanguageModel no longer supports non-remote LMs. Please use KLanguageModel!\nPlease see http://cdec-decoder.org/index.php?title=Language_model_notes\n";
     abort();
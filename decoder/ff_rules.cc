@@ -25,6 +25,14 @@ namespace {
     }
     return y;
   }
+
+  // a target symbol of RuleTargetBigramFeatures is (w, 0) for a word w,
+  // (category, index + 1) for a nonterminal and (0, 0) for a rule boundary
+  string TargetSymbol(const pair<WordID, int>& sym, const vector<string>& inds, const char* boundary) {
+    if (!sym.first) return boundary;
+    if (!sym.second) return TD::Convert(sym.first);
+    return TD::Convert(sym.first) + inds[sym.second - 1];
+  }
 }
 
 RuleIdentityFeatures::RuleIdentityFeatures(const std::string& param) {
@@ -42,8 +50,18 @@ void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
                                          SparseVector<double>* estimated_features,
                                          void* context) const {
   map<const TRule*, int>::iterator it = rule2_fid_.find(edge.rule_.get());
-  if (it == rule2_fid_.end()) {
-    const TRule& rule = *edge.rule_;
+  if (it != rule2_fid_.end()) {
+    features->add_value(it->second, 1);
+    return;
+  }
+  const TRule& rule = *edge.rule_;
+  key_.clear();
+  key_.push_back(rule.lhs_);
+  key_.push_back(rule.f_.size());
+  key_.insert(key_.end(), rule.f_.begin(), rule.f_.end());
+  key_.insert(key_.end(), rule.e_.begin(), rule.e_.end());
+  int fid = fkeys_.Find(key_);
+  if (fid < 0) {
     ostringstream os;
     os << "R:";
     if (rule.lhs_ < 0) os << TD::Convert(-rule.lhs_) << ':';
@@ -64,9 +82,10 @@ void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
         os << TD::Convert(w);
       }
     }
-    it = rule2_fid_.insert(make_pair(&rule, FD::Convert(Escape(os.str())))).first;
+    fid = fkeys_.Insert(key_, Escape(os.str()));
   }
-  features->add_value(it->second, 1);
+  rule2_fid_[&rule] = fid;
+  features->add_value(fid, 1);
 }
 
 RuleSourceBigramFeatures::RuleSourceBigramFeatures(const std::string& param) {
@@ -88,22 +107,30 @@ void RuleSourceBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
     const TRule& rule = *edge.rule_;
     it = rule2_feats_.insert(make_pair(&rule, SparseVector<double>())).first;
     SparseVector<double>& f = it->second;
-    string prev = "<r>";
-    for (int i = 0; i < rule.f_.size(); ++i) {
-      WordID w = rule.f_[i];
-      if (w < 0) w = -w;
-      assert(w > 0);
-      const string& cur = TD::Convert(w);
-      ostringstream os;
-      os << "RBS:" << prev << '_' << cur;
-      const int fid = FD::Convert(Escape(os.str()));
-      if (fid <= 0) return;
-      f.add_value(fid, 1.0);
+    WordID prev = 0;  // <r>
+    for (int i = 0; i <= rule.f_.size(); ++i) {
+      WordID cur = 0;  // </r>
+      if (i < rule.f_.size()) {
+        cur = rule.f_[i];
+        if (cur < 0) cur = -cur;
+        assert(cur > 0);
+      }
+      key_.assign(1, prev);
+      key_.push_back(cur);
+      int fid = fkeys_.Find(key_);
+      if (fid < 0) {
+        ostringstream os;
+        os << "RBS:" << (prev ? TD::Convert(prev) : "<r>") << '_' << (cur ? TD::Convert(cur) : "</r>");
+        fid = fkeys_.Insert(key_, Escape(os.str()));
+      }
+      if (cur) {
+        if (fid <= 0) return;
+        f.add_value(fid, 1.0);
+      } else {
+        f.set_value(fid, 1.0);
+      }
       prev = cur;
     }
-    ostringstream os;
-    os << "RBS:" << prev << '_' << "</r>";
-    f.set_value(FD::Convert(Escape(os.str())), 1.0);
   }
   (*features) += it->second;
 }
@@ -131,29 +158,38 @@ void RuleTargetBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
     const TRule& rule = *edge.rule_;
     it = rule2_feats_.insert(make_pair(&rule, SparseVector<double>())).first;
     SparseVector<double>& f = it->second;
-    string prev = "<r>";
+    pair<WordID, int> prev_sym(0, 0);  // <r>
     vector<WordID> nt_types(rule.Arity());
     unsigned ntc = 0;
     for (int i = 0; i < rule.f_.size(); ++i)
       if (rule.f_[i] < 0) nt_types[ntc++] = -rule.f_[i];
-    for (int i = 0; i < rule.e_.size(); ++i) {
-      WordID w = rule.e_[i];
-      string cur;
-      if (w > 0) {
-        cur = TD::Convert(w);
+    for (int i = 0; i <= rule.e_.size(); ++i) {
+      pair<WordID, int> cur_sym(0, 0);  // </r>
+      if (i < rule.e_.size()) {
+        const WordID w = rule.e_[i];
+        if (w > 0)
+          cur_sym.first = w;
+        else
+          cur_sym = make_pair(nt_types[-w], 1 - w);
+      }
+      key_.assign(1, prev_sym.first);
+      key_.push_back(prev_sym.second);
+      key_.push_back(cur_sym.first);
+      key_.push_back(cur_sym.second);
+      int fid = fkeys_.Find(key_);
+      if (fid < 0) {
+        ostringstream os;
+        os << "RBT:" << TargetSymbol(prev_sym, inds, "<r>") << '_' << TargetSymbol(cur_sym, inds, "</r>");
+        fid = fkeys_.Insert(key_, Escape(os.str()));
+      }
+      if (i < rule.e_.size()) {
+        if (fid <= 0) return;
+        f.add_value(fid, 1.0);
       } else {
-        cur = TD::Convert(nt_types[-w]) + inds[-w];
+        f.set_value(fid, 1.0);
       }
-      ostringstream os;
-      os << "RBT:" << prev << '_' << cur;
-      const int fid = FD::Convert(Escape(os.str()));
-      if (fid <= 0) return;
-      f.add_value(fid, 1.0);
-      prev = cur;
+      prev_sym = cur_sym;
     }
-    ostringstream os;
-    os << "RBT:" << prev << '_' << "</r>";
-    f.set_value(FD::Convert(Escape(os.str())), 1.0);
   }
   (*features) += it->second;
 }
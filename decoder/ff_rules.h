@@ -8,6 +8,7 @@
 #include "hg.h"
 #include "array2d.h"
 #include "wordid.h"
+#include "feature_key.h"
 
 class RuleIdentityFeatures : public FeatureFunction {
  public:
@@ -22,6 +23,8 @@ class RuleIdentityFeatures : public FeatureFunction {
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
   mutable std::map<const TRule*, int> rule2_fid_;
+  mutable FeatureKeyMap fkeys_;  // persists across inputs
+  mutable FeatureKeyMap::Key key_;
 };
 
 class RuleSourceBigramFeatures : public FeatureFunction {
@@ -37,6 +40,8 @@ class RuleSourceBigramFeatures : public FeatureFunction {
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
   mutable std::map<const TRule*, SparseVector<double> > rule2_feats_;
+  mutable FeatureKeyMap fkeys_;
+  mutable FeatureKeyMap::Key key_;
 };
 
 class RuleTargetBigramFeatures : public FeatureFunction {
@@ -53,6 +58,8 @@ class RuleTargetBigramFeatures : public FeatureFunction {
  private:
   std::vector<std::string> inds;
   mutable std::map<const TRule*, SparseVector<double> > rule2_feats_;
+  mutable FeatureKeyMap fkeys_;
+  mutable FeatureKeyMap::Key key_;
 };
 
 #endif
@@ -24,18 +24,21 @@ struct SoftSyntaxFeaturesImpl {
   	//for (unsigned int i = 0; i < labels.size(); i++) { cerr << "Labels: " << labels.at(i) << endl; }
     for (unsigned int i = 0; i < labels.size(); i++) {
       string label = labels.at(i);
-      pair<string, string> feat_label;
-      feat_label.first = label.substr(0, label.size() - 1);
-      feat_label.second = label.at(label.size() - 1);
+      FeatLabel feat_label;
+      const string name = label.substr(0, label.size() - 1);
+      feat_label.cat = TD::Convert(name);
+      feat_label.type = label.at(label.size() - 1);
+      const char t = feat_label.type;
+      feat_label.fid = (t == '_' ? FD::Convert("SOFT:" + name) : 0);
+      feat_label.fid_conform = (t == '2' || t == '+' ? FD::Convert("SOFT:" + name + "_conform") : 0);
+      feat_label.fid_cross = (t == '2' || t == '-' ? FD::Convert("SOFT:" + name + "_cross") : 0);
       feat_labels.push_back(feat_label);
     }
 }
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -94,79 +97,41 @@ struct SoftSyntaxFeaturesImpl {
   WordID FireFeatures(const TRule& rule, const int i, const int j, const WordID* ants, SparseVector<double>* feats) {
     //cerr << "fire features: " << rule.AsString() << " for " << i << "," << j << endl;
     const WordID lhs = src_tree(i,j);
-	string lhs_str = TD::Convert(lhs);
-    //cerr << "LHS: " << lhs_str << " from " << i << " to " << j << endl;
-	  //cerr << "RULE :"<< rule << endl;
-    int& fid_ef = fids_ef(i,j)[&rule];
+    //cerr << "LHS: " << TD::Convert(lhs) << " from " << i << " to " << j << endl;
     for (unsigned int i = 0; i < feat_labels.size(); i++) {
-      ostringstream os;
-      string label = feat_labels.at(i).first;
-      //cerr << "This Label: " << label << endl;
-      char feat_type = (char) feat_labels.at(i).second.c_str()[0];
-      //cerr << "feat_type: " << feat_type << endl;
-      switch(feat_type) {
+      const FeatLabel& l = feat_labels[i];
+      const bool conform = (lhs == l.cat);
+      switch(l.type) {
         case '2':
-          if (lhs_str.compare(label) == 0) {
-            os << "SOFT:" << label << "_conform";
-          }
-          else {
-            os << "SOFT:" << label << "_cross";
-          }
-          fid_ef = FD::Convert(os.str());
-          if (fid_ef > 0) {
-            //cerr << "Feature :" << os.str() << endl;
-            feats->set_value(fid_ef, 1.0);
+          if (conform) {
+            if (l.fid_conform > 0) feats->set_value(l.fid_conform, 1.0);
+          } else {
+            if (l.fid_cross > 0) feats->set_value(l.fid_cross, 1.0);
           }
           break;
         case '_':
-          os << "SOFT:" << label;
-          fid_ef = FD::Convert(os.str());
-          if (lhs_str.compare(label) == 0) {
-            if (fid_ef > 0) {
-              //cerr << "Feature: " << os.str() << endl;
-              feats->set_value(fid_ef, 1.0);
-            }
-          }
-          else {
-            if (fid_ef > 0) {
-              //cerr << "Feature: " << os.str() << endl;
-              feats->set_value(fid_ef, -1.0);
-            }
-          }
+          if (l.fid > 0) feats->set_value(l.fid, conform ? 1.0 : -1.0);
           break;
         case '+':
-          if (lhs_str.compare(label) == 0) {
-            os << "SOFT:" << label << "_conform";
-            fid_ef = FD::Convert(os.str());
-            if (fid_ef > 0) {
-              //cerr << "Feature: " << os.str() << endl;
-              feats->set_value(fid_ef, 1.0);
-            }
-          }
+          if (conform && l.fid_conform > 0) feats->set_value(l.fid_conform, 1.0);
           break;
         case '-':
-          //cerr << "-" << endl;
-          if (lhs_str.compare(label) != 0) {
-            os << "SOFT:" << label << "_cross";
-            fid_ef = FD::Convert(os.str());
-            if (fid_ef > 0) {
-              //cerr << "Feature :" << os.str() << endl;
-              feats->set_value(fid_ef, 1.0);
-            }
-          }
+          if (!conform && l.fid_cross > 0) feats->set_value(l.fid_cross, 1.0);
           break;
-        os.clear();
-        os.str("");
       }
-      //cerr << "Feature: " << os.str() << endl;
-      //cerr << endl;
     }
     return lhs;
   }
 
+  // the feature ids of a label are fixed, so they are looked up only once
+  struct FeatLabel {
+    WordID cat;
+    char type;
+    int fid, fid_conform, fid_cross;
+  };
+
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
-  vector<pair<string, string> > feat_labels;
+  vector<FeatLabel> feat_labels;
 };
 
 SoftSyntaxFeatures::SoftSyntaxFeatures(const string& param) :
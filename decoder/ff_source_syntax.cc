@@ -7,6 +7,7 @@
 #include "sentence_metadata.h"
 #include "array2d.h"
 #include "filelib.h"
+#include "feature_key.h"
 
 using namespace std;
 
@@ -102,6 +103,16 @@ struct SourceSyntaxFeaturesImpl {
     //int& fid_cat = fids_cat(i,j);
     int& fid_ef = fids_ef(i,j)[&rule];
     if (fid_ef <= 0) {
+      // key: lhs, |f|, f with the categories of the antecedents, e
+      key.assign(1, lhs);
+      key.push_back(rule.f_.size());
+      unsigned ntc = 0;
+      for (unsigned k = 0; k < rule.f_.size(); ++k)
+        key.push_back(rule.f_[k] <= 0 ? -ants[ntc++] : rule.f_[k]);
+      key.insert(key.end(), rule.e_.begin(), rule.e_.end());
+      fid_ef = fkeys.Find(key);
+    }
+    if (fid_ef < 0) {
       ostringstream os;
       //ostringstream os2;
       os << "SSYN:" << TD::Convert(lhs);
@@ -127,7 +138,7 @@ struct SourceSyntaxFeaturesImpl {
         else
           os << TD::Convert(ei);
       }
-      fid_ef = FD::Convert(os.str());
+      fid_ef = fkeys.Insert(key, os.str());
     }
     if (fid_ef > 0) {
       if (feature_filter.size()>0) {
@@ -138,13 +149,14 @@ struct SourceSyntaxFeaturesImpl {
         feats->set_value(fid_ef, 1.0);
       }
     }
-    cerr << FD::Convert(fid_ef) << endl;
     return lhs;
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
   // mutable Array2D<int> fids_cat; // this tends to overfit baddly
   mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
+  FeatureKeyMap fkeys; // persists across inputs
+  FeatureKeyMap::Key key;
   unordered_set<int> feature_filter;
 };
 
@@ -191,6 +203,17 @@ struct SourceSpanSizeFeaturesImpl {
     if (rule.Arity() > 0) {
       int& fid = fids(i,j)[&rule];
       if (fid <= 0) {
+        // key: |f|, f with each nonterminal followed by the size of its span, e
+        key.assign(1, rule.f_.size());
+        unsigned ntc = 0;
+        for (unsigned k = 0; k < rule.f_.size(); ++k) {
+          key.push_back(rule.f_[k]);
+          if (rule.f_[k] <= 0) key.push_back(ants[ntc++]);
+        }
+        key.insert(key.end(), rule.e_.begin(), rule.e_.end());
+        fid = fkeys.Find(key);
+      }
+      if (fid < 0) {
         ostringstream os;
         os << "SSS:";
         unsigned ntc = 0;
@@ -212,7 +235,7 @@ struct SourceSpanSizeFeaturesImpl {
           else
             os << TD::Convert(ei);
         }
-        fid = FD::Convert(os.str());
+        fid = fkeys.Insert(key, os.str());
       }
       if (fid > 0)
         feats->set_value(fid, 1.0);
@@ -221,6 +244,8 @@ struct SourceSpanSizeFeaturesImpl {
   }
 
   mutable Array2D<map<const TRule*, int> > fids;
+  FeatureKeyMap fkeys; // persists across inputs
+  FeatureKeyMap::Key key;
 };
 
 SourceSpanSizeFeatures::SourceSpanSizeFeatures(const string& param) :
@@ -151,21 +151,18 @@ void SpanFeatures::PrepareForInput(const SentenceMetadata& smeta) {
     if (i < lattice.size())
       word = lattice[i][0].label;  // rather arbitrary for lattices
     word = MapIfNecessary(word);
-    ostringstream sfid;
-    sfid << "ES:" << TD::Convert(word);
-    end_span_ids_[i] = FD::Convert(Escape(sfid.str()));
-    ostringstream esbiid;
-    esbiid << "EBI:" << TD::Convert(bword) << "_" << TD::Convert(word);
-    end_bigram_ids_[i] = FD::Convert(Escape(esbiid.str()));
-    ostringstream bsbiid;
-    bsbiid << "BBI:" << TD::Convert(bword) << "_" << TD::Convert(word);
-    beg_bigram_ids_[i] = FD::Convert(Escape(bsbiid.str()));
-    ostringstream bfid;
-    bfid << "BS:" << TD::Convert(bword);
-    beg_span_ids_[i] = FD::Convert(Escape(bfid.str()));
     if (use_collapsed_features_) {
-      end_span_vals_[i] = feat2val_[Escape(sfid.str())] + feat2val_[Escape(esbiid.str())];
-      beg_span_vals_[i] = feat2val_[Escape(bfid.str())] + feat2val_[Escape(bsbiid.str())];
+      const string sfid = "ES:" + TD::Convert(word);
+      const string esbiid = "EBI:" + TD::Convert(bword) + "_" + TD::Convert(word);
+      const string bsbiid = "BBI:" + TD::Convert(bword) + "_" + TD::Convert(word);
+      const string bfid = "BS:" + TD::Convert(bword);
+      end_span_vals_[i] = feat2val_[Escape(sfid)] + feat2val_[Escape(esbiid)];
+      beg_span_vals_[i] = feat2val_[Escape(bfid)] + feat2val_[Escape(bsbiid)];
+    } else {
+      end_span_ids_[i] = SpanFeatureId(kEndSpan, 0, word, 0);
+      end_bigram_ids_[i] = SpanFeatureId(kEndBigram, 0, bword, word);
+      beg_bigram_ids_[i] = SpanFeatureId(kBegBigram, 0, bword, word);
+      beg_span_ids_[i] = SpanFeatureId(kBegSpan, 0, bword, 0);
     }
   }
   for (int i = 0; i <= lattice.size(); ++i) {
@@ -178,23 +175,39 @@ void SpanFeatures::PrepareForInput(const SentenceMetadata& smeta) {
       if (j < lattice.size())
         word = lattice[j][0].label;
       word = MapIfNecessary(word);
-      ostringstream pf;
-      pf << "S:" << TD::Convert(bword) << "_" << TD::Convert(word);
-      span_feats_(i,j).first = FD::Convert(Escape(pf.str()));
-      span_feats_(i,j).second = FD::Convert(Escape("S_" + pf.str()));
-      ostringstream lf;
       const unsigned span_size = (i < j ? j - i : i - j);
-      lf << "LS:" << SpanSizeTransform(span_size) << "_" << TD::Convert(bword) << "_" << TD::Convert(word);
-      len_span_feats_(i,j).first = FD::Convert(Escape(lf.str()));
-      len_span_feats_(i,j).second = FD::Convert(Escape("S_" + lf.str()));
       if (use_collapsed_features_) {
+        ostringstream pf;
+        pf << "S:" << TD::Convert(bword) << "_" << TD::Convert(word);
+        ostringstream lf;
+        lf << "LS:" << SpanSizeTransform(span_size) << "_" << TD::Convert(bword) << "_" << TD::Convert(word);
         span_vals_(i,j).first = feat2val_[Escape(pf.str())] + feat2val_[Escape(lf.str())];
         span_vals_(i,j).second = feat2val_[Escape("S_" + pf.str())] + feat2val_[Escape("S_" + lf.str())];
+      } else {
+        const int len = SpanSizeTransform(span_size);
+        span_feats_(i,j).first = SpanFeatureId(kSpan, 0, bword, word);
+        span_feats_(i,j).second = SpanFeatureId(kSSpan, 0, bword, word);
+        len_span_feats_(i,j).first = SpanFeatureId(kLenSpan, len, bword, word);
+        len_span_feats_(i,j).second = SpanFeatureId(kSLenSpan, len, bword, word);
       }
     }
   } 
 }
 
+int SpanFeatures::SpanFeatureId(SpanTemplate t, int len, WordID a, WordID b) {
+  key_.resize(4);
+  key_[0] = t; key_[1] = len; key_[2] = a; key_[3] = b;
+  const int fid = fkeys_.Find(key_);
+  if (fid >= 0) return fid;
+  static const char* prefixes[] = { "ES:", "EBI:", "BBI:", "BS:", "S:", "S_S:", "LS:", "S_LS:" };
+  ostringstream os;
+  os << prefixes[t];
+  if (t == kLenSpan || t == kSLenSpan) os << len << '_';
+  os << TD::Convert(a);
+  if (b) os << '_' << TD::Convert(b);
+  return fkeys_.Insert(key_, Escape(os.str()));
+}
+
 inline bool IsArity2RuleReordered(const TRule& rule) {
   const vector<WordID>& e = rule.e_;
   for (int i = 0; i < e.size(); ++i) {
@@ -6,6 +6,7 @@
 #include "ff.h"
 #include "array2d.h"
 #include "wordid.h"
+#include "feature_key.h"
 
 class SpanFeatures : public FeatureFunction {
  public:
@@ -20,6 +21,10 @@ class SpanFeatures : public FeatureFunction {
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
   WordID MapIfNecessary(const WordID& w) const;
+  enum SpanTemplate { kEndSpan, kEndBigram, kBegBigram, kBegSpan, kSpan, kSSpan, kLenSpan, kSLenSpan };
+  // the feature of template t for the (transformed) span length len and
+  // the words a and b (0 if the template has one word)
+  int SpanFeatureId(SpanTemplate t, int len, WordID a, WordID b);
   const int kS;
   const int kX;
   Array2D<std::pair<int,int> > span_feats_; // first for X, second for S
@@ -29,6 +34,8 @@ class SpanFeatures : public FeatureFunction {
   std::vector<int> beg_span_ids_;
   std::vector<int> beg_bigram_ids_;
   std::map<WordID, WordID> word2class_;  // optional projection to coarser class
+  FeatureKeyMap fkeys_;  // persists across inputs
+  FeatureKeyMap::Key key_;
 
   // collapsed feature values
   bool use_collapsed_features_;
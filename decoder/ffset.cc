@@ -75,6 +75,12 @@ void ModelSet::AddFinalFeatures(const FFState& state, HG::Edge* edge,SentenceMet
   edge->edge_prob_.logeq(edge->feature_values_.dot(weights_));
 }
 
+bool ModelSet::IsThreadSafe() const {
+  for (unsigned i = 0; i < models_.size(); ++i)
+    if (!models_[i]->IsThreadSafe()) return false;
+  return true;
+}
+
 bool ModelSet::NeedsStateErasure() const { return !ranges_to_erase_.empty(); }
 
 void ModelSet::EraseIgnoredBytes(FFState* state) const {
@@ -48,6 +48,9 @@ class ModelSet {
 
   bool stateless() const { return !state_size_; }
 
+  // whether every feature function is thread safe
+  bool IsThreadSafe() const;
+
   // Part of a feature state may be used for storing some side data for
   // calculating feature values but not necessary for splitting hypernodes. Such
   // bytes needs to be erased for hypernode splitting.
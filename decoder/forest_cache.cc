@@ -0,0 +1,96 @@
+#include "forest_cache.h"
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <unistd.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/string.hpp>
+
+#include "fast_lexical_cast.hpp"
+
+#include "filelib.h"
+
+using namespace std;
+
+ForestCache::ForestCache(const string& location) :
+    max_forests_(kDEFAULT_MAX_FORESTS) {
+  if (location == "memory") return;
+  if (location.compare(0, 7, "memory:") == 0) {
+    max_forests_ = boost::lexical_cast<unsigned>(location.substr(7));
+    if (max_forests_ == 0) {
+      cerr << "ForestCache: " << location << " must keep at least one forest\n";
+      abort();
+    }
+    return;
+  }
+  dir_ = location;
+  if (!DirectoryExists(dir_)) MkDirP(dir_);
+}
+
+string ForestCache::FileName(int id) const {
+  return dir_ + '/' + boost::lexical_cast<string>(id) + ".bin.gz";
+}
+
+bool ForestCache::Get(int id, const string& key, Hypergraph* forest) {
+  if (dir_.empty()) {
+    map<int, Entry>::iterator it = forests_.find(id);
+    if (it == forests_.end() || it->second.key != key) return false;
+    lru_.splice(lru_.begin(), lru_, it->second.use);
+    *forest = it->second.forest;
+    return true;
+  }
+  const string fname = FileName(id);
+  if (!FileExists(fname)) return false;
+  try {
+    ReadFile rf(fname);
+    boost::archive::binary_iarchive ia(*rf.stream());
+    string cached_key;
+    ia >> cached_key;
+    if (cached_key != key) return false;
+    forest->clear();
+    ia >> *forest;
+  } catch (const exception& e) {
+    cerr << "ForestCache: ignoring unreadable " << fname << ": " << e.what() << endl;
+    forest->clear();
+    return false;
+  }
+  return true;
+}
+
+void ForestCache::Put(int id, const string& key, const Hypergraph& forest) {
+  if (dir_.empty()) {
+    map<int, Entry>::iterator it = forests_.find(id);
+    if (it == forests_.end()) {
+      if (forests_.size() == max_forests_) {
+        forests_.erase(lru_.back());
+        lru_.pop_back();
+      }
+      lru_.push_front(id);
+      it = forests_.insert(make_pair(id, Entry())).first;
+      it->second.use = lru_.begin();
+    } else {
+      lru_.splice(lru_.begin(), lru_, it->second.use);
+    }
+    it->second.key = key;
+    it->second.forest = forest;
+    return;
+  }
+  // a reader (or a crash) never sees a partly written file
+  const string fname = FileName(id);
+  const string tmp = dir_ + "/tmp." + boost::lexical_cast<string>(getpid()) + '.' +
+                     boost::lexical_cast<string>(id) + ".bin.gz";
+  {
+    WriteFile wf(tmp);
+    boost::archive::binary_oarchive oa(*wf.stream());
+    oa << key;
+    oa << forest;
+  }
+  if (rename(tmp.c_str(), fname.c_str()) != 0) {
+    perror(("ForestCache: rename() to " + fname).c_str());
+    unlink(tmp.c_str());
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef FOREST_CACHE_H_
+#define FOREST_CACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "hg.h"
+
+// Keeps the first pass (-LM) forests of the inputs across calls to
+// Decoder::Decode, so that a tuner that decodes the same sentences with
+// different weights only reruns the weight-dependent passes. The forests are
+// kept in memory (location "memory", or "memory:N" to keep at most N
+// forests, dropping the least recently used ones) or in files <id>.bin.gz
+// under the directory location, which persist across decoder runs. Files
+// are written under a temporary name and renamed into place, and a file that
+// cannot be read is treated as a miss. Each forest is stored with a key (the
+// input); on a key mismatch the input is reparsed.
+class ForestCache {
+ public:
+  static const unsigned kDEFAULT_MAX_FORESTS = 5000;
+
+  explicit ForestCache(const std::string& location);
+
+  // returns true and sets *forest if the forest of input id with key is cached
+  bool Get(int id, const std::string& key, Hypergraph* forest);
+  void Put(int id, const std::string& key, const Hypergraph& forest);
+
+ private:
+  struct Entry {
+    std::string key;
+    Hypergraph forest;
+    std::list<int>::iterator use;  // position in lru_
+  };
+
+  std::string FileName(int id) const;
+
+  std::string dir_;  // empty if the forests are kept in memory
+  unsigned max_forests_;
+  std::map<int, Entry> forests_;
+  std::list<int> lru_;  // the ids in forests_, most recently used first
+};
+
+#endif
@@ -14,7 +14,9 @@ namespace std { using std::tr1::unordered_map; using std::tr1::unordered_set; }
 
 #include "rule_lexer.h"
 #include "filelib.h"
+#include "grammar_filter.h"
 #include "tdict.h"
+#include "verbose.h"
 
 using namespace std;
 
@@ -85,6 +87,12 @@ TextGrammar::TextGrammar(const string& file) :
   ReadFromFile(file);
 }
 
+TextGrammar::TextGrammar(const string& file, const GrammarFilter& filter) :
+    max_span_(10),
+    pimpl_(new TGImpl) {
+  ReadFromFile(file, filter);
+}
+
 TextGrammar::TextGrammar(istream* in) :
     max_span_(10),
     pimpl_(new TGImpl) {
@@ -124,6 +132,15 @@ void TextGrammar::ReadFromFile(const string& filename) {
   RuleLexer::ReadRules(in.stream(), &AddRuleHelper, filename, this);
 }
 
+void TextGrammar::ReadFromFile(const string& filename, const GrammarFilter& filter) {
+  ReadFile in(filename);
+  FilteredGrammarBuf buf(filter, in.stream());
+  istream kept(&buf);
+  // the lexer only sees the kept lines, so its line numbers count those
+  RuleLexer::ReadRules(&kept, &AddRuleHelper, filename + " (filtered; counting kept rules only)", this);
+  if (!SILENT) cerr << "  Kept " << buf.kept() << " rules matching the input " << filter.order() << "-grams\n";
+}
+
 void TextGrammar::ReadFromStream(istream* in) {
   RuleLexer::ReadRules(in, &AddRuleHelper, "UNKNOWN", this);
 }
@@ -62,15 +62,19 @@ struct Grammar {
 typedef boost::shared_ptr<Grammar> GrammarPtr;
 
 struct TGImpl;
+class GrammarFilter;
 struct TextGrammar : public Grammar {
   TextGrammar();
   explicit TextGrammar(const std::string& file);
+  // reads only the rules of file that filter keeps
+  TextGrammar(const std::string& file, const GrammarFilter& filter);
   explicit TextGrammar(std::istream* in);
   void SetMaxSpan(int m) { max_span_ = m; }
 
   virtual const GrammarIter* GetRoot() const;
   void AddRule(const TRulePtr& rule, const unsigned int ctf_level=0, const TRulePtr& coarse_parent=TRulePtr());
   void ReadFromFile(const std::string& filename);
+  void ReadFromFile(const std::string& filename, const GrammarFilter& filter);
   void ReadFromStream(std::istream* in);
   virtual bool HasRuleForSpan(int i, int j, int distance) const;
   const std::vector<TRulePtr>& GetUnaryRules(const WordID& cat) const;
@@ -0,0 +1,129 @@
+#include "grammar_filter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "lattice.h"
+#include "stringlib.h"
+#include "tdict.h"
+
+using namespace std;
+
+GrammarFilter::GrammarFilter(unsigned order) : order_(order ? order : 1) {}
+
+void GrammarFilter::AddInput(const string& line) {
+  string buf = line;
+  map<string, string> sgml;
+  ProcessAndStripSGML(&buf, &sgml);
+  string src, ref;
+  ParseTranslatorInput(buf, &src, &ref);
+  Lattice lattice;
+  LatticeTools::ConvertTextOrPLF(src, &lattice);
+  AddLattice(lattice);
+}
+
+void GrammarFilter::AddInputs(istream* in) {
+  string line;
+  while (getline(*in, line))
+    AddInput(line);
+}
+
+void GrammarFilter::AddLattice(const Lattice& lattice) {
+  string prefix;
+  for (int i = 0; i < static_cast<int>(lattice.size()); ++i) {
+    prefix.clear();
+    AddPaths(lattice, i, &prefix, 0);
+  }
+}
+
+// adds the n-grams that extend prefix (of n words) along the paths from node
+void GrammarFilter::AddPaths(const Lattice& lattice, int node, string* prefix, unsigned n) {
+  static const WordID kEPS = TD::Convert("*EPS*");
+  if (n == order_ || node >= static_cast<int>(lattice.size())) return;
+  const size_t len = prefix->size();
+  const vector<LatticeArc>& arcs = lattice[node];
+  for (unsigned i = 0; i < arcs.size(); ++i) {
+    const int next = node + arcs[i].dist2next;
+    if (arcs[i].label == kEPS) {
+      AddPaths(lattice, next, prefix, n);
+      continue;
+    }
+    if (n) *prefix += ' ';
+    *prefix += TD::Convert(arcs[i].label);
+    ngrams_.insert(*prefix);
+    AddPaths(lattice, next, prefix, n + 1);
+    prefix->resize(len);
+  }
+}
+
+bool GrammarFilter::KeepRun(const vector<Piece>& run, string* key) const {
+  const unsigned n = min<unsigned>(run.size(), order_);
+  for (unsigned b = 0; b + n <= run.size(); ++b) {
+    key->clear();
+    for (unsigned i = b; i < b + n; ++i) {
+      if (i > b) *key += ' ';
+      key->append(run[i].s, run[i].len);
+    }
+    if (!ngrams_.count(*key)) return false;
+  }
+  return true;
+}
+
+bool GrammarFilter::Keep(const string& rule, vector<Piece>* run, string* key) const {
+  size_t b = rule.find("|||");
+  if (b == string::npos) return true;  // the grammar reader reports the error
+  b += 3;
+  size_t e = rule.find("|||", b);
+  if (e == string::npos) e = rule.size();
+  const char* s = rule.data();
+  run->clear();
+  for (size_t i = b; i < e; ) {
+    while (i < e && (s[i] == ' ' || s[i] == '\t')) ++i;
+    const size_t t = i;
+    while (i < e && s[i] != ' ' && s[i] != '\t') ++i;
+    if (i == t) break;
+    if (s[t] == '[' && s[i - 1] == ']') {  // a nonterminal ends the run
+      if (!run->empty() && !KeepRun(*run, key)) return false;
+      run->clear();
+    } else {
+      Piece p = { s + t, static_cast<unsigned>(i - t) };
+      run->push_back(p);
+    }
+  }
+  return run->empty() || KeepRun(*run, key);
+}
+
+bool GrammarFilter::Keep(const string& rule) const {
+  vector<Piece> run;
+  string key;
+  return Keep(rule, &run, &key);
+}
+
+unsigned GrammarFilter::Filter(istream* in, ostream* out) const {
+  FilteredGrammarBuf buf(*this, in);
+  if (buf.sgetc() != FilteredGrammarBuf::traits_type::eof())
+    *out << &buf;
+  return buf.kept();
+}
+
+FilteredGrammarBuf::FilteredGrammarBuf(const GrammarFilter& filter, istream* in) :
+    filter_(filter), in_(in), keep_(false), kept_(0) {}
+
+FilteredGrammarBuf::int_type FilteredGrammarBuf::underflow() {
+  while (getline(*in_, line_)) {
+    if (line_.empty()) continue;
+    // the indented (finer) rules of coarse-to-fine grammars are kept with
+    // the rule they refine
+    if (line_[0] != ' ' && line_[0] != '\t')
+      keep_ = filter_.Keep(line_, &run_, &key_);
+    if (keep_) {
+      ++kept_;
+      line_ += '\n';
+      char* b = &line_[0];
+      setg(b, b, b + line_.size());
+      return traits_type::to_int_type(*b);
+    }
+  }
+  return traits_type::eof();
+}
@@ -0,0 +1,84 @@
+#ifndef GRAMMAR_FILTER_H_
+#define GRAMMAR_FILTER_H_
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#ifndef HAVE_OLD_CPP
+# include <unordered_set>
+#else
+# include <tr1/unordered_set>
+namespace std { using std::tr1::unordered_set; }
+#endif
+
+class Lattice;
+
+// Selects the rules of an SCFG grammar that can be used to translate a
+// given set of inputs (e.g. a test set), so that a large grammar can be
+// loaded for them without the rules that could never apply. A rule is kept
+// if every sequence of adjacent terminals on its source side is found in
+// the inputs, where sequences longer than order words are checked by their
+// order-grams. The check is done on the text of the rules before they are
+// parsed (it does not need to distinguish every nonterminal from a terminal
+// that looks like one, since it only errs towards keeping rules).
+class GrammarFilter {
+ public:
+  explicit GrammarFilter(unsigned order = 3);
+
+  // adds the n-grams of a decoder input (a sentence or a PLF lattice,
+  // optionally with SGML markup and ||| separated references)
+  void AddInput(const std::string& line);
+  void AddInputs(std::istream* in);
+  void AddLattice(const Lattice& lattice);
+
+  // whether the rule (a line of a grammar file) is kept
+  bool Keep(const std::string& rule) const;
+
+  // copies the lines of in that are kept to out and returns their number;
+  // the indented (finer) rules of coarse-to-fine grammars are kept with the
+  // rule they refine
+  unsigned Filter(std::istream* in, std::ostream* out) const;
+
+  unsigned order() const { return order_; }
+  // the number of distinct n-grams of the inputs
+  size_t size() const { return ngrams_.size(); }
+
+ private:
+  friend class FilteredGrammarBuf;
+  struct Piece {
+    const char* s;
+    unsigned len;
+  };
+  bool Keep(const std::string& rule, std::vector<Piece>* run, std::string* key) const;
+  bool KeepRun(const std::vector<Piece>& run, std::string* key) const;
+  void AddPaths(const Lattice& lattice, int node, std::string* prefix, unsigned n);
+
+  const unsigned order_;
+  std::unordered_set<std::string> ngrams_;
+};
+
+// A stream buffer over the lines of a grammar that a GrammarFilter keeps
+// (the lines Filter copies), which reads in one line at a time, so that a
+// grammar can be filtered while it is parsed without holding the kept
+// rules in memory as text.
+class FilteredGrammarBuf : public std::streambuf {
+ public:
+  FilteredGrammarBuf(const GrammarFilter& filter, std::istream* in);
+  // the number of lines kept so far
+  unsigned kept() const { return kept_; }
+
+ protected:
+  virtual int_type underflow();
+
+ private:
+  const GrammarFilter& filter_;
+  std::istream* in_;
+  std::vector<GrammarFilter::Piece> run_;
+  std::string key_;
+  std::string line_;  // the current kept line, with its newline
+  bool keep_;
+  unsigned kept_;
+};
+
+#endif
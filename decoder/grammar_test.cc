@@ -3,9 +3,13 @@
 #include <boost/test/floating_point_comparison.hpp>
 
 #include <cassert>
+#include <csignal>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "trule.h"
 #include "tdict.h"
 #include "grammar.h"
@@ -14,9 +18,16 @@
 #include "ff.h"
 #include "ffset.h"
 #include "weights.h"
+#include "rule_lexer.h"
+#include "grammar_filter.h"
+#include "filelib.h"
 
 using namespace std;
 
+static void AddRuleString(const TRulePtr& rule, const unsigned int, const TRulePtr&, void* extra) {
+  static_cast<vector<string>*>(extra)->push_back(rule->AsString());
+}
+
 struct GrammarTest {
   GrammarTest() {
     std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
@@ -57,5 +68,92 @@ BOOST_AUTO_TEST_CASE(TestTextGrammarFile) {
   parser.Parse(lattice, &forest);
   forest.PrintGraphviz();
 }
+
+BOOST_AUTO_TEST_CASE(TestParallelRuleReader) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  const string extra =
+    "[X] ||| [X,1] a [Y,2] ||| [2] b [X,1] ||| Foo=1.5;Bar=-2e-3 0.25 ||| 0-1 1-1\n"
+    "\n"
+    "[X] ||| [Y] [Z] ||| [2] [1] ||| 1 2 3\n"
+    "[X] ||| a ||| b ||| A=1 ||| 0-0 ||| (X a)\n"
+    "[Goal] ||| [X,1] ||| [1]\n";
+  vector<string> serial, parallel;
+  for (unsigned threads = 1; threads <= 2; ++threads) {
+    vector<string>& rules = threads == 1 ? serial : parallel;
+    RuleLexer::SetThreads(threads);
+    ReadFile rf(path + "/grammar.prune");
+    RuleLexer::ReadRules(rf.stream(), &AddRuleString, "grammar.prune", &rules);
+    istringstream in(extra);
+    RuleLexer::ReadRules(&in, &AddRuleString, "extra", &rules);
+  }
+  RuleLexer::SetThreads(1);
+  BOOST_CHECK_EQUAL(serial.size(), 200);
+  BOOST_CHECK_EQUAL(serial.size(), parallel.size());
+  for (unsigned i = 0; i < serial.size() && i < parallel.size(); ++i)
+    BOOST_CHECK_EQUAL(serial[i], parallel[i]);
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelRuleReaderError) {
+  // the lexer aborts on malformed rules, so read them in a child process
+  // and check that the error names the grammar and line
+  int fd[2];
+  BOOST_REQUIRE(pipe(fd) == 0);
+  cerr.flush();
+  const pid_t pid = fork();
+  BOOST_REQUIRE(pid >= 0);
+  if (pid == 0) {
+    close(fd[0]);
+    dup2(fd[1], 2);
+    signal(SIGABRT, SIG_DFL);  // not the test framework's handler
+    istringstream in("[X] ||| a ||| b ||| 1\n"
+                     "[X] ||| c ||| d ||| 2\n"
+                     "X ||| e ||| f ||| 3\n");
+    vector<string> rules;
+    RuleLexer::SetThreads(2);
+    RuleLexer::ReadRules(&in, &AddRuleString, "bad.grammar", &rules);
+    _exit(0);
+  }
+  close(fd[1]);
+  string err;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(fd[0], buf, sizeof(buf))) > 0) err.append(buf, n);
+  close(fd[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  BOOST_CHECK(!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+  BOOST_CHECK_MESSAGE(err.find("Grammar bad.grammar line 3:") != string::npos, err);
+}
+
+BOOST_AUTO_TEST_CASE(TestGrammarFilter) {
+  GrammarFilter f(2);
+  f.AddInput("<seg id=\"3\"> das haus ist klein </seg>");
+  f.AddInput("((('ein',0,1),('*EPS*',0,1),),(('kleines',0,1),),(('haus',0,1),),)");
+  BOOST_CHECK(f.Keep("[X] ||| das haus ist ||| the house is ||| 1"));
+  BOOST_CHECK(f.Keep("[X] ||| [X,1] haus [X,2] ||| [1] house [2]"));
+  BOOST_CHECK(f.Keep("[X] ||| [X,1] [X,2] ||| [1] [2]"));
+  BOOST_CHECK(f.Keep("[X] ||| kleines haus ||| small house"));
+  BOOST_CHECK(f.Keep("[X] ||| ein kleines [X,1] ||| a small [1]"));
+  BOOST_CHECK(!f.Keep("[X] ||| haus das ||| house the"));
+  BOOST_CHECK(!f.Keep("[X] ||| [X,1] haus ist gross ||| [1] house is big"));
+  BOOST_CHECK(!f.Keep("[X] ||| [X,1] ein haus ||| [1] a house"));
+
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  GrammarFilter ein_haus;
+  ein_haus.AddInput("ein haus");
+  Hypergraph forests[2];
+  for (int i = 0; i < 2; ++i) {
+    GrammarPtr g(i ? new TextGrammar(path + "/grammar.prune", ein_haus) : new TextGrammar(path + "/grammar.prune"));
+    vector<GrammarPtr> grammars(1, g);
+    Lattice lattice;
+    LatticeTools::ConvertTextToLattice("ein haus", &lattice);
+    ExhaustiveBottomUpParser parser("PHRASE", grammars);
+    parser.Parse(lattice, &forests[i]);
+  }
+  BOOST_CHECK_EQUAL(forests[0].nodes_.size(), forests[1].nodes_.size());
+  BOOST_CHECK_EQUAL(forests[0].edges_.size(), forests[1].edges_.size());
+  BOOST_CHECK(forests[1].edges_.size() > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
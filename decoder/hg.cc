@@ -105,17 +105,6 @@ double Hypergraph::NumberOfPaths() const {
   return Inside<double, TransitionCountWeightFunction>(*this);
 }
 
-struct ScaledTransitionEventWeightFunction {
-  typedef SparseVector<prob_t> Result;
-  ScaledTransitionEventWeightFunction(double alpha) : scale_(alpha) {}
-  inline SparseVector<prob_t> operator()(const Hypergraph::Edge& e) const {
-    SparseVector<prob_t> result;
-    result.set_value(e.id_, e.edge_prob_.pow(scale_));
-    return result;
-  }
-  const double scale_;
-};
-
 // safe to reinterpret a vector of these as a vector of prob_t (plain old data)
 struct TropicalValue {
   TropicalValue() : v_() {}
@@ -135,6 +124,10 @@ struct TropicalValue {
     v_ *= o.v_;
     return *this;
   }
+  friend inline TropicalValue operator*(TropicalValue a, const TropicalValue& b) {
+    a *= b;
+    return a;
+  }
   inline bool operator==(const TropicalValue& o) const { return v_ == o.v_; }
   prob_t v_;
 };
@@ -146,41 +139,23 @@ struct ViterbiWeightFunction {
   }
 };
 
-struct ViterbiTransitionEventWeightFunction {
-  typedef SparseVector<TropicalValue> Result;
-  inline SparseVector<TropicalValue> operator()(const Hypergraph::Edge& e) const {
-    SparseVector<TropicalValue> result;
-    result.set_value(e.id_, TropicalValue(e.edge_prob_));
-    return result;
-  }
-};
-
-
-//TODO: both Compute* methods build sparse vectors with size = whole subhypergraph, for every node.  there's no need for that.
 prob_t Hypergraph::ComputeEdgePosteriors(double scale, vector<prob_t>* posts) const {
+  posts->clear();
   const ScaledEdgeProb weight(scale);
-  const ScaledTransitionEventWeightFunction w2(scale);
-  SparseVector<prob_t> pv;
-  const prob_t inside = InsideOutside<prob_t,
-                  ScaledEdgeProb,
-                  SparseVector<prob_t>,
-                  ScaledTransitionEventWeightFunction>(*this, &pv, weight, w2);
-  posts->resize(edges_.size());
-  for (unsigned i = 0; i < edges_.size(); ++i)
-    (*posts)[i] = prob_t(pv.value(i));
+  InsideOutsides<prob_t> io;
+  const prob_t inside = io.compute(*this, weight);
+  io.compute_edge_marginals(*this, *posts, weight);
   return inside;
 }
 
 prob_t Hypergraph::ComputeBestPathThroughEdges(vector<prob_t>* post) const {
-  // I don't like this - explicitly passing around counts of each edge.  It's clever but slow.
-  SparseVector<TropicalValue> pv;
-  const TropicalValue viterbi_weight = InsideOutside<TropicalValue,
-                  ViterbiWeightFunction,
-                  SparseVector<TropicalValue>,
-                  ViterbiTransitionEventWeightFunction>(*this, &pv);
+  InsideOutsides<TropicalValue> io;
+  const TropicalValue viterbi_weight = io.compute(*this, ViterbiWeightFunction());
+  vector<TropicalValue> mm;
+  io.compute_edge_marginals(*this, mm, ViterbiWeightFunction());
   post->resize(edges_.size());
   for (unsigned i = 0; i < edges_.size(); ++i)
-    (*post)[i] = pv.value(i).v_;
+    (*post)[i] = mm[i].v_;
   return viterbi_weight.v_;
 }
 
@@ -255,6 +230,17 @@ struct EdgeExistsWeightFunction {
 };
 
 void Hypergraph::PruneEdges(const EdgeMask& prune_edge, bool run_inside_algorithm) {
+  Subset subset;
+  if (!PrunedSubset(prune_edge, run_inside_algorithm, &subset)) {
+    edges_.clear();
+    nodes_.clear();
+    nodes_.push_back(Node());
+    return;
+  }
+  ApplySubset(subset);
+}
+
+bool Hypergraph::PrunedSubset(const EdgeMask& prune_edge, bool run_inside_algorithm, Subset* subset) const {
   assert(prune_edge.size() == edges_.size());
   vector<bool> filtered = prune_edge;
 
@@ -263,10 +249,8 @@ void Hypergraph::PruneEdges(const EdgeMask& prune_edge, bool run_inside_algorith
     vector<Boolean> reachable;
     bool goal_derivable = Inside<Boolean, EdgeExistsWeightFunction>(*this, &reachable, wf);
     if (!goal_derivable) {
-      edges_.clear();
-      nodes_.clear();
-      nodes_.push_back(Node());
-      return;
+      *subset = Subset();
+      return false;
     }
 
     assert(reachable.size() == nodes_.size());
@@ -284,7 +268,8 @@ void Hypergraph::PruneEdges(const EdgeMask& prune_edge, bool run_inside_algorith
       filtered[i] = prune;
     }
   }
-  TopologicallySortNodesAndEdges(nodes_.size() - 1, &filtered);
+  TopologicalSubset(nodes_.size() - 1, &filtered, subset);
+  return true;
 }
 
 
@@ -478,13 +463,22 @@ struct IdCompare {
 };
 
 // this keeps the nodes' edge indices and edges' node indices in sync.  or do nodes not get removed when you prune_edges?  seems like they get reordered.
-//TODO: if you had parallel arrays associating data w/ each node or edge, you'd want access to reloc_node and reloc_edge - expose in stateful object?
+// parallel arrays associating data w/ each node or edge can be remapped with the Subset (see TopologicalSubset)
 void Hypergraph::TopologicallySortNodesAndEdges(int goal_index,
                                                 const vector<bool>* prune_edges) {
-  edges_topo_=true;
+  Subset subset;
+  TopologicalSubset(goal_index, prune_edges, &subset);
+  ApplySubset(subset);
+}
+
+void Hypergraph::TopologicalSubset(int goal_index,
+                                   const vector<bool>* prune_edges,
+                                   Subset* subset) const {
   // figure out which nodes are reachable from the goal
-  vector<int> reloc_node(nodes_.size(), -1);
-  vector<int> reloc_edge(edges_.size(), -1);
+  vector<int>& reloc_node = subset->node_index;
+  vector<int>& reloc_edge = subset->edge_index;
+  reloc_node.assign(nodes_.size(), -1);
+  reloc_edge.assign(edges_.size(), -1);
   vector<ColorType> color(nodes_.size(), WHITE);
   vector<DFSContext> stack;
   stack.reserve(nodes_.size());
@@ -563,6 +557,16 @@ void Hypergraph::TopologicallySortNodesAndEdges(int goal_index,
     cerr << " " << reloc_edge[i];
   cerr << endl;
 #endif
+  subset->num_nodes = node_count;
+  subset->num_edges = edge_count;
+}
+
+void Hypergraph::ApplySubset(const Subset& subset) {
+  edges_topo_=true;
+  const vector<int>& reloc_node = subset.node_index;
+  const vector<int>& reloc_edge = subset.edge_index;
+  assert(reloc_node.size() == nodes_.size());
+  assert(reloc_edge.size() == edges_.size());
   bool no_op = true;
   for (unsigned i = 0; i < reloc_node.size() && no_op; ++i)
     if (reloc_node[i] != static_cast<int>(i)) no_op = false;
@@ -602,6 +606,35 @@ void Hypergraph::TopologicallySortNodesAndEdges(int goal_index,
 #endif
 }
 
+HypergraphP Hypergraph::CreateSubset(const Subset& subset) const {
+  const vector<int>& n2 = subset.node_index;
+  const vector<int>& e2 = subset.edge_index;
+  HypergraphP ret(new Hypergraph(subset.num_nodes, subset.num_edges, is_linear_chain_));
+  for (unsigned i = 0; i < nodes_.size(); ++i) {
+    if (n2[i] < 0) continue;
+    const Node& o = nodes_[i];
+    Node& node = ret->nodes_[n2[i]];
+    node.copy_fixed(o);
+    node.id_ = n2[i];
+    for (unsigned j = 0; j < o.in_edges_.size(); ++j)
+      if (e2[o.in_edges_[j]] >= 0) node.in_edges_.push_back(e2[o.in_edges_[j]]);
+    for (unsigned j = 0; j < o.out_edges_.size(); ++j)
+      if (e2[o.out_edges_[j]] >= 0) node.out_edges_.push_back(e2[o.out_edges_[j]]);
+  }
+  for (unsigned i = 0; i < edges_.size(); ++i) {
+    if (e2[i] < 0) continue;
+    const Edge& o = edges_[i];
+    Edge& edge = ret->edges_[e2[i]];
+    edge.copy_fixed(o);
+    edge.id_ = e2[i];
+    edge.head_node_ = n2[o.head_node_];
+    edge.tail_nodes_.resize(o.tail_nodes_.size());
+    for (unsigned j = 0; j < o.tail_nodes_.size(); ++j)
+      edge.tail_nodes_[j] = n2[o.tail_nodes_[j]];
+  }
+  return ret;
+}
+
 struct EdgeWeightSorter {
   const Hypergraph& hg;
   EdgeWeightSorter(const Hypergraph& h) : hg(h) {}
@@ -192,6 +192,28 @@ namespace HG {
     }
   };
 
+  // a view of the nodes and edges that survive pruning or sorting a
+  // hypergraph, without moving or copying any of them: node_index[i]
+  // (edge_index[i]) is the position of node (edge) i in the materialized
+  // hypergraph, or -1 if it is dropped. See Hypergraph::PrunedSubset,
+  // Hypergraph::ApplySubset and Hypergraph::CreateSubset.
+  struct Subset {
+    Subset() : num_nodes(), num_edges() {}
+    std::vector<int> node_index;
+    std::vector<int> edge_index;
+    unsigned num_nodes;
+    unsigned num_edges;
+    // the original indices of the kept nodes (edges), in their new order
+    void KeptNodes(std::vector<int>* nodes) const { Invert(node_index, num_nodes, nodes); }
+    void KeptEdges(std::vector<int>* edges) const { Invert(edge_index, num_edges, edges); }
+   private:
+    static void Invert(const std::vector<int>& index, unsigned n, std::vector<int>* kept) {
+      kept->resize(n);
+      for (unsigned i = 0; i < index.size(); ++i)
+        if (index[i] >= 0) (*kept)[index[i]] = i;
+    }
+  };
+
 } // namespace HG
 
 class Hypergraph;
@@ -203,6 +225,7 @@ public:
   Hypergraph() : is_linear_chain_(false) {}
   typedef HG::Node Node;
   typedef HG::Edge Edge;
+  typedef HG::Subset Subset;
   typedef SmallVectorUnsigned TailNodeVector; // indices in nodes_
   typedef std::vector<int> EdgesVector; // indices in edges_
   enum {
@@ -450,6 +473,14 @@ public:
   // remove edges from the hypergraph if prune_edge[edge_id] is true
   // note: if run_inside_algorithm is false, then consumers may be unhappy if you pruned nodes that are built on by nodes that are kept.
   void PruneEdges(const EdgeMask& prune_edge, bool run_inside_algorithm = false);
+  // computes what PruneEdges(prune_edge, run_inside_algorithm) would keep,
+  // without changing the hypergraph. returns false if the goal node can no
+  // longer be derived (PruneEdges then leaves a single empty node)
+  bool PrunedSubset(const EdgeMask& prune_edge, bool run_inside_algorithm, Subset* subset) const;
+  // reduces the hypergraph to subset in place
+  void ApplySubset(const Subset& subset);
+  // copies only the nodes and edges in subset into a new hypergraph
+  HypergraphP CreateSubset(const Subset& subset) const;
 
   /// drop edge i if edge_margin[i] < prune_below, unless preserve_mask[i]
   void MarginPrune(EdgeProbs const& edge_margin,prob_t prune_below,EdgeMask const* preserve_mask=0,bool safe_inside=false,bool verbose=false);
@@ -519,6 +550,9 @@ public:
   // reorder nodes_ so they are in topological order
   // source nodes at 0 sink nodes at size-1
   void TopologicallySortNodesAndEdges(int goal_idx, const EdgeMask* prune_edges = NULL);
+  // the new positions of the nodes and edges after the above, which is
+  // ApplySubset of this
+  void TopologicalSubset(int goal_idx, const EdgeMask* prune_edges, Subset* subset) const;
 
   void set_ids(); // resync edge,node .id_
   void check_ids() const; // assert that .id_ have been kept in sync
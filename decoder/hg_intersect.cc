@@ -95,10 +95,18 @@ bool Intersect(const Lattice& target, Hypergraph* hg) {
   const RuleFilter filter(target, 9999);   // TODO make configurable
   for (unsigned i = 0; i < rem.size(); ++i)
     rem[i] = filter(*hg->edges_[i].rule_);
-  hg->PruneEdges(rem, true);
+  // the grammar is read off the pruned forest through a view of hg, since
+  // the pruned forest itself is thrown away once the target is parsed
+  Hypergraph::Subset pruned;
+  if (!hg->PrunedSubset(rem, true, &pruned))
+    return false;
+  const vector<int>& node_index = pruned.node_index;
+  vector<int> kept_nodes, kept_edges;
+  pruned.KeptNodes(&kept_nodes);
+  pruned.KeptEdges(&kept_edges);
 
-  const unsigned nedges = hg->edges_.size();
-  const unsigned nnodes = hg->nodes_.size();
+  const unsigned nedges = kept_edges.size();
+  const unsigned nnodes = kept_nodes.size();
 
   TextGrammar* g = new TextGrammar;
   GrammarPtr gp(g);
@@ -108,20 +116,21 @@ bool Intersect(const Lattice& target, Hypergraph* hg) {
   const string kSEP = "_";
   for (unsigned i = 0; i < nnodes; ++i) {
     string pstr = "CAT";
-    if (hg->nodes_[i].cat_ < 0)
-      pstr = TD::Convert(-hg->nodes_[i].cat_);
+    const Hypergraph::Node& node = hg->nodes_[kept_nodes[i]];
+    if (node.cat_ < 0)
+      pstr = TD::Convert(-node.cat_);
     cats[i] = TD::Convert(pstr + kSEP + lexical_cast<string>(i)) * -1;
   }
 
   // construct the grammar
   for (unsigned i = 0; i < nedges; ++i) {
-    const Hypergraph::Edge& edge = hg->edges_[i];
+    const Hypergraph::Edge& edge = hg->edges_[kept_edges[i]];
     const vector<WordID>& tgt = edge.rule_->e();
     const vector<WordID>& src = edge.rule_->f();
     TRulePtr rule(new TRule);
     rule->prev_i = edge.i_;
     rule->prev_j = edge.j_;
-    rule->lhs_ = cats[edge.head_node_];
+    rule->lhs_ = cats[node_index[edge.head_node_]];
     vector<WordID>& f = rule->f_;
     vector<WordID>& e = rule->e_;
     f.resize(tgt.size());   // swap source and target, since the parser
@@ -135,7 +144,7 @@ bool Intersect(const Lattice& target, Hypergraph* hg) {
       } else {
         tn[-cur] = -ntc;
         ++ntc;
-        f[j] = cats[edge.tail_nodes_[-cur]];
+        f[j] = cats[node_index[edge.tail_nodes_[-cur]]];
       }
     }
     ntc = 0;
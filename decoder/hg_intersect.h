@@ -5,6 +5,8 @@
 
 class Hypergraph;
 namespace HG {
+  // replaces *hg with the forest of its derivations that yield target;
+  // returns false if there are none
   bool Intersect(const Lattice& target, Hypergraph* hg);
 };
 
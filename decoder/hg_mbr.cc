@@ -0,0 +1,227 @@
+#include "hg_mbr.h"
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include "hg.h"
+#include "viterbi.h"
+#include "linear_bleu.h"
+
+using namespace std;
+
+namespace HG {
+
+namespace {
+
+// the first and last order-1 words of the yield of a derivation (both hold
+// the whole yield if it is shorter than that)
+struct Boundary {
+  vector<WordID> left;
+  vector<WordID> right;
+  bool operator==(const Boundary& other) const {
+    return left == other.left && right == other.right;
+  }
+};
+
+struct BoundaryHash {
+  size_t operator()(const Boundary& b) const {
+    size_t h = boost::hash_range(b.left.begin(), b.left.end());
+    boost::hash_combine(h, boost::hash_range(b.right.begin(), b.right.end()));
+    return h;
+  }
+};
+
+// an edge of the split forest, until its head node is created
+struct SplitEdge {
+  int edge;                 // in the input forest
+  TailNodeVector tails;     // split nodes
+  vector<int> ngrams;       // the n-grams completed by this edge
+};
+
+struct SplitState {
+  SplitState() : inside(prob_t::Zero()) {}
+  prob_t inside;
+  vector<SplitEdge> edges;
+};
+
+typedef unordered_map<Boundary, SplitState, BoundaryHash> SplitStates;
+
+bool MoreInside(SplitStates::iterator a, SplitStates::iterator b) {
+  return a->second.inside > b->second.inside;
+}
+
+// substitutes the antecedents' boundaries into the target side of rule,
+// and adds to ngrams the n-grams of order <= ctx + 1 that are completed by
+// this rule, i.e. those not contained in a single antecedent
+void ApplyRule(const TRule& rule,
+               const vector<const Boundary*>& ants,
+               const unsigned ctx,
+               Boundary* result,
+               vector<vector<WordID> >* ngrams) {
+  vector<WordID>& left = result->left;
+  vector<WordID>& right = result->right;  // the last ctx words so far
+  left.clear();
+  right.clear();
+  vector<WordID> word(1);
+  for (unsigned i = 0; i < rule.e_.size(); ++i) {
+    const WordID w = rule.e_[i];
+    const vector<WordID>* piece = &word;
+    if (w > 0)
+      word[0] = w;
+    else
+      piece = &ants[-w]->left;
+    for (unsigned j = 0; j < piece->size(); ++j) {
+      // n-grams ending at (*piece)[j] are new if they start before the piece
+      const unsigned avail = right.size() + j + 1;
+      for (unsigned m = (w > 0 ? 1 : j + 2); m <= ctx + 1 && m <= avail; ++m) {
+        ngrams->push_back(vector<WordID>(right.end() - (m - j - 1), right.end()));
+        ngrams->back().insert(ngrams->back().end(),
+                              piece->begin(), piece->begin() + j + 1);
+      }
+    }
+    for (unsigned j = 0; j < piece->size() && left.size() < ctx; ++j)
+      left.push_back((*piece)[j]);
+    if (w <= 0 && piece->size() == ctx) {
+      right = ants[-w]->right;
+    } else {
+      right.insert(right.end(), piece->begin(), piece->end());
+      if (right.size() > ctx)
+        right.erase(right.begin(), right.end() - ctx);
+    }
+  }
+}
+
+}  // namespace
+
+double LinearBleuMBR(const Hypergraph& hg,
+                     const LinearBleu& bleu,
+                     double scale,
+                     unsigned max_states,
+                     vector<WordID>* trans) {
+  const unsigned ctx = bleu.order() - 1;
+  const int goal = hg.nodes_.size() - 1;
+
+  Hypergraph split;
+  vector<Boundary> bounds;            // indexed by split node
+  vector<prob_t> inside;              // indexed by split node
+  vector<vector<int> > edge_ngrams;   // indexed by split edge
+  vector<vector<int> > states(hg.nodes_.size());  // split nodes of each node
+  unordered_map<vector<WordID>, int, boost::hash<vector<WordID> > > ngram_ids;
+  vector<unsigned> orders;            // indexed by n-gram id
+
+  vector<const Boundary*> ants;
+  vector<unsigned> pos;
+  vector<vector<WordID> > ngrams;
+  Boundary b;
+  for (int i = 0; i <= goal; ++i) {
+    const HG::Node& node = hg.nodes_[i];
+    SplitStates m;
+    for (unsigned k = 0; k < node.in_edges_.size(); ++k) {
+      const HG::Edge& edge = hg.edges_[node.in_edges_[k]];
+      const unsigned arity = edge.tail_nodes_.size();
+      bool pruned = false;
+      for (unsigned t = 0; t < arity; ++t)
+        if (states[edge.tail_nodes_[t]].empty()) pruned = true;
+      if (pruned) continue;
+
+      // all combinations of the antecedents' split nodes
+      const prob_t p = edge.edge_prob_.pow(scale);
+      ants.resize(arity);
+      pos.assign(arity, 0);
+      TailNodeVector tails(arity);
+      while (true) {
+        prob_t ip = p;
+        for (unsigned t = 0; t < arity; ++t) {
+          tails[t] = states[edge.tail_nodes_[t]][pos[t]];
+          ants[t] = &bounds[tails[t]];
+          ip *= inside[tails[t]];
+        }
+        ngrams.clear();
+        ApplyRule(*edge.rule_, ants, ctx, &b, &ngrams);
+        if (i == goal) b = Boundary();  // the goal node is not split
+
+        SplitState& state = m[b];
+        state.inside += ip;
+        state.edges.push_back(SplitEdge());
+        SplitEdge& se = state.edges.back();
+        se.edge = edge.id_;
+        se.tails = tails;
+        se.ngrams.resize(ngrams.size());
+        for (unsigned n = 0; n < ngrams.size(); ++n) {
+          int& id = ngram_ids[ngrams[n]];
+          if (!id) {
+            orders.push_back(ngrams[n].size());
+            id = orders.size();
+          }
+          se.ngrams[n] = id - 1;
+        }
+
+        unsigned t = 0;
+        for (; t < arity; ++t) {
+          if (++pos[t] < states[edge.tail_nodes_[t]].size()) break;
+          pos[t] = 0;
+        }
+        if (t == arity) break;
+      }
+    }
+
+    vector<SplitStates::iterator> kept;
+    for (SplitStates::iterator it = m.begin(); it != m.end(); ++it)
+      kept.push_back(it);
+    if (kept.size() > max_states) {
+      nth_element(kept.begin(), kept.begin() + max_states, kept.end(), MoreInside);
+      kept.resize(max_states);
+    }
+    for (unsigned k = 0; k < kept.size(); ++k) {
+      const int head = split.AddNode(node.cat_)->id_;
+      states[i].push_back(head);
+      bounds.push_back(kept[k]->first);
+      inside.push_back(kept[k]->second.inside);
+      vector<SplitEdge>& edges = kept[k]->second.edges;
+      for (unsigned e = 0; e < edges.size(); ++e) {
+        const HG::Edge& in_edge = hg.edges_[edges[e].edge];
+        HG::Edge* edge = split.AddEdge(in_edge.rule_, edges[e].tails);
+        edge->edge_prob_ = in_edge.edge_prob_;
+        edge->i_ = in_edge.i_;
+        edge->j_ = in_edge.j_;
+        split.ConnectEdgeToHeadNode(edge, head);
+        edge_ngrams.push_back(vector<int>());
+        edge_ngrams.back().swap(edges[e].ngrams);
+      }
+    }
+  }
+  if (states[goal].empty()) {
+    trans->clear();
+    return 0;
+  }
+
+  // expected n-gram counts
+  vector<prob_t> posts;
+  const prob_t z = split.ComputeEdgePosteriors(scale, &posts);
+  vector<double> expected(orders.size(), 0.0);
+  for (unsigned e = 0; e < split.edges_.size(); ++e) {
+    const double p = (posts[e] / z).as_float();
+    for (unsigned n = 0; n < edge_ngrams[e].size(); ++n)
+      expected[edge_ngrams[e][n]] += p;
+  }
+
+  // reweight every edge by the linear BLEU gain of what it adds
+  for (unsigned e = 0; e < split.edges_.size(); ++e) {
+    HG::Edge& edge = split.edges_[e];
+    double gain = bleu.theta(0) * (edge.rule_->ELength() - edge.rule_->Arity());
+    for (unsigned n = 0; n < edge_ngrams[e].size(); ++n) {
+      const int id = edge_ngrams[e][n];
+      gain += bleu.theta(orders[id]) * expected[id];
+    }
+    edge.edge_prob_.logeq(gain);
+  }
+  return log(ViterbiESentence(split, trans));
+}
+
+}  // namespace HG
@@ -0,0 +1,30 @@
+#ifndef HG_MBR_H_
+#define HG_MBR_H_
+
+#include <vector>
+#include "wordid.h"
+
+class Hypergraph;
+class LinearBleu;
+
+namespace HG {
+  // Minimum Bayes risk decoding of a forest under linear BLEU (see
+  // linear_bleu.h), in the manner of DeNero et al. (2009): the expected
+  // counts of all n-grams are computed with inside-outside and the
+  // translation maximizing the expected gain is found with Viterbi.
+  //
+  // To score the n-grams that cross rule boundaries, the nodes of hg are
+  // split by the first and last order-1 words of their yields. At most
+  // max_states such splits (those with the most inside mass) are kept per
+  // node, which makes the search approximate on large unpruned forests.
+  //
+  // Posteriors are computed from edge_prob_^scale. Returns the expected gain
+  // of the translation written to trans.
+  double LinearBleuMBR(const Hypergraph& hg,
+                       const LinearBleu& bleu,
+                       double scale,
+                       unsigned max_states,
+                       std::vector<WordID>* trans);
+};
+
+#endif
@@ -5,15 +5,23 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/vector.hpp>
+#include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdlib>
+#include <unistd.h>
 #include "tdict.h"
 
+#include "filelib.h"
+#include "forest_cache.h"
 #include "hg_intersect.h"
+#include "hg_mbr.h"
 #include "hg_union.h"
 #include "viterbi.h"
 #include "kbest.h"
 #include "inside_outside.h"
+#include "linear_bleu.h"
+#include "tree_fragment.h"
 
 #include "hg_test.h"
 
@@ -193,6 +201,36 @@ BOOST_AUTO_TEST_CASE(TestPruneEdges) {
   hg.PrintGraphviz();
 }
 
+BOOST_AUTO_TEST_CASE(TestPrunedSubset) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg;
+  CreateHG_tiny(path, &hg);
+  vector<bool> prune(hg.edges_.size(), false);
+  prune[1] = true;
+  Hypergraph::Subset subset;
+  BOOST_CHECK(hg.PrunedSubset(prune, true, &subset));
+  BOOST_CHECK_EQUAL(hg.edges_.size(), subset.edge_index.size());
+  HypergraphP copy = hg.CreateSubset(subset);
+  hg.PruneEdges(prune, true);
+  BOOST_CHECK_EQUAL(hg.nodes_.size(), subset.num_nodes);
+  BOOST_CHECK_EQUAL(hg.edges_.size(), subset.num_edges);
+  BOOST_CHECK_EQUAL(hg.nodes_.size(), copy->nodes_.size());
+  BOOST_CHECK_EQUAL(hg.edges_.size(), copy->edges_.size());
+  for (unsigned i = 0; i < hg.edges_.size(); ++i) {
+    const Hypergraph::Edge& a = hg.edges_[i];
+    const Hypergraph::Edge& b = copy->edges_[i];
+    BOOST_CHECK_EQUAL(a.rule_->AsString(), b.rule_->AsString());
+    BOOST_CHECK_EQUAL(a.head_node_, b.head_node_);
+    BOOST_CHECK(a.tail_nodes_ == b.tail_nodes_);
+  }
+  for (unsigned i = 0; i < hg.nodes_.size(); ++i) {
+    BOOST_CHECK(hg.nodes_[i].in_edges_ == copy->nodes_[i].in_edges_);
+    BOOST_CHECK(hg.nodes_[i].out_edges_ == copy->nodes_[i].out_edges_);
+  }
+  vector<bool> all(hg.edges_.size(), true);
+  BOOST_CHECK(!hg.PrunedSubset(all, true, &subset));
+}
+
 BOOST_AUTO_TEST_CASE(TestIntersect) {
   std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
   Hypergraph hg;
@@ -375,6 +413,37 @@ BOOST_AUTO_TEST_CASE(TestAddExpectations) {
   cerr << "Z=" << z << endl;
 }
 
+BOOST_AUTO_TEST_CASE(TestFeatureExpectations) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg;
+  CreateHG(path, &hg);
+  SparseVector<double> wts;
+  wts.set_value(FD::Convert("f1"), 0.4);
+  wts.set_value(FD::Convert("f2"), 0.8);
+  hg.Reweight(wts);
+  SparseVector<double> feat_exps;
+  prob_t z = FeatureExpectations<EdgeProb>(hg, &feat_exps);
+  BOOST_CHECK_CLOSE(-2.5439765, feat_exps.value(FD::Convert("f1")), 1e-4);
+  BOOST_CHECK_CLOSE(-2.6357865, feat_exps.value(FD::Convert("f2")), 1e-4);
+  BOOST_CHECK_CLOSE(log(Inside<prob_t, EdgeProb>(hg)), log(z), 1e-8);
+
+  // agrees with the expectation semiring on a forest with more features
+  Hypergraph small;
+  CreateSmallHG(&small, path);
+  for (int i = 0; i < 8; ++i)
+    wts.set_value(FD::Convert(string("Model_") + char('0' + i)), -0.5 * i + 1);
+  small.Reweight(wts);
+  SparseVector<prob_t> ref_exps;
+  const prob_t ref_z = InsideOutside<prob_t, EdgeProb,
+                  SparseVector<prob_t>, EdgeFeaturesAndProbWeightFunction>(small, &ref_exps);
+  SparseVector<prob_t> exps;
+  z = FeatureExpectations<EdgeProb>(small, &exps);
+  BOOST_CHECK_CLOSE(log(ref_z), log(z), 1e-8);
+  BOOST_CHECK_EQUAL(ref_exps.size(), exps.size());
+  for (SparseVector<prob_t>::iterator it = ref_exps.begin(); it != ref_exps.end(); ++it)
+    BOOST_CHECK_CLOSE((it->second / ref_z).as_float(), exps.value(it->first).as_float(), 1e-8);
+}
+
 BOOST_AUTO_TEST_CASE(Small) {
   std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
   Hypergraph hg;
@@ -421,6 +490,45 @@ BOOST_AUTO_TEST_CASE(TestGenericKBest) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestLinearBleuMBR) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg;
+  CreateHG(path, &hg);
+  SparseVector<double> wts;
+  wts.set_value(FD::Convert("f1"), 0.4);
+  wts.set_value(FD::Convert("f2"), 1.0);
+  hg.Reweight(wts);
+  const LinearBleu bleu;
+  vector<WordID> trans;
+  const double gain = HG::LinearBleuMBR(hg, bleu, 1.0, 1000, &trans);
+
+  // expected n-gram counts and gains by enumerating all derivations
+  const prob_t z = Inside<prob_t, EdgeProb>(hg);
+  KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> kbest(hg, 1000);
+  vector<vector<WordID> > hyps;
+  LinearBleu::NGramPosteriors counts;
+  for (int i = 0; i < 1000; ++i) {
+    const KBest::KBestDerivations<vector<WordID>, ESentenceTraversal>::Derivation* d =
+      kbest.LazyKthBest(hg.nodes_.size() - 1, i);
+    if (!d) break;
+    hyps.push_back(d->yield);
+    const double p = (d->score / z).as_float();
+    for (unsigned j = 0; j < d->yield.size(); ++j)
+      for (unsigned n = 1; n <= bleu.order() && j + n <= d->yield.size(); ++n)
+        counts[vector<WordID>(d->yield.begin() + j, d->yield.begin() + j + n)] += p;
+  }
+  double best = -1e100;
+  for (unsigned i = 0; i < hyps.size(); ++i) {
+    double g = bleu.theta(0) * hyps[i].size();
+    for (unsigned j = 0; j < hyps[i].size(); ++j)
+      for (unsigned n = 1; n <= bleu.order() && j + n <= hyps[i].size(); ++n)
+        g += bleu.theta(n) * counts[vector<WordID>(hyps[i].begin() + j, hyps[i].begin() + j + n)];
+    best = max(best, g);
+  }
+  cerr << TD::GetString(trans) << " MBR gain: " << gain << endl;
+  BOOST_CHECK_CLOSE(best, gain, 1e-4);
+}
+
 BOOST_AUTO_TEST_CASE(TestReadWriteHG_Boost) {
   std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
   Hypergraph hg;
@@ -446,4 +554,109 @@ BOOST_AUTO_TEST_CASE(TestReadWriteHG_Boost) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestForestCacheRoundTrip) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg;
+  CreateHG(path, &hg);
+  TRulePtr rule(new TRule(*hg.edges_.front().rule_));
+  rule->a_.push_back(AlignmentPoint(0, 1));
+  rule->a_.push_back(AlignmentPoint(1, 0));
+  rule->prev_i = 2;
+  rule->prev_j = 5;
+  rule->parent_rule_ = hg.edges_.front().rule_;
+  rule->tree_structure.reset(new cdec::TreeFragment("(S (NP a [X]) b)", true));
+  hg.edges_.front().rule_ = rule;
+
+  char dir[] = "/tmp/hg_test.XXXXXX";
+  BOOST_REQUIRE(mkdtemp(dir));
+  Hypergraph hg2;
+  {
+    ForestCache cache(dir);
+    cache.Put(3, "key", hg);
+    BOOST_CHECK(!cache.Get(3, "other key", &hg2));
+    BOOST_REQUIRE(cache.Get(3, "key", &hg2));
+  }
+  unlink((string(dir) + "/3.bin.gz").c_str());
+  rmdir(dir);
+
+  BOOST_REQUIRE_EQUAL(hg2.edges_.size(), hg.edges_.size());
+  for (unsigned i = 0; i < hg.edges_.size(); ++i) {
+    const TRule& a = *hg.edges_[i].rule_;
+    const TRule& b = *hg2.edges_[i].rule_;
+    BOOST_CHECK_EQUAL(a.AsString(), b.AsString());
+    BOOST_CHECK_EQUAL(a.a_.size(), b.a_.size());
+    for (unsigned j = 0; j < a.a_.size() && j < b.a_.size(); ++j) {
+      BOOST_CHECK_EQUAL(a.a_[j].s_, b.a_[j].s_);
+      BOOST_CHECK_EQUAL(a.a_[j].t_, b.a_[j].t_);
+    }
+    BOOST_CHECK_EQUAL(a.prev_i, b.prev_i);
+    BOOST_CHECK_EQUAL(a.prev_j, b.prev_j);
+    BOOST_CHECK_EQUAL(static_cast<bool>(a.parent_rule_), static_cast<bool>(b.parent_rule_));
+    BOOST_CHECK_EQUAL(static_cast<bool>(a.tree_structure), static_cast<bool>(b.tree_structure));
+  }
+  const TRule& r = *hg2.edges_.front().rule_;
+  BOOST_REQUIRE(r.parent_rule_);
+  BOOST_CHECK_EQUAL(r.parent_rule_->AsString(), rule->parent_rule_->AsString());
+  BOOST_REQUIRE(r.tree_structure);
+  ostringstream a, b;
+  rule->tree_structure->DebugRec(rule->tree_structure->nodes.size() - 1, &a);
+  r.tree_structure->DebugRec(r.tree_structure->nodes.size() - 1, &b);
+  BOOST_CHECK_EQUAL(a.str(), b.str());
+  BOOST_CHECK_EQUAL(r.tree_structure->root, rule->tree_structure->root);
+}
+
+BOOST_AUTO_TEST_CASE(TestForestCacheEviction) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg, hg2;
+  CreateHG(path, &hg);
+  ForestCache cache("memory:2");
+  cache.Put(1, "a", hg);
+  cache.Put(2, "b", hg);
+  BOOST_CHECK(cache.Get(1, "a", &hg2));  // 2 is now the least recently used
+  cache.Put(3, "c", hg);
+  BOOST_CHECK(cache.Get(1, "a", &hg2));
+  BOOST_CHECK(!cache.Get(2, "b", &hg2));
+  BOOST_CHECK(cache.Get(3, "c", &hg2));
+  cache.Put(3, "d", hg);  // replaces the forest without evicting another
+  BOOST_CHECK(cache.Get(1, "a", &hg2));
+  BOOST_CHECK(!cache.Get(3, "c", &hg2));
+  BOOST_CHECK(cache.Get(3, "d", &hg2));
+  BOOST_CHECK_EQUAL(hg2.edges_.size(), hg.edges_.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestForestCacheCorruptFile) {
+  std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
+  Hypergraph hg, hg2;
+  CreateHG(path, &hg);
+  char dir[] = "/tmp/hg_test.XXXXXX";
+  BOOST_REQUIRE(mkdtemp(dir));
+  const string fname = string(dir) + "/4.bin.gz";
+  {
+    ForestCache cache(dir);
+    cache.Put(4, "key", hg);
+    string data;
+    {
+      ifstream in(fname.c_str());
+      data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    BOOST_REQUIRE(data.size() > 40);
+    // a truncated file and one that is not a forest are misses
+    {
+      ofstream out(fname.c_str());
+      out << data.substr(0, data.size() / 2);
+    }
+    BOOST_CHECK(!cache.Get(4, "key", &hg2));
+    {
+      ofstream out(fname.c_str());
+      out << "not a forest";
+    }
+    BOOST_CHECK(!cache.Get(4, "key", &hg2));
+    cache.Put(4, "key", hg);
+    BOOST_CHECK(cache.Get(4, "key", &hg2));
+  }
+  unlink(fname.c_str());
+  BOOST_CHECK(rmdir(dir) == 0);  // no temporary file is left behind
+  BOOST_CHECK_EQUAL(hg2.edges_.size(), hg.edges_.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
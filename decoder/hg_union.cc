@@ -4,9 +4,11 @@
 # include <unordered_map>
 #else
 # include <tr1/unordered_map>
-namespace std { using std::tr1::unordered_set; }
+namespace std { using std::tr1::unordered_map; using std::tr1::unordered_multimap; }
 #endif
 
+#include <boost/functional/hash.hpp>
+
 #include "verbose.h"
 #include "hg.h"
 #include "sparse_vector.h"
@@ -15,6 +17,26 @@ using namespace std;
 
 namespace HG {
 
+// compares the feature values of two edges within 1e-6, without
+// computing their difference (which would allocate a new vector)
+static bool FeaturesMatch(const SparseVector<double>& a, const SparseVector<double>& b) {
+  for (auto& kv : a)
+    if (fabs(kv.second - b.value(kv.first)) > 1e-6) return false;
+  for (auto& kv : b)
+    if (fabs(kv.second - a.value(kv.first)) > 1e-6) return false;
+  return true;
+}
+
+// hash of everything EdgesMatch compares except for the features, so that
+// only the edges with equal hashes have to be compared
+static size_t EdgeHash(const HG::Edge& e, const Hypergraph& hg) {
+  size_t h = boost::hash_range(e.rule_->e().begin(), e.rule_->e().end());
+  boost::hash_combine(h, boost::hash_range(e.rule_->f().begin(), e.rule_->f().end()));
+  for (unsigned i = 0; i < e.tail_nodes_.size(); ++i)
+    boost::hash_combine(h, hg.nodes_[e.tail_nodes_[i]].node_hash);
+  return h;
+}
+
 static bool EdgesMatch(const HG::Edge& a, const Hypergraph& ahg, const HG::Edge& b, const Hypergraph& bhg) {
   const unsigned arity = a.tail_nodes_.size();
   if (arity != b.tail_nodes_.size()) return false;
@@ -23,10 +45,7 @@ static bool EdgesMatch(const HG::Edge& a, const Hypergraph& ahg, const HG::Edge&
 
   for (unsigned i = 0; i < arity; ++i)
     if (ahg.nodes_[a.tail_nodes_[i]].node_hash != bhg.nodes_[b.tail_nodes_[i]].node_hash) return false;
-  const SparseVector<double> diff = a.feature_values_ - b.feature_values_;
-  for (auto& kv : diff)
-    if (fabs(kv.second) > 1e-6) return false;
-  return true;
+  return FeaturesMatch(a.feature_values_, b.feature_values_);
 }
 
 void Union(const Hypergraph& in, Hypergraph* out) {
@@ -62,17 +81,21 @@ void Union(const Hypergraph& in, Hypergraph* out) {
 
   double n_exists = 0;
   double n_created = 0;
+  // the in edges of the current output node, by EdgeHash
+  unordered_multimap<size_t, unsigned> h2e;
   for (const auto& in_node : in.nodes_) {
+    if (in_node.in_edges_.empty()) continue;
     HG::Node& out_node = out->nodes_[h2n[in_node.node_hash]];
-    //for (const auto oeid : out_node.in_edges_) {
-      // TODO hash currently existing edges for quick check for duplication
-    //}
+    h2e.clear();
+    for (const auto oeid : out_node.in_edges_)
+      h2e.insert(make_pair(EdgeHash(out->edges_[oeid], *out), oeid));
     for (const auto ieid : in_node.in_edges_) {
       const HG::Edge& in_edge = in.edges_[ieid];
-      // TODO: replace slow N^2 check with hashing
+      const size_t h = EdgeHash(in_edge, in);
       bool edge_exists = false;
-      for (const auto oeid : out_node.in_edges_) {
-        if (EdgesMatch(in_edge, in, out->edges_[oeid], *out)) {
+      auto range = h2e.equal_range(h);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (EdgesMatch(in_edge, in, out->edges_[it->second], *out)) {
           edge_exists = true;
           break;
         }
@@ -85,13 +108,12 @@ void Union(const Hypergraph& in, Hypergraph* out) {
           t[i] = h2n[in.nodes_[in_edge.tail_nodes_[i]].node_hash];
         HG::Edge* new_edge = out->AddEdge(in_edge, t);
         out->ConnectEdgeToHeadNode(new_edge, &head);
+        h2e.insert(make_pair(h, new_edge->id_));
         ++n_created;
         //cerr << "Created: " << new_edge->rule_->AsString() << " [head=" << new_edge->head_node_ << "]\n";
       } else {
         ++n_exists;
       }
-      //  cerr << "Not created: " << in.edges_[ieid].rule_->AsString() << "\n";
-      //}
     }
   }
   if (!SILENT)
@@ -1,9 +1,12 @@
 #ifndef INSIDE_OUTSIDE_H_
 #define INSIDE_OUTSIDE_H_
 
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <algorithm>
 #include "hg.h"
+#include "log_sum_exp.h"
 
 // semiring for Inside/Outside
 struct Boolean {
@@ -22,6 +25,45 @@ struct Boolean {
   }
 };
 
+// whether Inside collects the scores of a node's in-edges and adds them up
+// with SumScores rather than one by one (which avoids copying expensive
+// semiring values, e.g. ConvexHull)
+template<class WeightType>
+struct BatchedSum { static const bool value = false; };
+template<>
+struct BatchedSum<prob_t> { static const bool value = true; };
+
+// the semiring sum of the n scores in s
+template<class WeightType>
+inline WeightType SumScores(const WeightType* s, unsigned n) {
+  WeightType sum = WeightType();
+  for (unsigned i = 0; i < n; ++i) sum += s[i];
+  return sum;
+}
+
+// in the log semiring the scores are summed with LogSumExp (a max shift and
+// one exp() per score) instead of a log1p(exp()) per addition
+inline prob_t SumScores(const prob_t* s, unsigned n) {
+  const unsigned kCHUNK = 64;
+  double logs[kCHUNK];
+  double partial[2];
+  partial[0] = prob_t::Zero().v_;
+  for (unsigned b = 0; b < n; b += kCHUNK) {
+    const unsigned m = std::min(kCHUNK, n - b);
+    for (unsigned j = 0; j < m; ++j) {
+      if (s[b + j].s_) {  // negative scores: no shortcut
+        prob_t sum = prob_t::Zero();
+        for (unsigned i = 0; i < n; ++i) sum += s[i];
+        return sum;
+      }
+      logs[j] = s[b + j].v_;
+    }
+    partial[1] = LogSumExp(logs, m);
+    partial[0] = b ? LogSumExp(partial, 2) : partial[1];
+  }
+  return prob_t(partial[0], false);
+}
+
 // run the inside algorithm and return the inside score
 // if result is non-NULL, result will contain the inside
 // score for each node
@@ -37,10 +79,13 @@ WeightType Inside(const Hypergraph& hg,
   inside_score.clear();
   inside_score.resize(num_nodes);
 //  std::fill(inside_score.begin(), inside_score.end(), WeightType()); // clear handles
+  const bool batched = BatchedSum<WeightType>::value;
+  std::vector<WeightType> scores;
   for (unsigned i = 0; i < num_nodes; ++i) {
     WeightType* const cur_node_inside_score = &inside_score[i];
     Hypergraph::EdgesVector const& in=hg.nodes_[i].in_edges_;
     const unsigned num_in_edges = in.size();
+    scores.clear();
     for (unsigned j = 0; j < num_in_edges; ++j) {
       const HG::Edge& edge = hg.edges_[in[j]];
       WeightType score = weight(edge);
@@ -48,8 +93,13 @@ WeightType Inside(const Hypergraph& hg,
         const int tail_node_index = edge.tail_nodes_[k];
         score *= inside_score[tail_node_index];
       }
-      *cur_node_inside_score += score;
+      if (batched)
+        scores.push_back(score);
+      else
+        *cur_node_inside_score += score;
     }
+    if (batched && num_in_edges)
+      *cur_node_inside_score = SumScores(&scores[0], num_in_edges);
   }
   return inside_score.empty() ? WeightType(0) : inside_score.back();
 }
@@ -68,8 +118,26 @@ void Outside(const Hypergraph& hg,
   outside_score.clear();
   outside_score.resize(num_nodes);
 //  std::fill(outside_score.begin(), outside_score.end(), WeightType()); // cleared
+  if (!num_nodes) return;
+  // the contributions to the outside score of node t are collected in
+  // contrib[first[t]], contrib[first[t]+1], ... and summed when t is reached
+  // (all heads of edges with tail t come after t)
+  std::vector<unsigned> first(num_nodes + 1, 0);
+  for (int i = 0; i < num_nodes; ++i) {
+    Hypergraph::EdgesVector const& in=hg.nodes_[i].in_edges_;
+    for (unsigned j = 0; j < in.size(); ++j) {
+      const HG::Edge& edge = hg.edges_[in[j]];
+      for (unsigned k = 0; k < edge.tail_nodes_.size(); ++k)
+        ++first[edge.tail_nodes_[k] + 1];
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) first[i + 1] += first[i];
+  std::vector<unsigned> next(first.begin(), first.end() - 1);
+  std::vector<WeightType> contrib(first.back());
   outside_score.back() = scale_outside;
   for (int i = num_nodes - 1; i >= 0; --i) {
+    if (i != num_nodes - 1)
+      outside_score[i] = SumScores(contrib.data() + first[i], next[i] - first[i]);
     const WeightType& head_node_outside_score = outside_score[i];
     Hypergraph::EdgesVector const& in=hg.nodes_[i].in_edges_;
     const int num_in_edges = in.size();
@@ -80,7 +148,6 @@ void Outside(const Hypergraph& hg,
       const int num_tail_nodes = edge.tail_nodes_.size();
       for (int k = 0; k < num_tail_nodes; ++k) {
         const int update_tail_node_index = edge.tail_nodes_[k];
-        WeightType* const tail_outside_score = &outside_score[update_tail_node_index];
         WeightType inside_contribution = WeightType(1);
         for (int l = 0; l < num_tail_nodes; ++l) {
           const int other_tail_node_index = edge.tail_nodes_[l];
@@ -88,7 +155,7 @@ void Outside(const Hypergraph& hg,
             inside_contribution *= inside_score[other_tail_node_index];
         }
         inside_contribution *= head_and_edge_weight;
-        *tail_outside_score += inside_contribution;
+        contrib[next[update_tail_node_index]++] = inside_contribution;
       }
     }
   }
@@ -186,4 +253,72 @@ KType InsideOutside(const Hypergraph& hg,
   return io.root_inside();
 }
 
+// Feature expectations E[f] = sum_e p(e) f(e) under the distribution over
+// derivations given by the edge weights, computed in real space instead of
+// with the expectation semiring over SparseVector<prob_t> above. The inside
+// pass keeps each node's log inside score L_i and scales the edges of node i
+// by it: share_e = w_e * prod_tails inside / inside_i is in [0,1]. The
+// outside pass then works with node posteriors mu_i = inside_i*outside_i/Z,
+// also in [0,1], so that p(e) = mu_head * share_e and mu_tail += p(e) need no
+// log-space additions and cannot underflow. E[f] is accumulated in a dense
+// buffer indexed by feature id, and *result (normalized) is built from it at
+// the end. Returns the partition function Z.
+template<class WeightFunction, class T>
+prob_t FeatureExpectations(const Hypergraph& hg,
+                           SparseVector<T>* result,
+                           const WeightFunction& weight = WeightFunction()) {
+  const double kLOG0 = -std::numeric_limits<double>::infinity();
+  const unsigned num_nodes = hg.nodes_.size();
+  result->clear();
+  if (!num_nodes) return prob_t::Zero();
+  std::vector<double> log_inside(num_nodes, kLOG0);
+  std::vector<double> share(hg.edges_.size(), 0.0);
+  for (unsigned i = 0; i < num_nodes; ++i) {
+    const Hypergraph::EdgesVector& in = hg.nodes_[i].in_edges_;
+    double max_score = kLOG0;
+    for (unsigned j = 0; j < in.size(); ++j) {
+      const HG::Edge& edge = hg.edges_[in[j]];
+      double score = log(weight(edge));
+      for (unsigned k = 0; k < edge.tail_nodes_.size(); ++k)
+        score += log_inside[edge.tail_nodes_[k]];
+      share[in[j]] = score;
+      if (score > max_score) max_score = score;
+    }
+    if (max_score == kLOG0) {
+      for (unsigned j = 0; j < in.size(); ++j) share[in[j]] = 0;
+      continue;
+    }
+    double sum = 0;
+    for (unsigned j = 0; j < in.size(); ++j)
+      sum += (share[in[j]] = std::exp(share[in[j]] - max_score));
+    for (unsigned j = 0; j < in.size(); ++j)
+      share[in[j]] /= sum;
+    log_inside[i] = max_score + std::log(sum);
+  }
+  if (log_inside.back() == kLOG0) return prob_t::Zero();
+
+  std::vector<double> mu(num_nodes, 0.0);
+  std::vector<double> dense;
+  mu.back() = 1;
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    if (!mu[i]) continue;
+    const Hypergraph::EdgesVector& in = hg.nodes_[i].in_edges_;
+    for (unsigned j = 0; j < in.size(); ++j) {
+      const double p = mu[i] * share[in[j]];
+      if (!p) continue;
+      const HG::Edge& edge = hg.edges_[in[j]];
+      for (unsigned k = 0; k < edge.tail_nodes_.size(); ++k)
+        mu[edge.tail_nodes_[k]] += p;
+      for (SparseVector<double>::const_iterator it = edge.feature_values_.begin();
+           it != edge.feature_values_.end(); ++it) {
+        if (static_cast<size_t>(it->first) >= dense.size()) dense.resize(it->first + 1);
+        dense[it->first] += p * it->second;
+      }
+    }
+  }
+  for (unsigned f = 0; f < dense.size(); ++f)
+    if (dense[f]) result->set_value(f, T(dense[f]));
+  return prob_t::exp(log_inside.back());
+}
+
 #endif
@@ -0,0 +1,172 @@
+#include "lm_client.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include "tdict.h"
+
+using namespace std;
+
+namespace {
+
+void WriteAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    const ssize_t r = write(fd, data, len);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      perror("LMClient: write()");
+      exit(1);
+    }
+    data += r;
+    len -= r;
+  }
+}
+
+void ReadAll(int fd, char* data, size_t len) {
+  while (len > 0) {
+    const ssize_t r = read(fd, data, len);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) {
+      cerr << "LMClient: the LM server closed the connection\n";
+      exit(1);
+    }
+    data += r;
+    len -= r;
+  }
+}
+
+}
+
+LMClient::LMClient(const string& host, bool batched, unsigned max_cache) :
+    batched_(batched), max_cache_(max_cache), requests_() {
+  string hostname = host;
+  int port = 6666;
+  const size_t colon = host.find(':');
+  if (colon != string::npos) {
+    hostname = host.substr(0, colon);
+    port = atoi(host.c_str() + colon + 1);
+  }
+  struct hostent* hp = gethostbyname(hostname.c_str());
+  if (hp == NULL) {
+    cerr << "unknown host " << hostname << endl;
+    abort();
+  }
+  struct sockaddr_in server;
+  memset(&server, 0, sizeof(server));
+  memcpy(&server.sin_addr, hp->h_addr, hp->h_length);
+  server.sin_family = hp->h_addrtype;
+  server.sin_port = htons(port);
+
+  int errors = 0;
+  sock_ = socket(AF_INET, SOCK_STREAM, 0);
+  while (connect(sock_, (struct sockaddr *)&server, sizeof(server)) < 0) {
+    cerr << "Error: connect()\n";
+    sleep(1);
+    errors++;
+    if (errors > 3) exit(1);
+  }
+  // requests are small and are answered one at a time
+  int one = 1;
+  setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  cerr << "Connected to LM on " << hostname << " on port " << port << endl;
+}
+
+LMClient::~LMClient() {
+  close(sock_);
+}
+
+float LMClient::WordProb(WordID word, const WordID* context) {
+  // WordProbs reuses key_, so the query is built in its own buffer, which
+  // is complete (and no longer reallocated) before its address is taken
+  query_.assign(1, word);
+  for (; *context > 0; ++context) query_.push_back(*context);
+  query_.push_back(0);
+  const vector<const WordID*> query(1, &query_[0]);
+  float p;
+  WordProbs(query, &p);
+  return p;
+}
+
+void LMClient::WordProbs(const vector<const WordID*>& queries, float* probs) {
+  pending_.clear();
+  pending_index_.clear();
+  for (unsigned i = 0; i < queries.size(); ++i) {
+    key_.clear();
+    for (const WordID* w = queries[i]; *w > 0; ++w) key_.push_back(*w);
+    const Cache::const_iterator it = cache_.find(key_);
+    if (it != cache_.end()) {
+      probs[i] = it->second;
+    } else {
+      pending_.push_back(queries[i]);
+      pending_index_.push_back(i);
+    }
+  }
+  if (pending_.empty()) return;
+
+  answers_.resize(pending_.size());
+  if (!batched_) {
+    for (unsigned k = 0; k < pending_.size(); ++k) answers_[k] = SendLine(k);
+  } else {
+    const unsigned num_frames = (pending_.size() + kFrameSize - 1) / kFrameSize;
+    unsigned sent = 0;
+    for (unsigned f = 0; f < num_frames; ++f) {
+      for (; sent < num_frames && sent < f + kWindow; ++sent)
+        SendFrame(sent * kFrameSize, min<unsigned>((sent + 1) * kFrameSize, pending_.size()));
+      const unsigned begin = f * kFrameSize;
+      const unsigned end = min<unsigned>(begin + kFrameSize, pending_.size());
+      ReadAnswers(begin, end, &answers_[begin]);
+    }
+  }
+
+  if (cache_.size() + pending_.size() > max_cache_) cache_.clear();
+  for (unsigned k = 0; k < pending_.size(); ++k) {
+    probs[pending_index_[k]] = answers_[k];
+    key_.clear();
+    for (const WordID* w = pending_[k]; *w > 0; ++w) key_.push_back(*w);
+    cache_[key_] = answers_[k];
+  }
+}
+
+void LMClient::AppendQuery(const WordID* w) {
+  buf_ += TD::Convert(*w);
+  for (++w; *w > 0; ++w) {
+    buf_ += ' ';
+    buf_ += TD::Convert(*w);
+  }
+  buf_ += '\n';
+}
+
+void LMClient::SendFrame(unsigned begin, unsigned end) {
+  ostringstream os;
+  os << "probs " << (end - begin) << '\n';
+  buf_ = os.str();
+  for (unsigned k = begin; k < end; ++k) AppendQuery(pending_[k]);
+  WriteAll(sock_, buf_.data(), buf_.size());
+  ++requests_;
+}
+
+float LMClient::SendLine(unsigned k) {
+  buf_ = "prob ";
+  AppendQuery(pending_[k]);
+  WriteAll(sock_, buf_.data(), buf_.size());
+  ++requests_;
+  char res[6];
+  ReadAll(sock_, res, sizeof(res));
+  float p;
+  memcpy(&p, res, sizeof(p));
+  return p;
+}
+
+void LMClient::ReadAnswers(unsigned begin, unsigned end, float* answers) {
+  ReadAll(sock_, reinterpret_cast<char*>(answers), (end - begin) * sizeof(float));
+}
@@ -0,0 +1,79 @@
+#ifndef LM_CLIENT_H_
+#define LM_CLIENT_H_
+
+#include <string>
+#include <vector>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include <boost/functional/hash.hpp>
+
+#include "wordid.h"
+
+// Client of a language model served over TCP. A query is a word followed by
+// its context, most recent word first, and ends at the first id <= 0. Two
+// protocols are spoken:
+//  - LanguageModel lm://host:port, the line protocol of the existing LM
+//    servers: each query is sent as a line
+//      prob <word> <context ...>\n
+//    and answered with 6 bytes, the first 4 of which are its log10
+//    probability as a float in host byte order. Queries are sent one at a
+//    time.
+//  - LanguageModel lmb://host:port, a batched protocol, which the server
+//    has to support: the queries are sent in frames
+//      probs <n>\n
+//      <word> <context ...>\n      (n lines)
+//    which are answered with n 4-byte floats. The queries of a WordProbs
+//    call (the lookups of one edge) are sent in one frame, or in frames of
+//    at most kFrameSize queries, up to kWindow of which are written before
+//    the first answer is read.
+// Answers are cached in a hash table that is emptied when it holds
+// max_cache n-grams.
+class LMClient {
+ public:
+  static const unsigned kFrameSize = 512;
+  static const unsigned kWindow = 8;
+
+  // host is "hostname[:port]" (the port defaults to 6666); batched selects
+  // the framed protocol
+  explicit LMClient(const std::string& host, bool batched = false, unsigned max_cache = 1 << 22);
+  ~LMClient();
+
+  float WordProb(WordID word, const WordID* context);
+  // probs[i] = log10 p(queries[i][0] | queries[i] + 1)
+  void WordProbs(const std::vector<const WordID*>& queries, float* probs);
+
+  unsigned cache_size() const { return cache_.size(); }
+  unsigned requests_sent() const { return requests_; }
+
+ private:
+  typedef std::vector<WordID> Ngram;
+  typedef std::unordered_map<Ngram, float, boost::hash<Ngram> > Cache;
+
+  // appends the query to buf_ as "<word> <context ...>\n"
+  void AppendQuery(const WordID* query);
+  // sends the queries in [begin, end) of pending_ as one frame
+  void SendFrame(unsigned begin, unsigned end);
+  // sends pending_[k] as a line and reads its answer
+  float SendLine(unsigned k);
+  // reads the answers to the queries in [begin, end) of pending_
+  void ReadAnswers(unsigned begin, unsigned end, float* answers);
+
+  int sock_;
+  const bool batched_;
+  const unsigned max_cache_;
+  unsigned requests_;
+  Cache cache_;
+  Ngram key_;
+  Ngram query_;  // the 0-terminated query of WordProb
+  std::vector<const WordID*> pending_;  // queries that are not cached
+  std::vector<unsigned> pending_index_;  // their indices in the batch
+  std::vector<float> answers_;
+  std::string buf_;
+};
+
+#endif
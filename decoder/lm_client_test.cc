@@ -0,0 +1,201 @@
+#define BOOST_TEST_MODULE lm_client_test
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "lm_client.h"
+#include "tdict.h"
+
+using namespace std;
+
+// the probability the stand-in server assigns to a query line
+static float LineProb(const string& line) {
+  unsigned h = 0;
+  for (unsigned i = 0; i < line.size(); ++i) h = h * 31 + line[i];
+  return -static_cast<float>(h % 1000) / 100.0f;
+}
+
+// answers the lines or frames of one client connection (see lm_client.h)
+struct StandInServer {
+  StandInServer() : queries(0), frames(0) {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    BOOST_REQUIRE(bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    BOOST_REQUIRE(listen(listener, 1) == 0);
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+    char host[32];
+    sprintf(host, "localhost:%d", ntohs(addr.sin_port));
+    host_port = host;
+    thread = boost::thread(boost::ref(*this));
+  }
+  ~StandInServer() {
+    thread.join();
+    close(listener);
+  }
+  void operator()() {
+    const int fd = accept(listener, NULL, NULL);
+    FILE* in = fdopen(fd, "r");
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+      if (strncmp(line, "prob ", 5) == 0) {
+        string q(line + 5);
+        q.resize(q.size() - 1);
+        char res[6] = { 0 };
+        const float p = LineProb(q);
+        memcpy(res, &p, sizeof(p));
+        ++queries;
+        if (write(fd, res, sizeof(res)) < 0) break;
+        continue;
+      }
+      unsigned n = 0;
+      if (sscanf(line, "probs %u", &n) != 1) break;
+      vector<float> probs(n);
+      for (unsigned i = 0; i < n; ++i) {
+        if (!fgets(line, sizeof(line), in)) break;
+        string q(line);
+        q.resize(q.size() - 1);
+        probs[i] = LineProb(q);
+      }
+      queries += n;
+      ++frames;
+      if (n && write(fd, &probs[0], n * sizeof(float)) < 0) break;
+    }
+    fclose(in);
+  }
+  int listener;
+  string host_port;
+  atomic<unsigned> queries;
+  atomic<unsigned> frames;
+  boost::thread thread;
+};
+
+// query i is "w<i> c<i%7> c<i%5>"
+static void MakeQueries(unsigned n, vector<vector<WordID> >* store, vector<const WordID*>* queries) {
+  store->resize(n);
+  queries->resize(n);
+  for (unsigned i = 0; i < n; ++i) {
+    vector<WordID>& q = (*store)[i];
+    char buf[32];
+    sprintf(buf, "w%u", i);
+    q.push_back(TD::Convert(buf));
+    sprintf(buf, "c%u", i % 7);
+    q.push_back(TD::Convert(buf));
+    sprintf(buf, "c%u", i % 5);
+    q.push_back(TD::Convert(buf));
+    q.push_back(0);
+    (*queries)[i] = &q[0];
+  }
+}
+
+static string QueryLine(unsigned i) {
+  char buf[64];
+  sprintf(buf, "w%u c%u c%u", i, i % 7, i % 5);
+  return buf;
+}
+
+BOOST_AUTO_TEST_CASE(Batches) {
+  StandInServer server;
+  {
+    LMClient client(server.host_port, true);
+    const unsigned n = LMClient::kFrameSize * (LMClient::kWindow + 2) + 17;
+    vector<vector<WordID> > store;
+    vector<const WordID*> queries;
+    MakeQueries(n, &store, &queries);
+    vector<float> probs(n);
+    client.WordProbs(queries, &probs[0]);
+    for (unsigned i = 0; i < n; ++i)
+      BOOST_CHECK_EQUAL(probs[i], LineProb(QueryLine(i)));
+    BOOST_CHECK_EQUAL(client.requests_sent(), LMClient::kWindow + 3);
+
+    // answered from the cache
+    const unsigned before = client.requests_sent();
+    BOOST_CHECK_EQUAL(client.WordProb(store[3][0], &store[3][1]), probs[3]);
+    client.WordProbs(queries, &probs[0]);
+    BOOST_CHECK_EQUAL(client.requests_sent(), before);
+    BOOST_CHECK_EQUAL(probs[n - 1], LineProb(QueryLine(n - 1)));
+
+    // a single lookup with a shorter context
+    const WordID w = TD::Convert("w1");
+    const WordID ctx[] = { TD::Convert("c1"), 0 };
+    BOOST_CHECK_EQUAL(client.WordProb(w, ctx), LineProb("w1 c1"));
+  }
+  BOOST_CHECK_EQUAL(server.queries, LMClient::kFrameSize * (LMClient::kWindow + 2) + 17 + 1);
+}
+
+// single lookups on a fresh client, with contexts long enough that the
+// query buffer is reallocated several times
+BOOST_AUTO_TEST_CASE(WordProbFreshClient) {
+  StandInServer server;
+  {
+    LMClient client(server.host_port, true);
+    vector<WordID> context(1, 0);
+    string line = "w";
+    for (unsigned n = 0; n < 10; ++n) {
+      BOOST_CHECK_EQUAL(client.WordProb(TD::Convert("w"), &context[0]), LineProb(line));
+      char buf[32];
+      sprintf(buf, "c%u", n);
+      context.insert(context.end() - 1, TD::Convert(buf));
+      line += string(" ") + buf;
+    }
+  }
+  BOOST_CHECK_EQUAL(server.queries, 10u);
+}
+
+// the line protocol of lm:// servers: one request per query
+BOOST_AUTO_TEST_CASE(Lines) {
+  StandInServer server;
+  {
+    LMClient client(server.host_port);
+    vector<vector<WordID> > store;
+    vector<const WordID*> queries;
+    MakeQueries(30, &store, &queries);
+    queries.push_back(queries[4]);
+    vector<float> probs(31);
+    client.WordProbs(queries, &probs[0]);
+    for (unsigned i = 0; i < 30; ++i)
+      BOOST_CHECK_EQUAL(probs[i], LineProb(QueryLine(i)));
+    BOOST_CHECK_EQUAL(probs[30], probs[4]);
+    BOOST_CHECK_EQUAL(client.requests_sent(), 31u);
+    BOOST_CHECK_EQUAL(client.WordProb(store[7][0], &store[7][1]), probs[7]);
+    BOOST_CHECK_EQUAL(client.requests_sent(), 31u);
+  }
+  BOOST_CHECK_EQUAL(server.queries, 31u);
+  BOOST_CHECK_EQUAL(server.frames, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(BoundedCache) {
+  StandInServer server;
+  {
+    LMClient client(server.host_port, true, 100);
+    vector<vector<WordID> > store;
+    vector<const WordID*> queries;
+    MakeQueries(80, &store, &queries);
+    vector<float> probs(80);
+    client.WordProbs(queries, &probs[0]);
+    BOOST_CHECK_EQUAL(client.cache_size(), 80u);
+    // w40..w79 are cached; w80..w119 would overflow the cache, which is
+    // emptied before they are added
+    vector<vector<WordID> > store2;
+    vector<const WordID*> queries2;
+    MakeQueries(120, &store2, &queries2);
+    vector<float> probs2(120);
+    queries2.erase(queries2.begin(), queries2.begin() + 40);
+    client.WordProbs(queries2, &probs2[0]);
+    BOOST_CHECK_EQUAL(client.cache_size(), 40u);
+    for (unsigned i = 0; i < 80; ++i)
+      BOOST_CHECK_EQUAL(probs2[i], LineProb(QueryLine(i + 40)));
+  }
+  BOOST_CHECK_EQUAL(server.queries, 120u);
+}
@@ -1,42 +1,52 @@
 #ifndef NODE_STATE_HASH_
 #define NODE_STATE_HASH_
 
-#include <cassert>
-#include <cstring>
+#include <vector>
 #include "tdict.h"
 #include "murmur_hash3.h"
 #include "ffset.h"
 
 namespace cdec {
 
-  struct FirstPassNode {
-    FirstPassNode(int cat, int i, int j, int pi, int pj) : s(i), t(j), u(pi), v(pj) {
-      memset(lhs, 0, 120);
-      unsigned it = 0;
-      for (auto& c : TD::Convert(-cat)) { lhs[it++] = c; if (it == 120) break; }
+  // combines h with v; the final step is the 64-bit finalizer of MurmurHash3
+  inline uint64_t MixHash(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // hash of the name (not the id) of nonterminal cat, so that node hashes of
+  // forests built by different processes agree; computed once per category
+  inline uint64_t HashCategory(int cat) {
+    static std::vector<uint64_t> cache;  // indexed by -cat, 0 if not computed
+    const unsigned k = -cat;
+    if (k >= cache.size()) cache.resize(k + 1, 0);
+    uint64_t& h = cache[k];
+    if (!h) {
+      const std::string& name = TD::Convert(-cat);
+      h = MurmurHash3_64(name.data(), name.size(), 2654435769U);
+      if (!h) h = 1;
     }
-    char lhs[120];
-    short s;
-    short t;
-    short u;
-    short v;
-  };
+    return h;
+  }
 
   inline uint64_t HashNode(int cat, int i, int j, int pi, int pj) {
-    FirstPassNode fpn(cat, i, j, pi, pj);
-    return MurmurHash3_64(&fpn, sizeof(FirstPassNode), 2654435769U);
+    const uint64_t span = static_cast<uint64_t>(static_cast<uint16_t>(i)) |
+                          static_cast<uint64_t>(static_cast<uint16_t>(j)) << 16 |
+                          static_cast<uint64_t>(static_cast<uint16_t>(pi)) << 32 |
+                          static_cast<uint64_t>(static_cast<uint16_t>(pj)) << 48;
+    return MixHash(HashCategory(cat), span);
   }
 
   inline uint64_t HashNode(uint64_t old_hash, const FFState& state) {
     if (state.size() == 0) return old_hash;
-    uint8_t buf[1024];
-    std::memcpy(buf, &old_hash, sizeof(uint64_t));
-    assert(state.size() < (1024u - sizeof(uint64_t)));
-    std::memcpy(&buf[sizeof(uint64_t)], state.begin(), state.size());
-    return MurmurHash3_64(buf, sizeof(uint64_t) + state.size(), 2654435769U);
+    return MixHash(old_hash, MurmurHash3_64(state.begin(), state.size(), 2654435769U));
   }
 
 }
 
 #endif
-
@@ -0,0 +1,375 @@
+#include "parallel_rule_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include <boost/functional/hash.hpp>
+
+#include "fdict.h"
+#include "parallel_for.h"
+#include "rule_arena.h"
+#include "tdict.h"
+#include "verbose.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned kLINES_PER_SLICE = 2000;
+const unsigned kSLICES_PER_THREAD = 8;
+
+// a string in a line of the batch
+struct Piece {
+  Piece() : s(), len() {}
+  Piece(const char* p, unsigned l) : s(p), len(l) {}
+  bool operator==(const Piece& o) const {
+    return len == o.len && !memcmp(s, o.s, len);
+  }
+  string str() const { return string(s, len); }
+  const char* s;
+  unsigned len;
+};
+
+struct PieceHash {
+  size_t operator()(const Piece& p) const {
+    return boost::hash_range(p.s, p.s + p.len);
+  }
+};
+
+// one line of the grammar, split into its fields by a worker
+struct RawRule {
+  enum Kind { EMPTY, RULE, FALLBACK, COARSE_TO_FINE };
+  void clear() {
+    kind = FALLBACK;
+    f.clear();
+    f_nt.clear();
+    e.clear();
+    e_index.clear();
+    feat_names.clear();
+    feat_vals.clear();
+    als.clear();
+  }
+  Kind kind;
+  Piece lhs;
+  vector<Piece> f;           // source symbols
+  vector<char> f_nt;         // whether f[i] is a nonterminal (category)
+  vector<Piece> e;           // target terminals (empty for variables)
+  vector<int> e_index;       // 0 for terminals, else the source variable (from 1)
+  vector<Piece> feat_names;  // empty for unnamed features (PhraseModel_i)
+  vector<double> feat_vals;
+  vector<AlignmentPoint> als;
+};
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+inline bool IsSeparator(const Piece& p) {
+  return p.len == 3 && p.s[0] == '|' && p.s[1] == '|' && p.s[2] == '|';
+}
+
+// a category, i.e. the NT in [NT] ([^\t \n\r\[\],]+)
+inline bool IsCategory(const char* s, unsigned len) {
+  if (!len) return false;
+  for (unsigned i = 0; i < len; ++i)
+    if (s[i] == '[' || s[i] == ']' || s[i] == ',' || s[i] == '\n') return false;
+  return true;
+}
+
+// [1] .. [99] (the index may not start with 0)
+inline bool ParseIndex(const char* s, unsigned len, int* index) {
+  if (len < 1 || len > 2 || s[0] < '1' || s[0] > '9') return false;
+  *index = s[0] - '0';
+  if (len == 2) {
+    if (s[1] < '0' || s[1] > '9') return false;
+    *index = *index * 10 + s[1] - '0';
+  }
+  return true;
+}
+
+// [NT]: sets cat
+inline bool IsNT(const Piece& p, Piece* cat) {
+  if (p.len < 3 || p.s[0] != '[' || p.s[p.len - 1] != ']') return false;
+  if (!IsCategory(p.s + 1, p.len - 2)) return false;
+  *cat = Piece(p.s + 1, p.len - 2);
+  return true;
+}
+
+// [NT,k]: sets cat and index
+inline bool IsIndexedNT(const Piece& p, Piece* cat, int* index) {
+  if (p.len < 5 || p.s[0] != '[' || p.s[p.len - 1] != ']') return false;
+  const char* comma = static_cast<const char*>(memchr(p.s, ',', p.len));
+  if (!comma) return false;
+  const unsigned cat_len = comma - p.s - 1;
+  if (!IsCategory(p.s + 1, cat_len)) return false;
+  if (!ParseIndex(comma + 1, p.s + p.len - 1 - (comma + 1), index)) return false;
+  *cat = Piece(p.s + 1, cat_len);
+  return true;
+}
+
+// the REAL of the lexer: [\-+]?[0-9]+(\.[0-9]*)?([eE][-+]*[0-9]+)?
+inline bool ParseReal(const char* s, unsigned len, double* v) {
+  unsigned i = 0;
+  if (i < len && (s[i] == '-' || s[i] == '+')) ++i;
+  const unsigned digits = i;
+  while (i < len && s[i] >= '0' && s[i] <= '9') ++i;
+  if (i == digits) return false;
+  if (i < len && s[i] == '.') {
+    ++i;
+    while (i < len && s[i] >= '0' && s[i] <= '9') ++i;
+  }
+  if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+    ++i;
+    while (i < len && (s[i] == '-' || s[i] == '+')) ++i;
+    const unsigned exp_digits = i;
+    while (i < len && s[i] >= '0' && s[i] <= '9') ++i;
+    if (i == exp_digits) return false;
+  }
+  if (i != len) return false;
+  char buf[64];
+  if (len >= sizeof(buf)) {
+    *v = strtod(string(s, len).c_str(), NULL);
+  } else {
+    memcpy(buf, s, len);
+    buf[len] = 0;
+    *v = strtod(buf, NULL);
+  }
+  return true;
+}
+
+inline bool ParseAlignment(const Piece& p, AlignmentPoint* a) {
+  unsigned i = 0;
+  int x = 0, y = 0;
+  while (i < p.len && p.s[i] >= '0' && p.s[i] <= '9') x = x * 10 + p.s[i++] - '0';
+  if (i == 0 || i == p.len || p.s[i] != '-') return false;
+  const unsigned start = ++i;
+  while (i < p.len && p.s[i] >= '0' && p.s[i] <= '9') y = y * 10 + p.s[i++] - '0';
+  if (i == start || i != p.len) return false;
+  *a = AlignmentPoint(x, y);
+  return true;
+}
+
+// splits line into the fields of r; r->kind is FALLBACK for anything that
+// RuleLexer would parse differently or reject
+void ParseLine(const string& line, vector<Piece>* tokens, RawRule* r) {
+  r->clear();
+  if (line.empty()) { r->kind = RawRule::EMPTY; return; }
+  if (line[0] == ' ' || line[0] == '\t') { r->kind = RawRule::COARSE_TO_FINE; return; }
+  if (line.find('\r') != string::npos) return;
+  tokens->clear();
+  const char* s = line.data();
+  const unsigned n = line.size();
+  for (unsigned i = 0; i < n; ) {
+    while (i < n && IsSpace(s[i])) ++i;
+    const unsigned b = i;
+    while (i < n && !IsSpace(s[i])) ++i;
+    if (i > b) tokens->push_back(Piece(s + b, i - b));
+  }
+  const vector<Piece>& t = *tokens;
+  if (t.size() < 2 || !IsNT(t[0], &r->lhs) || !IsSeparator(t[1])) return;
+  unsigned k = 2;
+  // source
+  vector<Piece> src_cats;
+  Piece cat;
+  int index;
+  for (; k < t.size() && !IsSeparator(t[k]); ++k) {
+    if (IsNT(t[k], &cat)) {
+      r->f.push_back(cat);
+      r->f_nt.push_back(1);
+      src_cats.push_back(cat);
+    } else if (IsIndexedNT(t[k], &cat, &index)) {
+      if (index != static_cast<int>(src_cats.size()) + 1) return;
+      r->f.push_back(cat);
+      r->f_nt.push_back(1);
+      src_cats.push_back(cat);
+    } else {
+      r->f.push_back(t[k]);
+      r->f_nt.push_back(0);
+    }
+  }
+  if (k == t.size()) return;  // no target
+  ++k;
+  // target
+  vector<char> used(src_cats.size(), 0);
+  for (; k < t.size() && !IsSeparator(t[k]); ++k) {
+    const Piece& p = t[k];
+    bool var = false;
+    if (IsIndexedNT(p, &cat, &index)) {
+      if (index > static_cast<int>(src_cats.size()) || !(src_cats[index - 1] == cat)) return;
+      var = true;
+    } else if (p.len >= 3 && p.s[0] == '[' && p.s[p.len - 1] == ']' &&
+               ParseIndex(p.s + 1, p.len - 2, &index)) {
+      if (index > static_cast<int>(src_cats.size())) return;
+      var = true;
+    }
+    if (var) {
+      if (used[index - 1]) return;
+      used[index - 1] = 1;
+      r->e.push_back(Piece());
+      r->e_index.push_back(index);
+    } else {
+      r->e.push_back(p);
+      r->e_index.push_back(0);
+    }
+  }
+  for (unsigned i = 0; i < used.size(); ++i)
+    if (!used[i]) return;  // arity mismatch
+  if (k < t.size()) {
+    ++k;
+    // features, separated by spaces or ;
+    for (; k < t.size() && !IsSeparator(t[k]); ++k) {
+      const char* p = t[k].s;
+      const char* end = p + t[k].len;
+      while (p < end) {
+        const char* q = p;
+        while (q < end && *q != ';') ++q;
+        if (q > p) {
+          const char* eq = static_cast<const char*>(memchr(p, '=', q - p));
+          double v;
+          if (eq) {
+            if (eq == p || !ParseReal(eq + 1, q - eq - 1, &v)) return;
+            r->feat_names.push_back(Piece(p, eq - p));
+          } else {
+            if (!ParseReal(p, q - p, &v)) return;
+            r->feat_names.push_back(Piece());
+          }
+          r->feat_vals.push_back(v);
+        }
+        p = q + 1;
+      }
+    }
+    if (k < t.size()) {
+      ++k;
+      // alignments
+      AlignmentPoint a;
+      for (; k < t.size() && !IsSeparator(t[k]); ++k) {
+        if (!ParseAlignment(t[k], &a)) return;
+        r->als.push_back(a);
+      }
+      if (k < t.size()) return;  // tree fragment
+    }
+  }
+  r->kind = RawRule::RULE;
+}
+
+struct ParseSlices {
+  const vector<string>* lines;
+  vector<RawRule>* rules;
+  unsigned num_lines;
+  void operator()(size_t slice) const {
+    vector<Piece> tokens;
+    const unsigned b = slice * kLINES_PER_SLICE;
+    const unsigned e = min(b + kLINES_PER_SLICE, num_lines);
+    for (unsigned i = b; i < e; ++i)
+      ParseLine((*lines)[i], &tokens, &(*rules)[i]);
+  }
+};
+
+// the ids of the strings of a batch; each distinct string is converted once
+class BatchInterner {
+ public:
+  WordID Word(const Piece& p) {
+    WordID& id = words_[p];
+    if (!id) id = TD::Convert(p.str());
+    return id;
+  }
+  int Feature(const Piece& p) {
+    int& id = feats_[p];
+    if (!id) id = FD::Convert(p.str());
+    return id;
+  }
+  int PhraseModel(unsigned i) {
+    while (phrase_fids_.size() <= i) {
+      ostringstream os;
+      os << "PhraseModel_" << phrase_fids_.size();
+      phrase_fids_.push_back(FD::Convert(os.str()));
+    }
+    return phrase_fids_[i];
+  }
+  void clear() { words_.clear(); feats_.clear(); }
+ private:
+  unordered_map<Piece, WordID, PieceHash> words_;
+  unordered_map<Piece, int, PieceHash> feats_;
+  vector<int> phrase_fids_;
+};
+
+}
+
+void ReadRulesInParallel(istream* in,
+                         RuleLexer::RuleCallback func,
+                         const string& fname,
+                         void* extra,
+                         unsigned threads) {
+  const unsigned batch_size = threads * kSLICES_PER_THREAD * kLINES_PER_SLICE;
+  vector<string> lines(batch_size);
+  vector<RawRule> raw(batch_size);
+  boost::shared_ptr<RuleArena> arena(new RuleArena);
+  BatchInterner interner;
+  vector<WordID> f, e;
+  vector<int> fids;
+  unsigned line_no = 0;
+  unsigned num_rules = 0;
+  bool fl = false;
+  while (*in) {
+    unsigned n = 0;
+    while (n < batch_size && getline(*in, lines[n])) ++n;
+    if (!n) break;
+    ParseSlices parse = { &lines, &raw, n };
+    ParallelFor((n + kLINES_PER_SLICE - 1) / kLINES_PER_SLICE, threads, parse);
+
+    interner.clear();
+    for (unsigned i = 0; i < n; ++i) {
+      ++line_no;
+      const RawRule& r = raw[i];
+      if (r.kind == RawRule::EMPTY) continue;
+      if (r.kind == RawRule::COARSE_TO_FINE) {
+        cerr << "Grammar " << fname << " line " << line_no
+             << ": coarse-to-fine grammars cannot be read with multiple threads\n";
+        abort();
+      }
+      if (r.kind == RawRule::FALLBACK) {
+        RuleLexer::ReadRule(lines[i] + '\n', func, false, extra, fname, line_no);
+      } else {
+        int arity = 0;
+        f.resize(r.f.size());
+        for (unsigned j = 0; j < r.f.size(); ++j) {
+          if (r.f_nt[j]) {
+            f[j] = -interner.Word(r.f[j]);
+            ++arity;
+          } else {
+            f[j] = interner.Word(r.f[j]);
+          }
+        }
+        e.resize(r.e.size());
+        for (unsigned j = 0; j < r.e.size(); ++j)
+          e[j] = r.e_index[j] ? 1 - r.e_index[j] : interner.Word(r.e[j]);
+        fids.resize(r.feat_names.size());
+        for (unsigned j = 0; j < fids.size(); ++j) {
+          fids[j] = r.feat_names[j].len ? interner.Feature(r.feat_names[j]) : interner.PhraseModel(j);
+          if (fids[j] < 1) {
+            cerr << "\nUNWEIGHED FEATURE " << r.feat_names[j].str() << endl;
+            abort();
+          }
+        }
+        const TRulePtr rule = NewRule(arena, -interner.Word(r.lhs),
+                                      f.data(), static_cast<int>(f.size()),
+                                      e.data(), static_cast<int>(e.size()),
+                                      fids.data(), r.feat_vals.data(), static_cast<int>(fids.size()),
+                                      arity, r.als.data(), static_cast<int>(r.als.size()));
+        func(rule, 0, TRulePtr(), extra);
+      }
+      ++num_rules;
+      if (!SILENT) {
+        if (num_rules %   50000 == 0) { cerr << '.' << flush; fl = true; }
+        if (num_rules % 2000000 == 0) { cerr << " [" << num_rules << "]\n"; fl = false; }
+      }
+    }
+  }
+  if (fl && !SILENT) cerr << endl;
+}
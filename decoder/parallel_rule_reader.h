@@ -0,0 +1,24 @@
+#ifndef PARALLEL_RULE_READER_H_
+#define PARALLEL_RULE_READER_H_
+
+#include <iostream>
+#include <string>
+
+#include "rule_lexer.h"
+
+// Reads a grammar like RuleLexer::ReadRules, but splits the input into
+// batches of lines and parses each batch on threads threads. The workers
+// only split the lines into their fields and parse the numbers; the words,
+// categories and feature names of a batch are then interned (each distinct
+// string is converted once per batch) and the rules are created and passed
+// to func in file order by the calling thread, so func need not be thread
+// safe. Lines this parser does not handle itself (tree fragments, and
+// malformed rules, for which RuleLexer reports the error) are handed to
+// RuleLexer::ReadRule. Coarse-to-fine grammars are not supported.
+void ReadRulesInParallel(std::istream* in,
+                         RuleLexer::RuleCallback func,
+                         const std::string& fname,
+                         void* extra,
+                         unsigned threads);
+
+#endif
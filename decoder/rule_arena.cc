@@ -0,0 +1,29 @@
+#include "rule_arena.h"
+
+namespace {
+const size_t kALIGN = alignof(std::max_align_t);
+}
+
+RuleArena::~RuleArena() {
+  for (unsigned i = 0; i < blocks_.size(); ++i)
+    delete[] blocks_[i];
+}
+
+void* RuleArena::Allocate(size_t size) {
+  size = (size + kALIGN - 1) & ~(kALIGN - 1);
+  if (size > left_) {
+    const size_t block = size > next_block_ ? size : next_block_;
+    if (next_block_ < max_block_)
+      next_block_ = next_block_ * 2 < max_block_ ? next_block_ * 2 : max_block_;
+    // operator new[] returns memory aligned for any type
+    blocks_.push_back(new char[block]);
+    cur_ = blocks_.back();
+    left_ = block;
+    reserved_ += block;
+  }
+  void* res = cur_;
+  cur_ += size;
+  left_ -= size;
+  allocated_ += size;
+  return res;
+}
@@ -0,0 +1,79 @@
+#ifndef RULE_ARENA_H_
+#define RULE_ARENA_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "trule.h"
+
+// Storage for the rules of a grammar. The TRule objects and their shared_ptr
+// control blocks are carved out of blocks that start at first_block bytes
+// and double in size up to max_block, so loading a grammar costs a few
+// large allocations instead of two small ones per rule, small grammars (and
+// per-sentence grammars) stay small, and the rules of a grammar lie next to
+// each other in memory. Memory is never returned to the arena; it is
+// released when the arena is destroyed, which happens when the last rule
+// allocated from it goes away (the control block of each rule holds a
+// reference to the arena). So a rule that outlives its grammar, e.g. one
+// kept in a hypergraph or a cache, keeps the whole arena of the grammar
+// alive. An arena must only be allocated from by one thread at a time;
+// rules allocated from it may be used and destroyed anywhere.
+class RuleArena {
+ public:
+  explicit RuleArena(size_t first_block = 4096, size_t max_block = 1 << 20) :
+      next_block_(first_block), max_block_(max_block), cur_(NULL), left_(0),
+      allocated_(), reserved_() {}
+  ~RuleArena();
+
+  // returns size bytes aligned for any type
+  void* Allocate(size_t size);
+  size_t bytes_allocated() const { return allocated_; }
+  // the size of the blocks allocated so far
+  size_t bytes_reserved() const { return reserved_; }
+
+ private:
+  RuleArena(const RuleArena&);
+  void operator=(const RuleArena&);
+
+  size_t next_block_;
+  const size_t max_block_;
+  std::vector<char*> blocks_;
+  char* cur_;
+  size_t left_;
+  size_t allocated_;
+  size_t reserved_;
+};
+
+// std allocator interface to a RuleArena, for boost::allocate_shared
+template <class T>
+struct RuleArenaAllocator {
+  typedef T value_type;
+  template <class U> struct rebind { typedef RuleArenaAllocator<U> other; };
+
+  explicit RuleArenaAllocator(const boost::shared_ptr<RuleArena>& a) : arena(a) {}
+  template <class U>
+  RuleArenaAllocator(const RuleArenaAllocator<U>& o) : arena(o.arena) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(arena->Allocate(n * sizeof(T))); }
+  void deallocate(T*, size_t) {}
+
+  template <class U>
+  bool operator==(const RuleArenaAllocator<U>& o) const { return arena == o.arena; }
+  template <class U>
+  bool operator!=(const RuleArenaAllocator<U>& o) const { return arena != o.arena; }
+
+  boost::shared_ptr<RuleArena> arena;
+};
+
+// constructs TRule(args...) in arena
+template <class... Args>
+inline TRulePtr NewRule(const boost::shared_ptr<RuleArena>& arena, Args&&... args) {
+  return boost::allocate_shared<TRule>(RuleArenaAllocator<TRule>(arena),
+                                       std::forward<Args>(args)...);
+}
+
+#endif
@@ -10,6 +10,12 @@ struct RuleLexer {
   typedef void (*RuleCallback)(const TRulePtr& new_rule, const unsigned int ctf_level, const TRulePtr& coarse_rule, void* extra);
   static void ReadRules(std::istream* in, RuleCallback func, const std::string& fname, void* extra);
   static void ReadRule(const std::string&, RuleCallback func, bool mono_rule, void* extra);
+  // as above, but errors are reported at line line_no of the grammar fname
+  static void ReadRule(const std::string&, RuleCallback func, bool mono_rule, void* extra,
+                       const std::string& fname, int line_no);
+  // with threads > 1, ReadRules parses the lines of a grammar on that many
+  // threads (see parallel_rule_reader.h); the default is 1
+  static void SetThreads(unsigned threads);
 };
 
 #endif
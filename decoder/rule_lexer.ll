@@ -11,6 +11,7 @@
 #include "tdict.h"
 #include "fdict.h"
 #include "trule.h"
+#include "rule_arena.h"
 #include "verbose.h"
 #include "tree_fragment.h"
 
@@ -21,6 +22,8 @@ RuleLexer::RuleCallback rule_callback = NULL;
 void* rule_callback_extra = NULL;
 std::vector<int> scfglex_phrase_fnames;
 std::string scfglex_fname;
+// rules read by ReadRules are allocated here (NULL for ReadRule)
+boost::shared_ptr<RuleArena> scfglex_arena;
 
 #undef YY_INPUT
 #define YY_INPUT(buf, result, max_size) (result = scfglex_stream->read(buf, max_size).gcount())
@@ -246,7 +249,11 @@ NT ([^\t \n\r\[\],]+|Goal)
                 }
 		// const bool ignore_grammar_features = false;
 		// if (ignore_grammar_features) scfglex_num_feats = 0;
-		TRulePtr rp(new TRule(scfglex_lhs, scfglex_src_rhs, scfglex_src_rhs_size, scfglex_trg_rhs, scfglex_trg_rhs_size, scfglex_feat_ids, scfglex_feat_vals, scfglex_num_feats, scfglex_src_arity, scfglex_als, scfglex_num_als));
+		TRulePtr rp;
+		if (scfglex_arena)
+		  rp = NewRule(scfglex_arena, scfglex_lhs, scfglex_src_rhs, scfglex_src_rhs_size, scfglex_trg_rhs, scfglex_trg_rhs_size, scfglex_feat_ids, scfglex_feat_vals, scfglex_num_feats, scfglex_src_arity, scfglex_als, scfglex_num_als);
+		else
+		  rp.reset(new TRule(scfglex_lhs, scfglex_src_rhs, scfglex_src_rhs_size, scfglex_trg_rhs, scfglex_trg_rhs_size, scfglex_feat_ids, scfglex_feat_vals, scfglex_num_feats, scfglex_src_arity, scfglex_als, scfglex_num_als));
 		if (scfglex_tree) {
 		  if (scfglex_tree->frontier_sites != rp->Arity()) {
 		    std::cerr << "Arity mismatch with tree annotation: " << *scfglex_tree << std::endl;
@@ -331,6 +338,13 @@ NT ([^\t \n\r\[\],]+|Goal)
 %%
 
 #include "filelib.h"
+#include "parallel_rule_reader.h"
+
+static unsigned scfglex_threads = 1;
+
+void RuleLexer::SetThreads(unsigned threads) {
+  scfglex_threads = threads ? threads : 1;
+}
 
 static void init_default_feature_names() {
   if (scfglex_phrase_fnames.empty()) {
@@ -345,20 +359,31 @@ static void init_default_feature_names() {
 
 void RuleLexer::ReadRules(std::istream* in, RuleLexer::RuleCallback func, const std::string& fname, void* extra) {
   init_default_feature_names();
+  if (scfglex_threads > 1) {
+    ReadRulesInParallel(in, func, fname, extra, scfglex_threads);
+    return;
+  }
   lex_mono_rules = false;
   lex_line = 1;
   scfglex_fname = fname;
   scfglex_stream = in;
   rule_callback_extra = extra,
   rule_callback = func;
+  scfglex_arena.reset(new RuleArena);
   yylex();
+  scfglex_arena.reset();  // the rules keep it alive
 }
 
 void RuleLexer::ReadRule(const std::string& srule, RuleCallback func, bool mono, void* extra) {
+  ReadRule(srule, func, mono, extra, srule, 1);
+}
+
+void RuleLexer::ReadRule(const std::string& srule, RuleCallback func, bool mono, void* extra,
+                         const std::string& fname, int line_no) {
   init_default_feature_names();
-  scfglex_fname = srule;
+  scfglex_fname = fname;
   lex_mono_rules = mono;
-  lex_line = 1;
+  lex_line = line_no;
   rule_callback_extra = extra;
   rule_callback = func;
   yy_scan_string(srule.c_str());
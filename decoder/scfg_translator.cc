@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <iterator>
 #include <vector>
 #include <unordered_set>
 #include <boost/foreach.hpp>
@@ -8,6 +9,8 @@
 #include "translator.h"
 #include "hg.h"
 #include "grammar.h"
+#include "grammar_filter.h"
+#include "filelib.h"
 #include "bottom_up_parser.h"
 #include "sentence_metadata.h"
 #include "stringlib.h"
@@ -101,9 +104,17 @@ struct SCFGTranslatorImpl {
   {
     if(conf.count("grammar")){
       vector<string> gfiles = conf["grammar"].as<vector<string> >();
+      boost::shared_ptr<GrammarFilter> filter;
+      if (conf.count("grammar_filter_input")) {
+        const string& ffile = conf["grammar_filter_input"].as<string>();
+        filter.reset(new GrammarFilter(conf["grammar_filter_order"].as<unsigned>()));
+        ReadFile in(ffile);
+        filter->AddInputs(in.stream());
+        if (!SILENT) cerr << "Filtering grammars with the " << filter->size() << " n-grams of " << ffile << endl;
+      }
       for (unsigned i = 0; i < gfiles.size(); ++i) {
         if (!SILENT) cerr << "Reading SCFG grammar from " << gfiles[i] << endl;
-        TextGrammar* g = new TextGrammar(gfiles[i]);
+        TextGrammar* g = filter ? new TextGrammar(gfiles[i], *filter) : new TextGrammar(gfiles[i]);
         g->SetMaxSpan(max_span_limit);
         g->SetGrammarName(gfiles[i]);
         grammars.push_back(GrammarPtr(g));
@@ -161,6 +172,9 @@ struct SCFGTranslatorImpl {
   unsigned int ctf_iterations_;
   vector<GrammarPtr> grammars;
   set<GrammarPtr> sup_grammars_;
+  // the unary rules of the grammars that are not sentence specific, which
+  // the parser reuses unless the other grammars of a sentence add some
+  boost::shared_ptr<const UnaryRuleIndex> static_unaries_;
 
   struct ContainedIn {
     ContainedIn(const set<GrammarPtr>& gs) : gs_(gs) {}
@@ -168,6 +182,21 @@ struct SCFGTranslatorImpl {
     const set<GrammarPtr>& gs_;
   };
 
+  // the unary rule index of glist, which is grammars plus the grammars of
+  // the current sentence
+  boost::shared_ptr<const UnaryRuleIndex> IndexUnaryRules(const vector<GrammarPtr>& glist) {
+    const ContainedIn is_sup(sup_grammars_);
+    if (!static_unaries_) {
+      vector<GrammarPtr> static_grammars;
+      remove_copy_if(grammars.begin(), grammars.end(), back_inserter(static_grammars), is_sup);
+      static_unaries_ = ExhaustiveBottomUpParser::IndexUnaryRules(goal, static_grammars);
+    }
+    for (unsigned gi = 0; gi < glist.size(); ++gi)
+      if ((gi >= grammars.size() || is_sup(glist[gi])) && !glist[gi]->GetAllUnaryRules().empty())
+        return ExhaustiveBottomUpParser::IndexUnaryRules(goal, glist);
+    return static_unaries_;
+  }
+
   void AddSupplementalGrammarFromString(const std::string& grammar_string) {
     grammars.erase(remove_if(grammars.begin(), grammars.end(), ContainedIn(sup_grammars_)), grammars.end());
     istringstream in(grammar_string);
@@ -207,7 +236,7 @@ struct SCFGTranslatorImpl {
         cerr << "Using grammar::" << glist[gi]->GetGrammarName() << endl;
     }
     if (!SILENT) cerr << "First pass parse... " << endl;
-    ExhaustiveBottomUpParser parser(goal, glist);
+    ExhaustiveBottomUpParser parser(goal, glist, IndexUnaryRules(glist));
     if (!parser.Parse(lattice, forest)){
       if (!SILENT) cerr << "  parse failed." << endl;
       return false;
@@ -8,7 +8,7 @@ using namespace std;
 
 namespace cdec {
 
-TreeFragment::TreeFragment(const StringPiece& tree, bool allow_frontier_sites) {
+TreeFragment::TreeFragment(const StringPiece& tree, bool allow_frontier_sites) : frontier_sites(), terminals() {
   int bal = 0;
   const unsigned len = tree.size();
   unsigned cur = 0;
@@ -5,6 +5,7 @@
 #include "stringlib.h"
 #include "tdict.h"
 #include "rule_lexer.h"
+#include "tree_fragment.h"
 
 using namespace std;
 
@@ -107,3 +108,57 @@ string TRule::AsString(bool verbose) const {
   }
   return os.str();
 }
+
+// the symbols of a tree fragment carry cdec::*_BIT flags in their high bits
+// and a word id, except for the internal nodes on a right hand side, which
+// are node indices. codes holds the flags, sizes and indices, words the
+// words in the order they occur.
+void TRule::FlattenTree(const cdec::TreeFragment& t, vector<unsigned>* codes, vector<string>* words) {
+  codes->clear();
+  words->clear();
+  codes->push_back(t.root & ~cdec::ALL_MASK);
+  words->push_back(TD::Convert(t.root & cdec::ALL_MASK));
+  codes->push_back(t.frontier_sites);
+  codes->push_back(t.terminals);
+  codes->push_back(t.nodes.size());
+  for (unsigned i = 0; i < t.nodes.size(); ++i) {
+    const cdec::TreeFragmentProduction& p = t.nodes[i];
+    codes->push_back(p.lhs & ~cdec::ALL_MASK);
+    words->push_back(TD::Convert(p.lhs & cdec::ALL_MASK));
+    codes->push_back(static_cast<unsigned short>(p.span.first));
+    codes->push_back(static_cast<unsigned short>(p.span.second));
+    codes->push_back(p.rhs.size());
+    for (unsigned j = 0; j < p.rhs.size(); ++j) {
+      const unsigned x = p.rhs[j];
+      codes->push_back(x & ~cdec::ALL_MASK);
+      if (cdec::IsRHS(x))
+        codes->push_back(x & cdec::ALL_MASK);
+      else
+        words->push_back(TD::Convert(x & cdec::ALL_MASK));
+    }
+  }
+}
+
+boost::shared_ptr<cdec::TreeFragment> TRule::UnflattenTree(const vector<unsigned>& codes, const vector<string>& words) {
+  boost::shared_ptr<cdec::TreeFragment> t(new cdec::TreeFragment);
+  unsigned c = 0, w = 0;
+  t->root = codes[c++] | TD::Convert(words[w++]);
+  t->frontier_sites = codes[c++];
+  t->terminals = codes[c++];
+  t->nodes.resize(codes[c++]);
+  for (unsigned i = 0; i < t->nodes.size(); ++i) {
+    cdec::TreeFragmentProduction& p = t->nodes[i];
+    p.lhs = codes[c++] | TD::Convert(words[w++]);
+    p.span.first = static_cast<short>(codes[c++]);
+    p.span.second = static_cast<short>(codes[c++]);
+    p.rhs.resize(codes[c++]);
+    for (unsigned j = 0; j < p.rhs.size(); ++j) {
+      const unsigned flags = codes[c++];
+      if (cdec::IsRHS(flags))
+        p.rhs[j] = flags | codes[c++];
+      else
+        p.rhs[j] = flags | TD::Convert(words[w++]);
+    }
+  }
+  return t;
+}
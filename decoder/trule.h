@@ -8,6 +8,10 @@
 
 #include "boost/shared_ptr.hpp"
 #include "boost/functional/hash.hpp"
+#include "boost/serialization/shared_ptr.hpp"
+#include "boost/serialization/string.hpp"
+#include "boost/serialization/vector.hpp"
+#include "boost/serialization/version.hpp"
 
 #include "sparse_vector.h"
 #include "wordid.h"
@@ -166,6 +170,7 @@ class TRule {
   boost::shared_ptr<cdec::TreeFragment> tree_structure;
 
   friend class boost::serialization::access;
+  // version 0 stored only lhs_, f_, e_, arity_ and scores_
   template<class Archive>
   void save(Archive & ar, const unsigned int /*version*/) const {
     ar & TD::Convert(-lhs_);
@@ -193,9 +198,27 @@ class TRule {
       if (e_[i] <= 0) ar & e_[i]; else ar & TD::Convert(e_[i]);
     ar & arity_;
     ar & scores_;
+    ar & prev_i;
+    ar & prev_j;
+    unsigned a_size = a_.size();
+    ar & a_size;
+    for (unsigned i = 0; i < a_size; ++i) {
+      ar & a_[i].s_;
+      ar & a_[i].t_;
+    }
+    ar & parent_rule_;
+    const bool has_tree = static_cast<bool>(tree_structure);
+    ar & has_tree;
+    if (has_tree) {
+      std::vector<unsigned> codes;
+      std::vector<std::string> words;
+      FlattenTree(*tree_structure, &codes, &words);
+      ar & codes;
+      ar & words;
+    }
   }
   template<class Archive>
-  void load(Archive & ar, const unsigned int /*version*/) {
+  void load(Archive & ar, const unsigned int version) {
     std::string lhs; ar & lhs; lhs_ = -TD::Convert(lhs);
     unsigned f_size; ar & f_size;
     f_.resize(f_size);
@@ -222,10 +245,34 @@ class TRule {
     }
     ar & arity_;
     ar & scores_;
+    if (version < 1) return;
+    ar & prev_i;
+    ar & prev_j;
+    unsigned a_size; ar & a_size;
+    a_.resize(a_size);
+    for (unsigned i = 0; i < a_size; ++i) {
+      ar & a_[i].s_;
+      ar & a_[i].t_;
+    }
+    ar & parent_rule_;
+    bool has_tree; ar & has_tree;
+    tree_structure.reset();
+    if (has_tree) {
+      std::vector<unsigned> codes;
+      std::vector<std::string> words;
+      ar & codes;
+      ar & words;
+      tree_structure = UnflattenTree(codes, words);
+    }
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER()
  private:
+  // the tree structure as numbers and the strings of its words, which
+  // can be archived without the definition of cdec::TreeFragment
+  static void FlattenTree(const cdec::TreeFragment& t, std::vector<unsigned>* codes, std::vector<std::string>* words);
+  static boost::shared_ptr<cdec::TreeFragment> UnflattenTree(const std::vector<unsigned>& codes, const std::vector<std::string>& words);
+
   TRule(const WordID& src, const WordID& trg) : e_(1, trg), f_(1, src), lhs_(), arity_(), prev_i(), prev_j() {}
 };
 
@@ -240,4 +287,6 @@ inline bool operator==(const TRule& a, const TRule& b) {
   return (a.lhs_ == b.lhs_ && a.e_ == b.e_ && a.f_ == b.f_);
 }
 
+BOOST_CLASS_VERSION(TRule, 1)
+
 #endif
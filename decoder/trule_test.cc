@@ -1,4 +1,5 @@
 #include "trule.h"
+#include "rule_arena.h"
 
 #define BOOST_TEST_MODULE TRuleTest
 #include <boost/test/unit_test.hpp>
@@ -7,6 +8,7 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <sstream>
 #include "tdict.h"
 
@@ -57,6 +59,43 @@ BOOST_AUTO_TEST_CASE(TestRuleR) {
   BOOST_CHECK_EQUAL(t6.e_[3], 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestRuleArena) {
+  boost::shared_ptr<RuleArena> arena(new RuleArena(256));
+  boost::weak_ptr<RuleArena> weak_arena(arena);
+  vector<TRulePtr> rules;
+  for (int i = 0; i < 20; ++i)
+    rules.push_back(NewRule(arena, "[X] ||| den [X,1] sah ||| saw the [X,1] ||| F=0.5"));
+  BOOST_CHECK_GT(arena->bytes_allocated(), 20 * sizeof(TRule));
+  arena.reset();
+  BOOST_CHECK(!weak_arena.expired());  // kept alive by the rules
+  for (int i = 0; i < 20; ++i) {
+    BOOST_CHECK_EQUAL(rules[i]->Arity(), 1);
+    BOOST_CHECK_EQUAL(rules[i]->e_[2], 0);
+    BOOST_CHECK_CLOSE(rules[i]->scores_.value(FD::Convert("F")), 0.5, 1e-6);
+  }
+  TRulePtr copy = rules[3];
+  rules.clear();
+  BOOST_CHECK(!weak_arena.expired());
+  BOOST_CHECK_EQUAL(copy->AsString(false), "[X] ||| den [X] sah ||| saw the [1]");
+  copy.reset();
+  BOOST_CHECK(weak_arena.expired());
+
+  // blocks start small and double up to the maximum size
+  RuleArena growing(256, 1024);
+  growing.Allocate(1);
+  BOOST_CHECK_EQUAL(growing.bytes_reserved(), 256u);
+  growing.Allocate(256);
+  BOOST_CHECK_EQUAL(growing.bytes_reserved(), 256u + 512);
+  growing.Allocate(512);
+  growing.Allocate(512);
+  BOOST_CHECK_EQUAL(growing.bytes_reserved(), 256u + 512 + 1024);
+  growing.Allocate(512);
+  BOOST_CHECK_EQUAL(growing.bytes_reserved(), 256u + 512 + 1024 + 1024);
+  // larger allocations get a block of their own
+  growing.Allocate(4096);
+  BOOST_CHECK_EQUAL(growing.bytes_reserved(), 256u + 512 + 1024 + 1024 + 4096);
+}
+
 BOOST_AUTO_TEST_CASE(TestReadWriteHG_Boost) {
   string str;
   string t7str;
@@ -36,7 +36,7 @@ Alignment::Alignment() {}
 
 Alignment::~Alignment() {}
 
-vector<pair<int, int>> Alignment::GetLinks(int sentence_index) const {
+const vector<pair<int, int>>& Alignment::GetLinks(int sentence_index) const {
   return alignments[sentence_index];
 }
 
@@ -24,8 +24,9 @@ class Alignment {
   // Creates empty alignment.
   Alignment();
 
-  // Returns the alignment for a given sentence.
-  virtual vector<pair<int, int>> GetLinks(int sentence_index) const;
+  // Returns the alignment for a given sentence. The links are not copied, the
+  // reference remains valid for the lifetime of the alignment.
+  virtual const vector<pair<int, int>>& GetLinks(int sentence_index) const;
 
   virtual ~Alignment();
 
@@ -60,7 +60,7 @@ PhraseLocation BackoffSampler::Sample(
     }
   }
 
-  return PhraseLocation(samples, GetNumSubpatterns(location));
+  return PhraseLocation(move(samples), GetNumSubpatterns(location));
 }
 
 } // namespace extractor
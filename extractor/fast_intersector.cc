@@ -41,8 +41,12 @@ PhraseLocation FastIntersector::Intersect(
       && vocabulary->IsTerminal(symbols.back()));
 
   if (precomputation->Contains(symbols)) {
-    return PhraseLocation(precomputation->GetCollocations(symbols),
-                          phrase.Arity() + 1);
+    // The precomputed collocations outlive the phrase location, so they are
+    // referenced (with an empty owner) instead of being copied.
+    shared_ptr<const vector<int>> collocations(
+        shared_ptr<const vector<int>>(),
+        &precomputation->GetCollocations(symbols));
+    return PhraseLocation(collocations, phrase.Arity() + 1);
   }
 
   bool prefix_ends_with_x =
@@ -68,7 +72,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     PhraseLocation& prefix_location, const Phrase& phrase,
     bool prefix_ends_with_x, int next_symbol) const {
   ExtendPhraseLocation(prefix_location);
-  vector<int> positions = *prefix_location.matchings;
+  const vector<int>& positions = *prefix_location.matchings;
   int num_subpatterns = prefix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -76,7 +80,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
   int data_array_symbol = data_array->GetWordId(
       vocabulary->GetTerminalValue(next_symbol));
   if (data_array_symbol == -1) {
-    return PhraseLocation(new_positions, num_subpatterns);
+    return PhraseLocation(move(new_positions), num_subpatterns);
   }
 
   pair<int, int> range = GetSearchRange(prefix_ends_with_x);
@@ -107,14 +111,14 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     }
   }
 
-  return PhraseLocation(new_positions, phrase.Arity() + 1);
+  return PhraseLocation(move(new_positions), phrase.Arity() + 1);
 }
 
 PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     PhraseLocation& suffix_location, const Phrase& phrase,
     bool suffix_starts_with_x, int prev_symbol) const {
   ExtendPhraseLocation(suffix_location);
-  vector<int> positions = *suffix_location.matchings;
+  const vector<int>& positions = *suffix_location.matchings;
   int num_subpatterns = suffix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -122,7 +126,7 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
   int data_array_symbol = data_array->GetWordId(
       vocabulary->GetTerminalValue(prev_symbol));
   if (data_array_symbol == -1) {
-    return PhraseLocation(new_positions, num_subpatterns);
+    return PhraseLocation(move(new_positions), num_subpatterns);
   }
 
   pair<int, int> range = GetSearchRange(suffix_starts_with_x);
@@ -150,7 +154,7 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     }
   }
 
-  return PhraseLocation(new_positions, phrase.Arity() + 1);
+  return PhraseLocation(move(new_positions), phrase.Arity() + 1);
 }
 
 void FastIntersector::ExtendPhraseLocation(PhraseLocation& location) const {
@@ -159,10 +163,12 @@ void FastIntersector::ExtendPhraseLocation(PhraseLocation& location) const {
   }
 
   location.num_subpatterns = 1;
-  location.matchings = make_shared<vector<int>>();
+  shared_ptr<vector<int>> matchings = make_shared<vector<int>>();
+  matchings->reserve(location.sa_high - location.sa_low);
   for (int i = location.sa_low; i < location.sa_high; ++i) {
-    location.matchings->push_back(suffix_array->GetSuffix(i));
+    matchings->push_back(suffix_array->GetSuffix(i));
   }
+  location.matchings = matchings;
   location.sa_low = location.sa_high = 0;
 }
 
@@ -82,7 +82,7 @@ TEST_F(FastIntersectorTest, TestCachedCollocation) {
 
   EXPECT_CALL(*precomputation, Contains(symbols)).WillRepeatedly(Return(true));
   EXPECT_CALL(*precomputation, GetCollocations(symbols)).
-      WillRepeatedly(Return(expected_location));
+      WillRepeatedly(ReturnRef(expected_location));
   intersector = make_shared<FastIntersector>(suffix_array, precomputation,
                                              vocabulary, 15, 1);
 
@@ -90,6 +90,8 @@ TEST_F(FastIntersectorTest, TestCachedCollocation) {
       prefix_location, suffix_location, phrase);
 
   EXPECT_EQ(PhraseLocation(expected_location, 2), result);
+  // The precomputed collocations are shared, not copied.
+  EXPECT_EQ(&expected_location, result.matchings.get());
   EXPECT_EQ(PhraseLocation(15, 16), prefix_location);
   EXPECT_EQ(PhraseLocation(16, 17), suffix_location);
 }
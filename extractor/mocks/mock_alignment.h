@@ -8,7 +8,7 @@ typedef vector<pair<int, int>> SentenceLinks;
 
 class MockAlignment : public Alignment {
  public:
-  MOCK_CONST_METHOD1(GetLinks, SentenceLinks(int sentence_id));
+  MOCK_CONST_METHOD1(GetLinks, const SentenceLinks&(int sentence_id));
 };
 
 } // namespace extractor
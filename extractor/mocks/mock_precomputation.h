@@ -7,7 +7,8 @@ namespace extractor {
 class MockPrecomputation : public Precomputation {
  public:
   MOCK_CONST_METHOD1(Contains, bool(const vector<int>& pattern));
-  MOCK_CONST_METHOD1(GetCollocations, vector<int>(const vector<int>& pattern));
+  MOCK_CONST_METHOD1(GetCollocations,
+                     const vector<int>&(const vector<int>& pattern));
 };
 
 } // namespace extractor
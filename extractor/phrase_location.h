@@ -17,12 +17,21 @@ namespace extractor {
  * represents the start of the i-th subpattern of the phrase. If the phrase
  * doesn't contain any nonterminals, then it may also be represented as the
  * range in the suffix array which matches the phrase.
+ *
+ * The matchings are immutable and may be shared between several phrase
+ * locations (e.g. with the index of precomputed collocations), so copying a
+ * PhraseLocation never copies the matchings.
  */
 struct PhraseLocation {
   PhraseLocation(int sa_low = -1, int sa_high = -1);
 
   PhraseLocation(const vector<int>& matchings, int num_subpatterns);
 
+  // Takes over the matchings without copying them.
+  PhraseLocation(vector<int>&& matchings, int num_subpatterns);
+
+  PhraseLocation(shared_ptr<const vector<int>> matchings, int num_subpatterns);
+
   // Checks if a phrase has any occurrences in the source data.
   bool IsEmpty() const;
 
@@ -32,7 +41,7 @@ struct PhraseLocation {
   friend bool operator==(const PhraseLocation& a, const PhraseLocation& b);
 
   int sa_low, sa_high;
-  shared_ptr<vector<int>> matchings;
+  shared_ptr<const vector<int>> matchings;
   int num_subpatterns;
 };
 
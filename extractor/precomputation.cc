@@ -192,7 +192,8 @@ bool Precomputation::Contains(const vector<int>& pattern) const {
   return index.count(pattern);
 }
 
-vector<int> Precomputation::GetCollocations(const vector<int>& pattern) const {
+const vector<int>& Precomputation::GetCollocations(
+    const vector<int>& pattern) const {
   return index.at(pattern);
 }
 
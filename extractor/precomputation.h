@@ -50,8 +50,9 @@ class Precomputation {
   // Returns whether a pattern is contained in the index of collocations.
   virtual bool Contains(const vector<int>& pattern) const;
 
-  // Returns the list of collocations for a given pattern.
-  virtual vector<int> GetCollocations(const vector<int>& pattern) const;
+  // Returns the list of collocations for a given pattern. The collocations are
+  // not copied, the reference remains valid for the lifetime of the index.
+  virtual const vector<int>& GetCollocations(const vector<int>& pattern) const;
 
   bool operator==(const Precomputation& other) const;
 
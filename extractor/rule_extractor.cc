@@ -77,13 +77,14 @@ RuleExtractor::~RuleExtractor() {}
 vector<Rule> RuleExtractor::ExtractRules(const Phrase& phrase,
                                          const PhraseLocation& location) const {
   int num_subpatterns = location.num_subpatterns;
-  vector<int> matchings = *location.matchings;
+  const vector<int>& matchings = *location.matchings;
 
   // Calculate statistics for the (sampled) occurrences of the source phrase.
   map<Phrase, double> source_phrase_counter;
   map<Phrase, map<Phrase, map<PhraseAlignment, int>>> alignments_counter;
+  vector<int> matching(num_subpatterns);
   for (auto i = matchings.begin(); i != matchings.end(); i += num_subpatterns) {
-    vector<int> matching(i, i + num_subpatterns);
+    matching.assign(i, i + num_subpatterns);
     vector<Extract> extracts = ExtractAlignments(phrase, matching);
 
     for (Extract e: extracts) {
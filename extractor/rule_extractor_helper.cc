@@ -37,7 +37,7 @@ void RuleExtractorHelper::GetLinksSpans(
 
   target_low = vector<int>(target_sent_len, -1);
   target_high = vector<int>(target_sent_len, -1);
-  vector<pair<int, int>> links = alignment->GetLinks(sentence_id);
+  const vector<pair<int, int>>& links = alignment->GetLinks(sentence_id);
   for (auto link: links) {
     if (source_low[link.first] == -1 || source_low[link.first] > link.second) {
       source_low[link.first] = link.second;
@@ -23,13 +23,14 @@ class RuleExtractorHelperTest : public Test {
     EXPECT_CALL(*target_data_array, GetSentenceLength(_))
         .WillRepeatedly(Return(12));
 
-    vector<pair<int, int>> links = {
+    links = {
       make_pair(0, 0), make_pair(0, 1), make_pair(2, 2), make_pair(3, 1)
     };
     alignment = make_shared<MockAlignment>();
-    EXPECT_CALL(*alignment, GetLinks(_)).WillRepeatedly(Return(links));
+    EXPECT_CALL(*alignment, GetLinks(_)).WillRepeatedly(ReturnRef(links));
   }
 
+  vector<pair<int, int>> links;
   shared_ptr<MockDataArray> source_data_array;
   shared_ptr<MockDataArray> target_data_array;
   shared_ptr<MockAlignment> alignment;
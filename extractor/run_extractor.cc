@@ -83,7 +83,12 @@ int main(int argc, char** argv) {
         "False if phrases may be loose (better, but slower)")
     ("leave_one_out", po::value<bool>()->zero_tokens(),
         "do leave-one-out estimation of grammars "
-        "(e.g. for extracting grammars for the training set");
+        "(e.g. for extracting grammars for the training set")
+    ("streaming", "Read input sentences incrementally and print each <seg> "
+        "line as soon as its grammar and all the grammars before it are "
+        "written")
+    ("window", po::value<unsigned>()->default_value(1000),
+        "Maximum number of sentences held in memory in streaming mode");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -104,6 +109,11 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (vm["window"].as<unsigned>() == 0) {
+    cerr << "The window must hold at least one sentence." << endl;
+    return 1;
+  }
+
   int num_threads = vm["threads"].as<int>();
   cerr << "Grammar extraction will use " << num_threads << " threads." << endl;
 
@@ -212,40 +222,65 @@ int main(int argc, char** argv) {
     fs::create_directory(grammar_path);
   }
 
-  // Reads all sentences for which we extract grammar rules (the paralellization
-  // is simplified if we read all sentences upfront).
+  // Reads the sentences for which we extract grammar rules. By default, all
+  // sentences are read upfront. In streaming mode, sentences are read in
+  // windows of bounded size, so that extraction can start before the input is
+  // exhausted.
+  bool leave_one_out = vm.count("leave_one_out");
+  size_t window_size = vm.count("streaming") ? vm["window"].as<unsigned>() : 0;
+  size_t offset = 0;
   string sentence;
   vector<string> sentences;
-  while (getline(cin, sentence)) {
-    sentences.push_back(sentence);
-  }
-
-  // Extracts the grammar for each sentence and saves it to a file.
-  bool leave_one_out = vm.count("leave_one_out");
-  vector<string> suffixes(sentences.size());
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
+  while (cin) {
+    sentences.clear();
+    while ((window_size == 0 || sentences.size() < window_size) &&
+           getline(cin, sentence)) {
+      sentences.push_back(sentence);
     }
-    suffixes[i] = suffix;
-
-    unordered_set<int> blacklisted_sentence_ids;
-    if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+    if (sentences.empty()) {
+      break;
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
-    output << grammar;
-  }
 
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, i) << " id=\""
-         << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
+    // Extracts the grammar for each sentence and saves it to a file. The <seg>
+    // line for a sentence is printed as soon as the sentence and all the
+    // sentences before it have been processed.
+    vector<string> suffixes(sentences.size());
+    vector<bool> done(sentences.size(), false);
+    size_t next_output = 0;
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      string suffix;
+      size_t position = sentences[i].find("|||");
+      if (position != sentences[i].npos) {
+        suffix = sentences[i].substr(position);
+        sentences[i] = sentences[i].substr(0, position);
+      }
+      suffixes[i] = suffix;
+
+      unordered_set<int> blacklisted_sentence_ids;
+      if (leave_one_out) {
+        blacklisted_sentence_ids.insert(offset + i);
+      }
+      Grammar grammar = extractor.GetGrammar(
+          sentences[i], blacklisted_sentence_ids);
+      {
+        ofstream output(GetGrammarFilePath(grammar_path, offset + i).c_str());
+        output << grammar;
+      }
+
+      #pragma omp critical (output)
+      {
+        done[i] = true;
+        for (; next_output < sentences.size() && done[next_output];
+             ++next_output) {
+          size_t j = next_output;
+          cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, offset + j)
+               << " id=\"" << offset + j << "\"> " << sentences[j]
+               << " </seg> " << suffixes[j] << endl;
+        }
+      }
+    }
+    offset += sentences.size();
   }
 
   Clock::time_point extraction_stop_time = Clock::now();
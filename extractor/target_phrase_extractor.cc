@@ -124,7 +124,7 @@ void TargetPhraseExtractor::GeneratePhrases(
     }
 
     // Construct the alignment between the source and the target phrase.
-    vector<pair<int, int>> links = alignment->GetLinks(sentence_id);
+    const vector<pair<int, int>>& links = alignment->GetLinks(sentence_id);
     vector<pair<int, int>> alignment;
     for (pair<int, int> link: links) {
       if (target_indexes.count(link.second)) {
@@ -54,7 +54,7 @@ TEST_F(TargetPhraseExtractorTest, TestExtractTightPhrasesTrue) {
     make_pair(0, 0), make_pair(1, 3), make_pair(2, 2), make_pair(3, 1),
     make_pair(4, 4)
   };
-  EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(Return(links));
+  EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(ReturnRef(links));
 
   vector<int> gap_order = {1, 0};
   EXPECT_CALL(*helper, GetGapOrder(_)).WillRepeatedly(Return(gap_order));
@@ -95,7 +95,7 @@ TEST_F(TargetPhraseExtractorTest, TestExtractPhrasesTightPhrasesFalse) {
   }
 
   vector<pair<int, int>> links = {make_pair(1, 1)};
-  EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(Return(links));
+  EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(ReturnRef(links));
 
   vector<int> gap_order = {0};
   EXPECT_CALL(*helper, GetGapOrder(_)).WillRepeatedly(Return(gap_order));
@@ -63,9 +63,9 @@ class TranslationTableTest : public Test {
     vector<pair<int, int>> links2 = {make_pair(1, 0), make_pair(2, 1)};
     vector<pair<int, int>> links3 = {make_pair(0, 0), make_pair(2, 1)};
     shared_ptr<MockAlignment> alignment = make_shared<MockAlignment>();
-    EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(Return(links1));
-    EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(Return(links2));
-    EXPECT_CALL(*alignment, GetLinks(2)).WillRepeatedly(Return(links3));
+    EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(ReturnRef(links1));
+    EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(ReturnRef(links2));
+    EXPECT_CALL(*alignment, GetLinks(2)).WillRepeatedly(ReturnRef(links3));
 
     table = TranslationTable(source_data_array, target_data_array, alignment);
   }
@@ -94,6 +94,16 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
         // Amount of additional content that should be considered by the next call.
         unsigned char &next_use) const;
 
+    /* Optional optimization: hint that p(new_word | context) will be queried
+     * soon.  The context is in reverse order as in FullScoreForgotState.  For
+     * the probing model this prefetches the hash table entries of every n-gram
+     * the query will look up, so that several queries issued in a row overlap
+     * their cache misses.  
+     */
+    void Prefetch(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word) const {
+      search_.Prefetch(context_rbegin, context_rend, new_word);
+    }
+
     /* Return probabilities minus rest costs for an array of pointers.  The
      * first length should be the length of the n-gram to which pointers_begin
      * points.  
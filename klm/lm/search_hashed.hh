@@ -125,6 +125,24 @@ template <class Value> class HashedSearch {
       return LongestPointer(found->value.prob);
     }
 
+    // Prefetch the entries that scoring new_word after the context (in reverse
+    // order) will look up.  Only the first Order() - 1 context words matter.
+    void Prefetch(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word) const {
+#if defined(__GNUC__)
+      __builtin_prefetch(&unigram_.Lookup(new_word));
+#endif
+      Node node = static_cast<Node>(new_word);
+      unsigned char order_minus_2 = 0;
+      for (const WordIndex *i = context_rbegin; i != context_rend; ++i, ++order_minus_2) {
+        node = CombineWordHash(node, *i);
+        if (order_minus_2 == middle_.size()) {
+          longest_.Prefetch(node);
+          return;
+        }
+        middle_[order_minus_2].Prefetch(node);
+      }
+    }
+
     // Generate a node without necessarily checking that it actually exists.
     // Optionally return false if it's know to not exist.
     bool FastMakeNode(const WordIndex *begin, const WordIndex *end, Node &node) const {
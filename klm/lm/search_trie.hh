@@ -100,6 +100,10 @@ template <class Quant, class Bhiksha> class TrieSearch {
       return true;
     }
 
+    // Trie lookups depend on the previous level's result, so there is nothing
+    // to prefetch ahead of time.
+    void Prefetch(const WordIndex *, const WordIndex *, const WordIndex) const {}
+
   private:
     friend void BuildTrie<Quant, Bhiksha>(SortedFiles &files, std::vector<uint64_t> &counts, const Config &config, TrieSearch<Quant, Bhiksha> &out, Quant &quant, SortedVocabulary &vocab, BinaryFormat &backing);
 
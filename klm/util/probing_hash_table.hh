@@ -149,6 +149,14 @@ template <class EntryT, class HashT, class EqualT = std::equal_to<typename Entry
       }
     }
 
+    // Hint that key will be looked up soon.  Issuing several prefetches before
+    // the corresponding Find calls overlaps their cache misses.
+    template <class Key> void Prefetch(const Key key) const {
+#if defined(__GNUC__)
+      __builtin_prefetch(begin_ + (hash_(key) % buckets_));
+#endif
+    }
+
     void Clear() {
       Entry invalid;
       invalid.SetKey(invalid_);
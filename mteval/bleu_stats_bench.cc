@@ -0,0 +1,106 @@
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "ns.h"
+#include "tdict.h"
+
+using namespace std;
+
+// times the IBM BLEU sufficient statistics of SegmentEvaluator (which counts
+// n-grams in a hash trie compiled from the references) against the
+// straightforward counts in maps that scorer_test checks them with
+
+typedef map<vector<WordID>, int> NGramCounts;
+
+static void CountNGrams(const vector<WordID>& sent, NGramCounts* counts) {
+  for (unsigned j = 0; j < sent.size(); ++j)
+    for (unsigned n = 1; n <= 4 && j + n <= sent.size(); ++n)
+      ++(*counts)[vector<WordID>(sent.begin() + j, sent.begin() + j + n)];
+}
+
+static void MapBleuStats(const vector<WordID>& hyp,
+                         const vector<vector<WordID> >& refs,
+                         const NGramCounts& max_ref,
+                         vector<float>* stats) {
+  NGramCounts h;
+  CountNGrams(hyp, &h);
+  stats->assign(10, 0);
+  for (NGramCounts::iterator it = h.begin(); it != h.end(); ++it) {
+    const unsigned n = it->first.size();
+    NGramCounts::const_iterator r = max_ref.find(it->first);
+    if (r != max_ref.end()) (*stats)[n - 1] += min(it->second, r->second);
+    (*stats)[n + 3] += it->second;
+  }
+  (*stats)[8] = hyp.size();
+  float best = refs[0].size();
+  for (unsigned r = 1; r < refs.size(); ++r)
+    if (fabs(refs[r].size() - (float)hyp.size()) < fabs(best - hyp.size()))
+      best = refs[r].size();
+  (*stats)[9] = best;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [iterations (1000)]\n";
+    return 1;
+  }
+  const int kIterations = argc > 1 ? atoi(argv[1]) : 1000;
+  if (kIterations < 1) {
+    cerr << "The number of iterations must be positive\n";
+    return 1;
+  }
+  // four references of 25-28 words and 100 hypotheses of 15-34 words over a
+  // small vocabulary, so that most n-grams are shared and clipped
+  vector<WordID> vocab;
+  TD::ConvertSentence("export of high-tech products in guangdong us dollars billion", &vocab);
+  srand(7);
+  vector<vector<WordID> > refs(4);
+  for (unsigned r = 0; r < refs.size(); ++r)
+    for (unsigned i = 0; i < 25 + r; ++i)
+      refs[r].push_back(vocab[rand() % 6]);
+  vector<vector<WordID> > hyps(100);
+  for (unsigned h = 0; h < hyps.size(); ++h)
+    for (unsigned i = 0; i < 15 + h % 20; ++i)
+      hyps[h].push_back(vocab[rand() % vocab.size()]);
+
+  NGramCounts max_ref;
+  for (unsigned r = 0; r < refs.size(); ++r) {
+    NGramCounts c;
+    CountNGrams(refs[r], &c);
+    for (NGramCounts::iterator it = c.begin(); it != c.end(); ++it)
+      max_ref[it->first] = max(max_ref[it->first], it->second);
+  }
+
+  EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
+  boost::shared_ptr<SegmentEvaluator> eval = metric->CreateSegmentEvaluator(refs);
+  SufficientStats stats;
+  vector<float> expected;
+  for (unsigned h = 0; h < hyps.size(); ++h) {
+    eval->Evaluate(hyps[h], &stats);
+    MapBleuStats(hyps[h], refs, max_ref, &expected);
+    if (stats.fields != expected) {
+      cerr << "The statistics of hypothesis " << h << " differ\n";
+      return 1;
+    }
+  }
+
+  clock_t t = clock();
+  for (int it = 0; it < kIterations; ++it)
+    for (unsigned h = 0; h < hyps.size(); ++h)
+      eval->Evaluate(hyps[h], &stats);
+  const double t_eval = double(clock() - t) / CLOCKS_PER_SEC;
+  t = clock();
+  for (int it = 0; it < kIterations; ++it)
+    for (unsigned h = 0; h < hyps.size(); ++h)
+      MapBleuStats(hyps[h], refs, max_ref, &expected);
+  const double t_map = double(clock() - t) / CLOCKS_PER_SEC;
+  cout << "BLEU stats for " << kIterations * hyps.size() << " hypotheses: "
+       << t_eval << "s (SegmentEvaluator) vs. " << t_map << "s (maps)" << endl;
+  return 0;
+}
@@ -9,6 +9,7 @@
 #include "tdict.h"
 #include "ns.h"
 #include "ns_docscorer.h"
+#include "parallel_for.h"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -19,6 +20,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("reference,r",po::value<vector<string> >(), "[1 or more required] Reference translation(s) in tokenized text files")
         ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
         ("in_file,i", po::value<string>()->default_value("-"), "Input file")
+        ("threads,t", po::value<unsigned>()->default_value(1), "Number of threads to score sentences with (not used for external metrics such as METEOR)")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -34,6 +36,18 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   }
 }
 
+struct SentenceScorer {
+  SentenceScorer(const DocumentScorer& d,
+                 const vector<vector<WordID> >& h,
+                 vector<SufficientStats>* s) : ds(d), hyps(h), stats(s) {}
+  void operator()(size_t i) const {
+    ds[i]->Evaluate(hyps[i], &(*stats)[i]);
+  }
+  const DocumentScorer& ds;
+  const vector<vector<WordID> >& hyps;
+  vector<SufficientStats>* stats;
+};
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -49,24 +63,32 @@ int main(int argc, char** argv) {
   DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
   cerr << "Loaded " << ds.size() << " references for scoring with " << loss_function << endl;
 
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1 && !metric->IsThreadSafe()) {
+    cerr << loss_function << " cannot be used from several threads, scoring with one\n";
+    threads = 1;
+  }
+
+  // the dictionary is not thread-safe, so all hypotheses are converted first
   ReadFile rf(conf["in_file"].as<string>());
-  SufficientStats acc;
   istream& in = *rf.stream();
-  int lc = 0;
+  vector<vector<WordID> > hyps;
   string line;
   while(getline(in, line)) {
-    vector<WordID> sent;
-    TD::ConvertSentence(line, &sent);
-    SufficientStats t;
-    ds[lc]->Evaluate(sent, &t);
-    acc += t;
-    ++lc;
+    hyps.push_back(vector<WordID>());
+    TD::ConvertSentence(line, &hyps.back());
   }
+  const int lc = hyps.size();
   assert(lc > 0);
   if (lc > ds.size()) {
     cerr << "Too many (" << lc << ") translations in input, expected " << ds.size() << endl;
     return 1;
   }
+  vector<SufficientStats> stats(lc);
+  ParallelFor(lc, threads, SentenceScorer(ds, hyps, &stats));
+  SufficientStats acc;
+  for (int i = 0; i < lc; ++i)
+    acc += stats[i];
   if (lc != ds.size())
     cerr << "Fewer sentences in hyp (" << lc << ") than refs ("
          << ds.size() << "): scoring partial set!\n";
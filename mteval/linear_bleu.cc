@@ -0,0 +1,46 @@
+#include "linear_bleu.h"
+
+#include <cmath>
+#include <set>
+
+using namespace std;
+
+LinearBleu::LinearBleu(double p, double r, unsigned order) : theta_(order + 1) {
+  theta_[0] = -1.0;
+  for (unsigned n = 1; n <= order; ++n)
+    theta_[n] = 1.0 / (order * p * pow(r, n - 1.0));
+}
+
+void LinearBleu::AddHypothesis(const vector<WordID>& hyp,
+                               double posterior,
+                               NGramPosteriors* posts) const {
+  set<vector<WordID> > seen;
+  const unsigned s = hyp.size();
+  for (unsigned j = 0; j < s; ++j) {
+    const unsigned k = min(order(), s - j);
+    for (unsigned n = 1; n <= k; ++n) {
+      vector<WordID> ngram(hyp.begin() + j, hyp.begin() + j + n);
+      if (seen.insert(ngram).second)
+        (*posts)[ngram] += posterior;
+    }
+  }
+}
+
+double LinearBleu::Gain(const vector<WordID>& hyp,
+                        const NGramPosteriors& posts) const {
+  double gain = theta_[0] * hyp.size();
+  const unsigned s = hyp.size();
+  vector<WordID> ngram;
+  for (unsigned j = 0; j < s; ++j) {
+    const unsigned k = min(order(), s - j);
+    ngram.clear();
+    for (unsigned n = 1; n <= k; ++n) {
+      ngram.push_back(hyp[j + n - 1]);
+      NGramPosteriors::const_iterator it = posts.find(ngram);
+      // no longer n-gram starting here can have a posterior either
+      if (it == posts.end()) break;
+      gain += theta_[n] * it->second;
+    }
+  }
+  return gain;
+}
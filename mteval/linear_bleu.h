@@ -0,0 +1,53 @@
+#ifndef LINEAR_BLEU_H_
+#define LINEAR_BLEU_H_
+
+#include <vector>
+#include <boost/functional/hash.hpp>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include "wordid.h"
+
+// Linear corpus BLEU (Tromble et al., 2008), a first order approximation of
+// the change in corpus BLEU when a hypothesis E' is added to the corpus:
+//
+//   G(E') = theta_0 |E'| + sum_w theta_|w| #_w(E') p(w)
+//
+// where #_w(E') counts n-gram w in E' and p(w) is the posterior probability
+// of w (or its expected count).  With p(w) given once per sentence, every
+// hypothesis is scored in time linear in its length, which makes MBR linear
+// in the size of the k-best list or forest rather than quadratic.
+class LinearBleu {
+ public:
+  typedef std::unordered_map<std::vector<WordID>, double,
+                             boost::hash<std::vector<WordID> > > NGramPosteriors;
+
+  // p is the average unigram precision and r the ratio of successive n-gram
+  // precisions; Tromble et al. estimate p=0.85, r=0.72 but the defaults
+  // below are more common in practice
+  explicit LinearBleu(double p = 0.8, double r = 0.6, unsigned order = 4);
+
+  unsigned order() const { return theta_.size() - 1; }
+  // theta(0) is the per word penalty
+  double theta(unsigned n) const { return theta_[n]; }
+
+  // adds the n-grams in hyp to posts, weighted by hyp's posterior
+  // probability; every n-gram is counted once per hypothesis, so that
+  // after adding a whole k-best list posts contains p(w)
+  void AddHypothesis(const std::vector<WordID>& hyp,
+                     double posterior,
+                     NGramPosteriors* posts) const;
+
+  // G(hyp) given the n-gram posteriors
+  double Gain(const std::vector<WordID>& hyp,
+              const NGramPosteriors& posts) const;
+
+ private:
+  std::vector<double> theta_;
+};
+
+#endif
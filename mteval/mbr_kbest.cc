@@ -1,3 +1,4 @@
+#include <atomic>
 #include <iostream>
 #include <vector>
 
@@ -13,8 +14,10 @@ namespace std { using std::tr1::unordered_map; }
 #include "prob.h"
 #include "tdict.h"
 #include "ns.h"
+#include "linear_bleu.h"
 #include "filelib.h"
 #include "stringlib.h"
+#include "parallel_for.h"
 
 using namespace std;
 
@@ -27,7 +30,11 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("scale,a",po::value<vector<double> >(), "Posterior scaling factors (per file)")
         ("offset,b",po::value<vector<double> >(), "Log posterior offsets (per file)")
         ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric")
+        ("linear_bleu,l", "Use linear BLEU (Tromble et al., 2008) with n-gram posteriors from the list instead of --evaluation_metric; linear rather than quadratic in the list size")
+        ("unigram_precision,p",po::value<double>()->default_value(0.8), "Linear BLEU: average unigram precision")
+        ("precision_ratio,r",po::value<double>()->default_value(0.6), "Linear BLEU: ratio of successive n-gram precisions")
         ("output_list,L", "Show reranked list as output")
+        ("threads,t",po::value<unsigned>()->default_value(1), "Number of threads to score lists with (not used for external metrics such as METEOR)")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -102,6 +109,88 @@ bool ReadKBestList(const vector<double>& mbr_scale,
   return !list->empty();
 }
 
+// a k-best list together with its MBR scores
+struct MBRList {
+  string sent_id;
+  vector<pair<vector<WordID>, prob_t> > list;
+  vector<double> posteriors;
+  vector<double> losses;
+};
+
+// computes the posteriors of a list and, for linear BLEU, the losses
+struct ListScorer {
+  ListScorer(const LinearBleu* b, vector<MBRList>* l) : lbleu(b), lists(l) {}
+  void operator()(size_t s) const {
+    MBRList& l = (*lists)[s];
+    const vector<pair<vector<WordID>, prob_t> >& list = l.list;
+    vector<prob_t> joints(list.size());
+    const prob_t max_score = list.front().second;
+    prob_t marginal = prob_t::Zero();
+    for (unsigned i = 0; i < list.size(); ++i) {
+      const prob_t joint = list[i].second / max_score;
+      joints[i] = joint;
+      //cerr << "list[" << i << "] joint=" << log(joint) << endl;
+      marginal += joint;
+    }
+    l.posteriors.resize(list.size());
+    for (unsigned i = 0; i < list.size(); ++i)
+      l.posteriors[i] = (joints[i] / marginal).as_float();
+    l.losses.resize(list.size());
+    if (lbleu) {
+      LinearBleu::NGramPosteriors posts;
+      for (unsigned i = 0; i < list.size(); ++i)
+        lbleu->AddHypothesis(list[i].first, l.posteriors[i], &posts);
+      for (unsigned i = 0; i < list.size(); ++i)
+        l.losses[i] = -lbleu->Gain(list[i].first, posts);
+    }
+  }
+  const LinearBleu* lbleu;
+  vector<MBRList>* lists;
+};
+
+// computes the expected loss of one hypothesis under metric; unless all
+// losses are required, the computation stops as soon as it exceeds the best
+// loss of the list found so far (which is shared by all threads)
+struct RowScorer {
+  RowScorer(const EvaluationMetric* m,
+            bool il,
+            bool ol,
+            const vector<pair<unsigned, unsigned> >& r,
+            vector<MBRList>* l,
+            vector<atomic<double> >* b) :
+      metric(m), is_loss(il), output_list(ol), rows(r), lists(l), best(b) {}
+  void operator()(size_t r) const {
+    MBRList& l = (*lists)[rows[r].first];
+    const unsigned i = rows[r].second;
+    atomic<double>& mbr_loss = (*best)[rows[r].first];
+    const vector<vector<WordID> > refs(1, l.list[i].first);
+    boost::shared_ptr<SegmentEvaluator> segeval = metric->
+        CreateSegmentEvaluator(refs);
+
+    double wl_acc = 0;
+    for (unsigned j = 0; j < l.list.size(); ++j) {
+      if (i != j) {
+        SufficientStats ss;
+        segeval->Evaluate(l.list[j].first, &ss);
+        double loss = 1.0 - metric->ComputeScore(ss);
+        if (is_loss) loss = 1.0 - loss;
+        double weighted_loss = loss * l.posteriors[j];
+        wl_acc += weighted_loss;
+        if ((!output_list) && wl_acc > mbr_loss) break;
+      }
+    }
+    l.losses[i] = wl_acc;
+    double cur = mbr_loss;
+    while (wl_acc < cur && !mbr_loss.compare_exchange_weak(cur, wl_acc)) {}
+  }
+  const EvaluationMetric* metric;
+  const bool is_loss;
+  const bool output_list;
+  const vector<pair<unsigned, unsigned> >& rows;
+  vector<MBRList>* lists;
+  vector<atomic<double> >* best;
+};
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -110,6 +199,14 @@ int main(int argc, char** argv) {
 
   const bool is_loss = (UppercaseString(smetric) == "TER");
   const bool output_list = conf.count("output_list") > 0;
+  const bool linear_bleu = conf.count("linear_bleu") > 0;
+  const LinearBleu lbleu(conf["unigram_precision"].as<double>(),
+                         conf["precision_ratio"].as<double>());
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1 && !linear_bleu && !metric->IsThreadSafe()) {
+    cerr << smetric << " cannot be used from several threads, using one\n";
+    threads = 1;
+  }
   vector<string> file;
   if (conf.count("input") == 0)
     file.push_back("-");
@@ -132,61 +229,63 @@ int main(int argc, char** argv) {
   for (unsigned i = 0; i < file.size(); ++i)
     cerr << "Kbest file " << (i+1) << ": " << file[i] << "\t(scale=" << mbr_scale[i] << ", offset=" << mbr_offset[i] << ")\n";
 
-  vector<pair<vector<WordID>, prob_t> > list;
   vector<ReadFile*> rfs(file.size());
   for (unsigned i = 0; i < file.size(); ++i)
     rfs[i] = new ReadFile(file[i]);
-  string sent_id;
-  while(ReadKBestList(mbr_scale, mbr_offset, rfs, &sent_id, &list)) {
-    vector<prob_t> joints(list.size());
-    const prob_t max_score = list.front().second;
-    prob_t marginal = prob_t::Zero();
-    for (int i = 0 ; i < list.size(); ++i) {
-      const prob_t joint = list[i].second / max_score;
-      joints[i] = joint;
-      //cerr << "list[" << i << "] joint=" << log(joint) << endl;
-      marginal += joint;
+  // lists are read (and the dictionary updated) by this thread only, and
+  // scored a batch at a time so that the output stays in input order
+  const unsigned batch_size = 16 * threads;
+  vector<MBRList> lists;
+  vector<pair<unsigned, unsigned> > rows;
+  bool more = true;
+  while (more) {
+    lists.clear();
+    while (lists.size() < batch_size) {
+      lists.push_back(MBRList());
+      if (!ReadKBestList(mbr_scale, mbr_offset, rfs, &lists.back().sent_id, &lists.back().list)) {
+        lists.pop_back();
+        more = false;
+        break;
+      }
+    }
+    ParallelFor(lists.size(), threads, ListScorer(linear_bleu ? &lbleu : NULL, &lists));
+    if (!linear_bleu) {
+      // large lists are split over the threads by hypothesis
+      rows.clear();
+      for (unsigned s = 0; s < lists.size(); ++s)
+        for (unsigned i = 0; i < lists[s].list.size(); ++i)
+          rows.push_back(make_pair(s, i));
+      vector<atomic<double> > best(lists.size());
+      for (unsigned s = 0; s < lists.size(); ++s)
+        best[s] = numeric_limits<double>::max();
+      ParallelFor(rows.size(), threads, RowScorer(metric, is_loss, output_list, rows, &lists, &best));
     }
-    int mbr_idx = -1;
-    vector<double> mbr_scores(output_list ? list.size() : 0);
-    double mbr_loss = numeric_limits<double>::max();
-    for (int i = 0 ; i < list.size(); ++i) {
-      const vector<vector<WordID> > refs(1, list[i].first);
-      boost::shared_ptr<SegmentEvaluator> segeval = metric->
-          CreateSegmentEvaluator(refs);
-
-      double wl_acc = 0;
-      for (int j = 0; j < list.size(); ++j) {
-        if (i != j) {
-          SufficientStats ss;
-          segeval->Evaluate(list[j].first, &ss);
-          double loss = 1.0 - metric->ComputeScore(ss);
-          if (is_loss) loss = 1.0 - loss;
-          double weighted_loss = loss * (joints[j] / marginal).as_float();
-          wl_acc += weighted_loss;
-          if ((!output_list) && wl_acc > mbr_loss) break;
+
+    for (unsigned s = 0; s < lists.size(); ++s) {
+      vector<pair<vector<WordID>, prob_t> >& list = lists[s].list;
+      const vector<double>& mbr_scores = lists[s].losses;
+      int mbr_idx = -1;
+      double mbr_loss = numeric_limits<double>::max();
+      for (unsigned i = 0; i < list.size(); ++i) {
+        if (mbr_scores[i] < mbr_loss) {
+          mbr_loss = mbr_scores[i];
+          mbr_idx = i;
         }
       }
-      if (output_list) mbr_scores[i] = wl_acc;
-      if (wl_acc < mbr_loss) {
-        mbr_loss = wl_acc;
-        mbr_idx = i;
+      // cerr << "ML translation: " << TD::GetString(list[0].first) << endl;
+      cerr << "MBR Best idx: " << mbr_idx << endl;
+      if (output_list) {
+        for (unsigned i = 0; i < list.size(); ++i)
+          list[i].second.logeq(mbr_scores[i]);
+        sort(list.begin(), list.end(), LossComparer());
+        for (unsigned i = 0; i < list.size(); ++i)
+          cout << lists[s].sent_id << " ||| "
+               << TD::GetString(list[i].first) << " ||| "
+               << log(list[i].second) << endl;
+      } else {
+        cout << TD::GetString(list[mbr_idx].first) << endl;
       }
     }
-    // cerr << "ML translation: " << TD::GetString(list[0].first) << endl;
-    cerr << "MBR Best idx: " << mbr_idx << endl;
-    if (output_list) {
-      for (int i = 0; i < list.size(); ++i)
-        list[i].second.logeq(mbr_scores[i]);
-      sort(list.begin(), list.end(), LossComparer());
-      for (int i = 0; i < list.size(); ++i)
-        cout << sent_id << " ||| "
-             << TD::GetString(list[i].first) << " ||| "
-             << log(list[i].second) << endl;
-    } else {
-      cout << TD::GetString(list[mbr_idx].first) << endl;
-    }
   }
   return 0;
 }
-
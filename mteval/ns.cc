@@ -10,6 +10,8 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <stdint.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -32,6 +34,10 @@ bool EvaluationMetric::IsErrorMetric() const {
   return false;
 }
 
+bool EvaluationMetric::IsThreadSafe() const {
+  return true;
+}
+
 struct DefaultSegmentEvaluator : public SegmentEvaluator {
   DefaultSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : refs_(refs), em_(em) {}
   void Evaluate(const vector<WordID>& hyp, SufficientStats* out) const {
@@ -65,6 +71,65 @@ string EvaluationMetric::DetailedScore(const SufficientStats& stats) const {
 }
 
 enum BleuType { IBM, Koehn, NIST, QCRI };
+
+// The reference n-grams of a segment, stored as a trie in an open addressed
+// hash table: an n-gram is identified by the id of its (n-1)-gram prefix and
+// its last word, so n-grams are matched exactly, one word at a time, and
+// looking them up never allocates.
+class NGramTable {
+ public:
+  enum { kNoPrefix = -1 };
+
+  NGramTable() : slots_(16, kEmpty), shift_(60) {}
+
+  int size() const { return keys_.size(); }
+
+  // returns the id of the n-gram prefix+w, or -1 if it is not in the table
+  int Find(int prefix, WordID w) const {
+    const uint64_t key = MakeKey(prefix, w);
+    for (size_t i = Hash(key); ; i = (i + 1) & (slots_.size() - 1)) {
+      const int id = slots_[i];
+      if (id == kEmpty || keys_[id] == key) return id;
+    }
+  }
+
+  // returns the id of the n-gram prefix+w, adding it if necessary
+  int Insert(int prefix, WordID w) {
+    const uint64_t key = MakeKey(prefix, w);
+    size_t i = Hash(key);
+    for (; slots_[i] != kEmpty; i = (i + 1) & (slots_.size() - 1))
+      if (keys_[slots_[i]] == key) return slots_[i];
+    slots_[i] = keys_.size();
+    keys_.push_back(key);
+    if (keys_.size() * 2 > slots_.size()) Rehash();
+    return keys_.size() - 1;
+  }
+
+ private:
+  enum { kEmpty = -1 };
+
+  static uint64_t MakeKey(int prefix, WordID w) {
+    return (static_cast<uint64_t>(prefix + 1) << 32) | static_cast<uint32_t>(w);
+  }
+  // Fibonacci hashing, keeping the top log2(slots_.size()) bits
+  size_t Hash(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ULL) >> shift_;
+  }
+  void Rehash() {
+    slots_.assign(slots_.size() * 2, kEmpty);
+    --shift_;
+    for (unsigned id = 0; id < keys_.size(); ++id) {
+      size_t i = Hash(keys_[id]);
+      while (slots_[i] != kEmpty) i = (i + 1) & (slots_.size() - 1);
+      slots_[i] = id;
+    }
+  }
+
+  vector<int> slots_;
+  int shift_;
+  vector<uint64_t> keys_;  // indexed by n-gram id
+};
+
 template <unsigned int N = 4u, BleuType BrevityType = IBM, bool CharBased = false>
 struct BleuSegmentEvaluator : public SegmentEvaluator {
   BleuSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : evaluation_metric(em) {
@@ -80,6 +145,7 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
       if (lengths_.back() < smallest) smallest = lengths_.back();
       CountRef(*ci);
     }
+    matched_.resize(counts_.size());
     if (BrevityType == Koehn)
       lengths_[0] = tot / local_refs.size();
     if (BrevityType == NIST)
@@ -92,7 +158,7 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     out->id_ = evaluation_metric->MetricId();
     for (unsigned i = 0; i < N+N+2; ++i) out->fields[i] = 0;
 
-    ComputeNgramStats(local_hyp, &out->fields[0], &out->fields[N], true);
+    ComputeNgramStats(local_hyp, &out->fields[0], &out->fields[N]);
     float& hyp_len = out->fields[2*N];
     float& ref_len = out->fields[2*N + 1];
     hyp_len = local_hyp.size();
@@ -111,83 +177,58 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     }
   }
 
-  struct NGramCompare {
-    int operator() (const vector<WordID>& a, const vector<WordID>& b) const {
-      const size_t as = a.size();
-      const size_t bs = b.size();
-      const size_t s = (as < bs ? as : bs);
-      for (size_t i = 0; i < s; ++i) {
-         int d = a[i] - b[i];
-         if (d < 0) return true;
-         if (d > 0) return false;
-      }
-      return as < bs;
-    }
-  };
-  typedef map<vector<WordID>, pair<int,int>, NGramCompare> NGramCountMap;
-
   void CountRef(const vector<WordID>& ref) {
-    NGramCountMap tc;
-    vector<WordID> ngram(N);
+    vector<int> tc;  // counts in this reference, indexed by n-gram id
     int s = ref.size();
     for (int j=0; j<s; ++j) {
       int remaining = s-j;
       int k = (N < remaining ? N : remaining);
-      ngram.clear();
+      int prefix = NGramTable::kNoPrefix;
       for (int i=1; i<=k; ++i) {
-        ngram.push_back(ref[j + i - 1]);
-        tc[ngram].first++;
+        prefix = ngrams_.Insert(prefix, ref[j + i - 1]);
+        if (prefix >= (int)tc.size()) tc.resize(prefix + 1);
+        tc[prefix]++;
       }
     }
-    for (typename NGramCountMap::iterator i = tc.begin(); i != tc.end(); ++i) {
-      pair<int,int>& p = ngrams_[i->first];
-      if (p.first < i->second.first)
-        p = i->second;
-    }
+    counts_.resize(ngrams_.size());
+    for (unsigned i = 0; i < tc.size(); ++i)
+      if (counts_[i] < tc[i])
+        counts_[i] = tc[i];
   }
 
   void ComputeNgramStats(const vector<WordID>& sent,
                          float* correct,  // N elements reserved
-                         float* hyp,      // N elements reserved
-                         bool clip_counts = true) const {
+                         float* hyp) const {  // N elements reserved
     // clear clipping stats
-    for (typename NGramCountMap::iterator it = ngrams_.begin(); it != ngrams_.end(); ++it)
-      it->second.second = 0;
+    std::fill(matched_.begin(), matched_.end(), 0);
 
-    vector<WordID> ngram(N);
-    *correct *= 0;
-    *hyp *= 0;
     int s = sent.size();
     for (int j=0; j<s; ++j) {
       int remaining = s-j;
       int k = (N < remaining ? N : remaining);
-      ngram.clear();
+      int prefix = NGramTable::kNoPrefix;
       for (int i=1; i<=k; ++i) {
-        ngram.push_back(sent[j + i - 1]);
-        pair<int,int>& p = ngrams_[ngram];
-        if(clip_counts){
-          if (p.second < p.first) {
-            ++p.second;
-            correct[i-1]++;
-          }
-        } else {
-          ++p.second;
-          correct[i-1]++;
-        }
+        prefix = ngrams_.Find(prefix, sent[j + i - 1]);
         // if the 1 gram isn't found, don't try to match don't need to match any 2- 3- .. grams:
-        if (!p.first) {
+        if (prefix < 0) {
           for (; i<=k; ++i)
             hyp[i-1]++;
-        } else {
-          hyp[i-1]++;
+          break;
+        }
+        if (matched_[prefix] < counts_[prefix]) {
+          ++matched_[prefix];
+          correct[i-1]++;
         }
+        hyp[i-1]++;
       }
     }
   }
 
   const EvaluationMetric* evaluation_metric;
   vector<float> lengths_;
-  mutable NGramCountMap ngrams_;
+  NGramTable ngrams_;
+  vector<int> counts_;  // clipping counts, indexed by n-gram id
+  mutable vector<int> matched_;
 };
 
 template <unsigned int N = 4u, BleuType BrevityType = IBM, bool CharBased = false>
@@ -107,6 +107,11 @@ class EvaluationMetric {
   // false for metrics like BLEU and METEOR where higher scores are better
   virtual bool IsErrorMetric() const;
 
+  // returns false if segment evaluators (or the metric itself) share state,
+  // e.g. a connection to an external scoring process, and so may not be
+  // used from several threads at once
+  virtual bool IsThreadSafe() const;
+
   virtual unsigned SufficientStatisticsVectorSize() const;
   virtual float ComputeScore(const SufficientStats& stats) const = 0;
   virtual std::string DetailedScore(const SufficientStats& stats) const;
@@ -85,3 +85,9 @@ unsigned CombinationMetric::SufficientStatisticsVectorSize() const {
   return total_size;
 }
 
+
+bool CombinationMetric::IsThreadSafe() const {
+  for (unsigned i = 0; i < metrics.size(); ++i)
+    if (!metrics[i]->IsThreadSafe()) return false;
+  return true;
+}
@@ -164,6 +164,10 @@ float ExternalMetric::ComputeScore(const SufficientStats& stats) const {
   return eval_server->ComputeScore(stats.fields);
 }
 
+bool ExternalMetric::IsThreadSafe() const {
+  return false;
+}
+
 ExternalMetric::ExternalMetric(const string& metric_name, const std::string& command) :
     EvaluationMetric(metric_name),
     eval_server(new NScoreServer(command)) {}
@@ -13,6 +13,7 @@ class ExternalMetric : public EvaluationMetric {
                                            const std::vector<std::vector<WordID> >& refs,
                                            SufficientStats* out) const;
   virtual float ComputeScore(const SufficientStats& stats) const;
+  virtual bool IsThreadSafe() const;
 
  protected:
   NScoreServer* eval_server;
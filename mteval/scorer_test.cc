@@ -1,4 +1,6 @@
 #include <iostream>
+#include <map>
+#include <cstdlib>
 #define BOOST_TEST_MODULE ScoreTest
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
@@ -224,6 +226,70 @@ BOOST_AUTO_TEST_CASE(NewScoreAPI) {
   //cerr << metric->ComputeScore(statse) << endl;
 }
 
+// straightforward version of the IBM BLEU sufficient statistics, counting
+// n-grams in maps
+typedef map<vector<WordID>, int> NGramCounts;
+
+static void CountNGrams(const vector<WordID>& sent, NGramCounts* counts) {
+  for (unsigned j = 0; j < sent.size(); ++j)
+    for (unsigned n = 1; n <= 4 && j + n <= sent.size(); ++n)
+      ++(*counts)[vector<WordID>(sent.begin() + j, sent.begin() + j + n)];
+}
+
+static void MapBleuStats(const vector<WordID>& hyp,
+                         const vector<vector<WordID> >& refs,
+                         const NGramCounts& max_ref,
+                         vector<float>* stats) {
+  NGramCounts h;
+  CountNGrams(hyp, &h);
+  stats->assign(10, 0);
+  for (NGramCounts::iterator it = h.begin(); it != h.end(); ++it) {
+    const unsigned n = it->first.size();
+    NGramCounts::const_iterator r = max_ref.find(it->first);
+    if (r != max_ref.end()) (*stats)[n - 1] += min(it->second, r->second);
+    (*stats)[n + 3] += it->second;
+  }
+  (*stats)[8] = hyp.size();
+  float best = refs[0].size();
+  for (unsigned r = 1; r < refs.size(); ++r)
+    if (fabs(refs[r].size() - (float)hyp.size()) < fabs(best - hyp.size()))
+      best = refs[r].size();
+  (*stats)[9] = best;
+}
+
+BOOST_AUTO_TEST_CASE(BLEUStatsMatchMapCounts) {
+  // small vocabulary, so that most n-grams are shared and clipped
+  srand(7);
+  vector<vector<WordID> > refs(4);
+  for (unsigned r = 0; r < refs.size(); ++r)
+    for (unsigned i = 0; i < 25 + r; ++i)
+      refs[r].push_back(refs0[0][rand() % 6]);
+  vector<vector<WordID> > hyps(100);
+  for (unsigned h = 0; h < hyps.size(); ++h)
+    for (unsigned i = 0; i < 15 + h % 20; ++i)
+      hyps[h].push_back(refs0[1][rand() % 9]);
+  hyps.push_back(hyp1);
+  hyps.push_back(vector<WordID>());
+
+  NGramCounts max_ref;
+  for (unsigned r = 0; r < refs.size(); ++r) {
+    NGramCounts c;
+    CountNGrams(refs[r], &c);
+    for (NGramCounts::iterator it = c.begin(); it != c.end(); ++it)
+      max_ref[it->first] = max(max_ref[it->first], it->second);
+  }
+
+  EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
+  boost::shared_ptr<SegmentEvaluator> eval = metric->CreateSegmentEvaluator(refs);
+  SufficientStats stats;
+  vector<float> expected;
+  for (unsigned h = 0; h < hyps.size(); ++h) {
+    eval->Evaluate(hyps[h], &stats);
+    MapBleuStats(hyps[h], refs, max_ref, &expected);
+    BOOST_CHECK(stats.fields == expected);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(HybridSourceReferenceFileFormat) {
   std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
   EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
@@ -10,7 +10,7 @@ logger = logging.getLogger('rt.aligner')
 
 class ForceAligner:
 
-    def __init__(self, fwd_params, fwd_err, rev_params, rev_err, heuristic='grow-diag-final-and'):
+    def __init__(self, fwd_params, fwd_err, rev_params, rev_err, heuristic='grow-diag-final-and', threads=1):
 
         cdec_root = os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
         fast_align = os.path.join(cdec_root, 'word-aligner', 'fast_align')
@@ -19,8 +19,9 @@ class ForceAligner:
         (fwd_T, fwd_m) = self.read_err(fwd_err)
         (rev_T, rev_m) = self.read_err(rev_err)
 
-        fwd_cmd = [fast_align, '-i', '-', '-d', '-T', fwd_T, '-m', fwd_m, '-f', fwd_params]
-        rev_cmd = [fast_align, '-i', '-', '-d', '-T', rev_T, '-m', rev_m, '-f', rev_params, '-r']
+        # Batch mode: each request is the number of lines followed by the lines
+        fwd_cmd = [fast_align, '-i', '-', '-d', '-T', fwd_T, '-m', fwd_m, '-f', fwd_params, '-b', '-j', str(threads)]
+        rev_cmd = [fast_align, '-i', '-', '-d', '-T', rev_T, '-m', rev_m, '-f', rev_params, '-r', '-b', '-j', str(threads)]
         tools_cmd = [atools, '-i', '-', '-j', '-', '-c', heuristic]
 
         logger.info('Executing: {}'.format(' '.join(fwd_cmd)))
@@ -41,17 +42,29 @@ class ForceAligner:
 
     def align_formatted(self, line):
         '''Threadsafe, FIFO'''
+        return self.align_batch([line])[0]
+
+    def align_batch(self, lines):
+        '''Threadsafe, FIFO.  Aligns a list of 'source ||| target' lines with
+        a single request to each aligner'''
         self.lock.acquire()
-        self.fwd_align.stdin.write('{}\n'.format(line))
-        self.rev_align.stdin.write('{}\n'.format(line))
-        # f words ||| e words ||| links ||| score
-        fwd_line = self.fwd_align.stdout.readline().split('|||')[2].strip()
-        rev_line = self.rev_align.stdout.readline().split('|||')[2].strip()
-        self.tools.stdin.write('{}\n'.format(fwd_line))
-        self.tools.stdin.write('{}\n'.format(rev_line))
-        al_line = self.tools.stdout.readline().strip()
+        # Empty lines are empty sentence pairs, each with its own alignment
+        batch = '{}\n'.format(len(lines)) + ''.join('{}\n'.format(line) for line in lines)
+        self.fwd_align.stdin.write(batch)
+        self.rev_align.stdin.write(batch)
+        fwd_lines = self.read_batch(self.fwd_align.stdout, len(lines))
+        rev_lines = self.read_batch(self.rev_align.stdout, len(lines))
+        al_lines = []
+        for (fwd_line, rev_line) in zip(fwd_lines, rev_lines):
+            self.tools.stdin.write('{}\n'.format(fwd_line))
+            self.tools.stdin.write('{}\n'.format(rev_line))
+            al_lines.append(self.tools.stdout.readline().strip())
         self.lock.release()
-        return al_line
+        return al_lines
+
+    def read_batch(self, stream, n):
+        # n lines of f words ||| e words ||| links ||| score
+        return [stream.readline().split('|||')[2].strip() for _ in range(n)]
  
     def close(self, force=False):
         if not force:
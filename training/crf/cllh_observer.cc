@@ -21,22 +21,14 @@ void ConditionalLikelihoodObserver::NotifyDecodingStart(const SentenceMetadata&)
 void ConditionalLikelihoodObserver::NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg) {
   assert(state == 1);
   state = 2;
-  SparseVector<prob_t> cur_model_exp;
-  const prob_t z = InsideOutside<prob_t,
-                                 EdgeProb,
-                                 SparseVector<prob_t>,
-                                 EdgeFeaturesAndProbWeightFunction>(*hg, &cur_model_exp);
+  const prob_t z = Inside<prob_t, EdgeProb>(*hg);
   cur_obj = log(z);
 }
 
 void ConditionalLikelihoodObserver::NotifyAlignmentForest(const SentenceMetadata& smeta, Hypergraph* hg) {
   assert(state == 2);
   state = 3;
-  SparseVector<prob_t> ref_exp;
-  const prob_t ref_z = InsideOutside<prob_t,
-                                     EdgeProb,
-                                     SparseVector<prob_t>,
-                                     EdgeFeaturesAndProbWeightFunction>(*hg, &ref_exp);
+  const prob_t ref_z = Inside<prob_t, EdgeProb>(*hg);
 
   double log_ref_z = log(ref_z);
 
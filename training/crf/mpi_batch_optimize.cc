@@ -24,6 +24,7 @@ namespace mpi = boost::mpi;
 #include "ff_register.h"
 #include "decoder.h"
 #include "filelib.h"
+#include "fork_workers.h"
 #include "stringlib.h"
 #include "optimize.h"
 #include "fdict.h"
@@ -45,7 +46,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
 	("correction_buffers,M", po::value<int>()->default_value(10), "Number of gradients for LBFGS to maintain in memory")
         ("gaussian_prior,p","Use a Gaussian prior on the weights")
         ("sigma_squared", po::value<double>()->default_value(1.0), "Sigma squared term for spherical Gaussian prior")
-        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior");
+        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior")
+        ("jobs,j", po::value<unsigned>()->default_value(1), "Number of worker processes to decode with (without MPI)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -107,12 +109,8 @@ struct TrainingObserver : public DecoderObserver {
   virtual void NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg) {
     assert(state == 1);
     state = 2;
-    const prob_t z = InsideOutside<prob_t,
-                                   EdgeProb,
-                                   SparseVector<prob_t>,
-                                   EdgeFeaturesAndProbWeightFunction>(*hg, &cur_model_exp);
+    const prob_t z = FeatureExpectations<EdgeProb>(*hg, &cur_model_exp);
     cur_obj = log(z);
-    cur_model_exp /= z;
   }
 
   // compute "empirical" expectations, numerator of objective
@@ -120,11 +118,7 @@ struct TrainingObserver : public DecoderObserver {
     assert(state == 2);
     state = 3;
     SparseVector<prob_t> ref_exp;
-    const prob_t ref_z = InsideOutside<prob_t,
-                                       EdgeProb,
-                                       SparseVector<prob_t>,
-                                       EdgeFeaturesAndProbWeightFunction>(*hg, &ref_exp);
-    ref_exp /= ref_z;
+    const prob_t ref_z = FeatureExpectations<EdgeProb>(*hg, &ref_exp);
 
     double log_ref_z;
 #if 0
@@ -165,6 +159,101 @@ struct TrainingObserver : public DecoderObserver {
   int state;
 };
 
+// the statistics a worker process sends back to its parent; the parent's
+// observer is reset before the workers are started, so it ends up with the
+// sum over all workers
+void WriteStats(const TrainingObserver& o, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&o.acc_obj), sizeof(o.acc_obj));
+  out->write(reinterpret_cast<const char*>(&o.trg_words), sizeof(o.trg_words));
+  out->write(reinterpret_cast<const char*>(&o.total_complete), sizeof(o.total_complete));
+  const unsigned n = o.acc_grad.size();
+  out->write(reinterpret_cast<const char*>(&n), sizeof(n));
+  for (SparseVector<prob_t>::const_iterator it = o.acc_grad.begin(); it != o.acc_grad.end(); ++it) {
+    const int fid = it->first;
+    const double val = it->second.as_float();
+    out->write(reinterpret_cast<const char*>(&fid), sizeof(fid));
+    out->write(reinterpret_cast<const char*>(&val), sizeof(val));
+  }
+}
+
+bool ReadStats(istream* in, TrainingObserver* o) {
+  double obj;
+  unsigned trg_words, n;
+  int complete;
+  if (!in->read(reinterpret_cast<char*>(&obj), sizeof(obj)) ||
+      !in->read(reinterpret_cast<char*>(&trg_words), sizeof(trg_words)) ||
+      !in->read(reinterpret_cast<char*>(&complete), sizeof(complete)) ||
+      !in->read(reinterpret_cast<char*>(&n), sizeof(n))) return false;
+  o->acc_obj += obj;
+  o->trg_words += trg_words;
+  o->total_complete += complete;
+  for (unsigned i = 0; i < n; ++i) {
+    int fid;
+    double val;
+    if (!in->read(reinterpret_cast<char*>(&fid), sizeof(fid)) ||
+        !in->read(reinterpret_cast<char*>(&val), sizeof(val))) return false;
+    o->acc_grad.add_value(fid, prob_t(val));
+  }
+  return true;
+}
+
+void WriteStats(const ConditionalLikelihoodObserver& o, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&o.acc_obj), sizeof(o.acc_obj));
+  out->write(reinterpret_cast<const char*>(&o.trg_words), sizeof(o.trg_words));
+}
+
+bool ReadStats(istream* in, ConditionalLikelihoodObserver* o) {
+  double obj;
+  unsigned trg_words;
+  if (!in->read(reinterpret_cast<char*>(&obj), sizeof(obj)) ||
+      !in->read(reinterpret_cast<char*>(&trg_words), sizeof(trg_words))) return false;
+  o->acc_obj += obj;
+  o->trg_words += trg_words;
+  return true;
+}
+
+// worker k of ForkDecode: decodes sentences k, k + jobs, ... (with the ids
+// they would get if the corpus were decoded in order, starting at first_id)
+// and sends the statistics it accumulated
+template <class Observer>
+struct DecodeWorker {
+  DecodeWorker(const vector<string>& c, int f, unsigned j, Decoder* d, Observer* o) :
+      corpus(c), first_id(f), jobs(j), decoder(d), observer(o) {}
+  bool operator()(unsigned k, ostream* out) const {
+    for (unsigned i = k; i < corpus.size(); i += jobs) {
+      decoder->SetId(first_id + i);
+      decoder->Decode(corpus[i], observer);
+    }
+    WriteStats(*observer, out);
+    return true;
+  }
+  const vector<string>& corpus;
+  const int first_id;
+  const unsigned jobs;
+  Decoder* decoder;
+  Observer* observer;
+};
+
+template <class Observer>
+struct StatsReader {
+  explicit StatsReader(Observer* o) : observer(o) {}
+  bool operator()(unsigned, istream* in) const { return ReadStats(in, observer); }
+  Observer* observer;
+};
+
+// decodes corpus with jobs worker processes forked from this one (see
+// fork_workers.h), so decoding needs no locks. Each worker accumulates its
+// own statistics, which are added to observer in worker order. The
+// sentences get the ids first_id, first_id + 1, ..., and the decoder of this
+// process continues with the id after them, as if it had decoded them.
+template <class Observer>
+void ForkDecode(const vector<string>& corpus, int first_id, unsigned jobs, Decoder* decoder, Observer* observer) {
+  DecodeWorker<Observer> work(corpus, first_id, jobs, decoder, observer);
+  StatsReader<Observer> read(observer);
+  ForkWorkers(jobs, work, read);
+  decoder->SetId(first_id + corpus.size());
+}
+
 void ReadConfig(const string& ini, vector<string>* out) {
   ReadFile rf(ini);
   istream& in = *rf.stream();
@@ -265,8 +354,15 @@ int main(int argc, char** argv) {
   if (conf.count("test_data"))
     ReadTrainingCorpus(conf["test_data"].as<string>(), rank, size, &test_corpus);
 
+  const unsigned jobs = conf["jobs"].as<unsigned>();
+  if (jobs > 1 && size > 1) {
+    cerr << "--jobs cannot be used with MPI\n";
+    return 1;
+  }
+
   TrainingObserver observer;
   ConditionalLikelihoodObserver cllh_observer;
+  int next_id = 0;  // the id the decoder gives the next sentence
   while (!converged) {
     observer.Reset();
     cllh_observer.Reset();
@@ -278,8 +374,13 @@ int main(int argc, char** argv) {
       cerr << "Starting decoding... (~" << corpus.size() << " sentences / proc)\n";
       cerr << "  Testset size: " << test_corpus.size() << " sentences / proc)\n";
     }
-    for (int i = 0; i < corpus.size(); ++i)
-      decoder->Decode(corpus[i], &observer);
+    if (jobs > 1) {
+      ForkDecode(corpus, next_id, jobs, decoder, &observer);
+    } else {
+      for (unsigned i = 0; i < corpus.size(); ++i)
+        decoder->Decode(corpus[i], &observer);
+    }
+    next_id += corpus.size();
     cerr << "  process " << rank << '/' << size << " done\n";
     fill(gradient.begin(), gradient.end(), 0);
     observer.SetLocalGradientAndObjective(&gradient, &objective);
@@ -301,8 +402,13 @@ int main(int argc, char** argv) {
     if (rank == 0)
       cerr << "TRAINING CORPUS: ln p(f|e)=" << objective << "\t log_2 p(f|e) = " << (objective/log(2)) << "\t cond. entropy = " << (objective/log(2) / total_words) << "\t ppl = " << pow(2, (objective/log(2) / total_words)) << endl;
 
-    for (int i = 0; i < test_corpus.size(); ++i)
-      decoder->Decode(test_corpus[i], &cllh_observer);
+    if (jobs > 1) {
+      ForkDecode(test_corpus, next_id, jobs, decoder, &cllh_observer);
+    } else {
+      for (unsigned i = 0; i < test_corpus.size(); ++i)
+        decoder->Decode(test_corpus[i], &cllh_observer);
+    }
+    next_id += test_corpus.size();
 
     double test_objective = 0;
     unsigned test_total_words = 0;
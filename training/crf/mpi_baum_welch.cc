@@ -101,11 +101,7 @@ struct TrainingObserver : public DecoderObserver {
     trg_words += smeta.GetSourceLength();
     state = 2;
     SparseVector<prob_t> exps;
-    const prob_t z = InsideOutside<prob_t,
-                                   EdgeProb,
-                                   SparseVector<prob_t>,
-                                   EdgeFeaturesAndProbWeightFunction>(*hg, &exps);
-    exps /= z;
+    const prob_t z = FeatureExpectations<EdgeProb>(*hg, &exps);
     for (SparseVector<prob_t>::iterator it = exps.begin(); it != exps.end(); ++it)
       acc_grad.add_value(it->first, it->second.as_float());
 
@@ -316,19 +316,12 @@ int main(int argc, char** argv) {
           hg.Reweight(cur_weights);
           hg_gold.Reweight(cur_weights);
           SparseVector<prob_t> model_exp, gold_exp;
-          const prob_t z = InsideOutside<prob_t,
-                                         EdgeProb,
-                                         SparseVector<prob_t>,
-                                         EdgeFeaturesAndProbWeightFunction>(hg, &model_exp);
+          const prob_t z = FeatureExpectations<EdgeProb>(hg, &model_exp);
           local_obj += log(z);
-          model_exp /= z;
           AddGrad(model_exp, 1.0, &local_grad);
           model_exp.clear();
 
-          const prob_t goldz = InsideOutside<prob_t,
-                                         EdgeProb,
-                                         SparseVector<prob_t>,
-                                         EdgeFeaturesAndProbWeightFunction>(hg_gold, &gold_exp);
+          const prob_t goldz = FeatureExpectations<EdgeProb>(hg_gold, &gold_exp);
           local_obj -= log(goldz);
 
           if (log(z) - log(goldz) < kMINUS_EPSILON) {
@@ -336,7 +329,6 @@ int main(int argc, char** argv) {
             return 1;
           }
 
-          gold_exp /= goldz;
           AddGrad(gold_exp, -1.0, &local_grad);
         }
 
@@ -110,12 +110,8 @@ struct TrainingObserver : public DecoderObserver {
   virtual void NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg) {
     assert(state == 1);
     state = 2;
-    const prob_t z = InsideOutside<prob_t,
-                                   EdgeProb,
-                                   SparseVector<prob_t>,
-                                   EdgeFeaturesAndProbWeightFunction>(*hg, &cur_model_exp);
+    const prob_t z = FeatureExpectations<EdgeProb>(*hg, &cur_model_exp);
     cur_obj = log(z);
-    cur_model_exp /= z;
   }
 
   // compute "empirical" expectations, numerator of objective
@@ -123,11 +119,7 @@ struct TrainingObserver : public DecoderObserver {
     assert(state == 2);
     state = 3;
     SparseVector<prob_t> ref_exp;
-    const prob_t ref_z = InsideOutside<prob_t,
-                                       EdgeProb,
-                                       SparseVector<prob_t>,
-                                       EdgeFeaturesAndProbWeightFunction>(*hg, &ref_exp);
-    ref_exp /= ref_z;
+    const prob_t ref_z = FeatureExpectations<EdgeProb>(*hg, &ref_exp);
 
     double log_ref_z;
 #if 0
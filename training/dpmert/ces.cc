@@ -2,7 +2,6 @@
 
 #include <vector>
 #include <sstream>
-#include <boost/shared_ptr.hpp>
 
 // TODO, if AER is to be optimized again, we will need this
 // #include "aligner.h"
@@ -21,17 +20,18 @@ void ComputeErrorSurface(const SegmentEvaluator& ss,
                          const EvaluationMetric* metric,
                          const Hypergraph& hg) {
   vector<WordID> prev_trans;
-  const vector<boost::shared_ptr<MERTPoint> >& ienv = ve.GetSortedSegs();
+  const vector<int>& ienv = ve.GetSortedSegs();
+  const MERTPointPool& pool = ve.GetPool();
   env->resize(ienv.size());
   SufficientStats prev_score; // defaults to 0
   int j = 0;
   for (unsigned i = 0; i < ienv.size(); ++i) {
-    const MERTPoint& seg = *ienv[i];
+    const MERTPoint& seg = pool[ienv[i]];
     vector<WordID> trans;
 #if 0
     if (type == AER) {
       vector<bool> edges(hg.edges_.size(), false);
-      seg.CollectEdgesUsed(&edges);  // get the set of edges in the viterbi
+      pool.CollectEdgesUsed(ienv[i], &edges);  // get the set of edges in the viterbi
                                      // alignment
       ostringstream os;
       const string* psrc = ss.GetSource();
@@ -53,7 +53,7 @@ void ComputeErrorSurface(const SegmentEvaluator& ss,
       TD::ConvertSentence(tstr.substr(tstr.rfind(" ||| ") + 5), &trans);
     } else {
 #endif
-      seg.ConstructTranslation(&trans);
+      pool.ConstructTranslation(ienv[i], &trans);
     //}
     //cerr << "Scoring: " << TD::GetString(trans) << endl;
     if (trans == prev_trans) {
@@ -40,15 +40,16 @@ BOOST_AUTO_TEST_CASE( TestCheckNaN) {
 }
 
 BOOST_AUTO_TEST_CASE(TestConvexHull) {
-  boost::shared_ptr<MERTPoint> a1(new MERTPoint(-1, 0));
-  boost::shared_ptr<MERTPoint> b1(new MERTPoint(1, 0));
-  boost::shared_ptr<MERTPoint> a2(new MERTPoint(-1, 1));
-  boost::shared_ptr<MERTPoint> b2(new MERTPoint(1, -1));
-  vector<boost::shared_ptr<MERTPoint> > sa; sa.push_back(a1); sa.push_back(b1);
-  vector<boost::shared_ptr<MERTPoint> > sb; sb.push_back(a2); sb.push_back(b2);
-  ConvexHull a(sa);
+  MERTPointPool pool;
+  const int a1 = pool.Add(MERTPoint(-1, 0));
+  const int b1 = pool.Add(MERTPoint(1, 0));
+  const int a2 = pool.Add(MERTPoint(-1, 1));
+  const int b2 = pool.Add(MERTPoint(1, -1));
+  vector<int> sa; sa.push_back(a1); sa.push_back(b1);
+  vector<int> sb; sb.push_back(a2); sb.push_back(b2);
+  ConvexHull a(&pool, sa);
   cerr << a << endl;
-  ConvexHull b(sb);
+  ConvexHull b(&pool, sb);
   ConvexHull c = a;
   c *= b;
   cerr << a << " (*) " << b << " = " << c << endl;
@@ -75,11 +76,12 @@ BOOST_AUTO_TEST_CASE(TestConvexHullInside) {
     cerr << log(d->score) << " ||| " << TD::GetString(d->yield) << " ||| " << d->feature_values << endl;
   }
   SparseVector<double> dir; dir.set_value(FD::Convert("f1"), 1.0);
-  ConvexHullWeightFunction wf(wts, dir);
+  MERTPointPool pool;
+  ConvexHullWeightFunction wf(wts, dir, &pool);
   ConvexHull env = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
   cerr << env << endl;
-  const vector<boost::shared_ptr<MERTPoint> >& segs = env.GetSortedSegs();
-  dir *= segs[1]->x;
+  const vector<int>& segs = env.GetSortedSegs();
+  dir *= pool[segs[1]].x;
   wts += dir;
   hg.Reweight(wts);
   KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> kbest2(hg, 10);
@@ -92,7 +94,7 @@ BOOST_AUTO_TEST_CASE(TestConvexHullInside) {
   for (unsigned i = 0; i < segs.size(); ++i) {
     cerr << "seg=" << i << endl;
     vector<WordID> trans;
-    segs[i]->ConstructTranslation(&trans);
+    pool.ConstructTranslation(segs[i], &trans);
     cerr << TD::GetString(trans) << endl;
   }
 }
@@ -159,7 +161,8 @@ BOOST_AUTO_TEST_CASE( TestS1) {
   cerr << "Computing Viterbi envelope using inside algorithm...\n";
   cerr << "axis: " << axis << endl;
   clock_t t_start=clock();
-  ConvexHullWeightFunction wf(wts, axis);  // wts = starting point, axis = search direction
+  MERTPointPool pool;
+  ConvexHullWeightFunction wf(wts, axis, &pool);  // wts = starting point, axis = search direction
   envs[0] = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
   envs[1] = Inside<ConvexHull, ConvexHullWeightFunction>(hg2, NULL, wf);
 
@@ -214,7 +217,8 @@ BOOST_AUTO_TEST_CASE(TestZeroOrigin) {
   }
  
   SparseVector<double> axis; axis.set_value(FD::Convert("Glue"),1.0);
-  ConvexHullWeightFunction wf(wts, axis);  // wts = starting point, axis = search direction
+  MERTPointPool pool;
+  ConvexHullWeightFunction wf(wts, axis, &pool);  // wts = starting point, axis = search direction
   vector<ConvexHull> envs(1);
   envs[0] = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
 
@@ -5,11 +5,11 @@
 
 using namespace std;
 
-ConvexHull::ConvexHull(int i) {
+ConvexHull::ConvexHull(int i) : pool(), is_sorted(true) {
   if (i == 0) {
     // do nothing - <>
   } else if (i == 1) {
-    points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(0, 0, 0, boost::shared_ptr<MERTPoint>(), boost::shared_ptr<MERTPoint>())));
+    points.push_back(-1);
     assert(this->IsMultiplicativeIdentity());
   } else {
     cerr << "Only can create ConvexHull semiring 0 and 1 with this constructor!\n";
@@ -20,15 +20,17 @@ ConvexHull::ConvexHull(int i) {
 const ConvexHull ConvexHullWeightFunction::operator()(const Hypergraph::Edge& e) const {
   const double m = direction.dot(e.feature_values_);
   const double b = origin.dot(e.feature_values_);
-  MERTPoint* point = new MERTPoint(m, b, e);
-  return ConvexHull(1, point);
+  return ConvexHull(pool, pool->Add(MERTPoint(m, b, e)));
 }
 
 ostream& operator<<(ostream& os, const ConvexHull& env) {
   os << '<';
-  const vector<boost::shared_ptr<MERTPoint> >& points = env.GetSortedSegs();
-  for (int i = 0; i < points.size(); ++i)
-    os << (i==0 ? "" : "|") << "x=" << points[i]->x << ",b=" << points[i]->b << ",m=" << points[i]->m << ",p1=" << points[i]->p1 << ",p2=" << points[i]->p2;
+  const vector<int>& points = env.GetSortedSegs();
+  for (int i = 0; i < points.size(); ++i) {
+    if (points[i] < 0) { os << "1"; continue; }
+    const MERTPoint& p = env.GetPool()[points[i]];
+    os << (i==0 ? "" : "|") << "x=" << p.x << ",b=" << p.b << ",m=" << p.m << ",p1=" << p.p1 << ",p2=" << p.p2;
+  }
   return os << '>';
 }
 
@@ -36,17 +38,22 @@ ostream& operator<<(ostream& os, const ConvexHull& env) {
 #ifdef ORIGINAL_MERT_IMPLEMENTATION
 
 struct SlopeCompare {
-  bool operator() (const boost::shared_ptr<MERTPoint>& a, const boost::shared_ptr<MERTPoint>& b) const {
-    return a->m < b->m;
+  explicit SlopeCompare(const MERTPointPool& p) : pool(p) {}
+  bool operator() (int a, int b) const {
+    return pool[a].m < pool[b].m;
   }
+  const MERTPointPool& pool;
 };
 
 const ConvexHull& ConvexHull::operator+=(const ConvexHull& other) {
   if (!other.is_sorted) other.Sort();
   if (points.empty()) {
+    pool = other.pool;
     points = other.points;
     return *this;
   }
+  if (other.points.empty()) return *this;
+  assert(pool && pool == other.pool);
   is_sorted = false;
   int j = points.size();
   points.resize(points.size() + other.points.size());
@@ -57,26 +64,28 @@ const ConvexHull& ConvexHull::operator+=(const ConvexHull& other) {
 }
 
 void ConvexHull::Sort() const {
-  sort(points.begin(), points.end(), SlopeCompare());
+  MERTPointPool& pool = *this->pool;
+  sort(points.begin(), points.end(), SlopeCompare(pool));
   const int k = points.size();
   int j = 0;
   for (int i = 0; i < k; ++i) {
-    MERTPoint l = *points[i];
+    MERTPoint l = pool[points[i]];
     l.x = kMinusInfinity;
     // cerr << "m=" << l.m << endl;
     if (0 < j) {
-      if (points[j-1]->m == l.m) {   // lines are parallel
-        if (l.b <= points[j-1]->b) continue;
+      if (pool[points[j-1]].m == l.m) {   // lines are parallel
+        if (l.b <= pool[points[j-1]].b) continue;
         --j;
       }
       while(0 < j) {
-        l.x = (l.b - points[j-1]->b) / (points[j-1]->m - l.m);
-        if (points[j-1]->x < l.x) break;
+        const MERTPoint& prev = pool[points[j-1]];
+        l.x = (l.b - prev.b) / (prev.m - l.m);
+        if (prev.x < l.x) break;
         --j;
       }
       if (0 == j) l.x = kMinusInfinity;
     }
-    *points[j++] = l;
+    pool[points[j++]] = l;
   }
   points.resize(j);
   is_sorted = true;
@@ -85,29 +94,32 @@ void ConvexHull::Sort() const {
 const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
   if (other.IsMultiplicativeIdentity()) { return *this; }
   if (this->IsMultiplicativeIdentity()) { (*this) = other; return *this; }
+  if (!pool) pool = other.pool;
+  assert(!other.pool || pool == other.pool);
 
   if (!is_sorted) Sort();
   if (!other.is_sorted) other.Sort();
 
+  // the points are copied out of the pool, since adding to it may move them
   if (this->IsEdgeEnvelope()) {
 //    if (other.size() > 1)
 //      cerr << *this << " (TIMES) " << other << endl;
-    boost::shared_ptr<MERTPoint> edge_parent = points[0];
-    const double& edge_b = edge_parent->b;
-    const double& edge_m = edge_parent->m;
+    const int edge_parent = points[0];
+    const double edge_b = (*pool)[edge_parent].b;
+    const double edge_m = (*pool)[edge_parent].m;
     points.clear();
     for (int i = 0; i < other.points.size(); ++i) {
-      const MERTPoint& p = *other.points[i];
+      const MERTPoint p = (*pool)[other.points[i]];
       const double m = p.m + edge_m;
       const double b = p.b + edge_b;
       const double& x = p.x;       // x's don't change with *
-      points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(x, m, b, edge_parent, other.points[i])));
-      assert(points.back()->p1->edge);
+      points.push_back(pool->Add(MERTPoint(x, m, b, edge_parent, other.points[i])));
     }
 //    if (other.size() > 1)
 //      cerr << " = " << *this << endl;
   } else {
-    vector<boost::shared_ptr<MERTPoint> > new_points;
+    const MERTPointPool& cpool = *pool;
+    vector<int> new_points;
     int this_i = 0;
     int other_i = 0;
     const int this_size  = points.size();
@@ -115,15 +127,13 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
     double cur_x = kMinusInfinity;   // moves from left to right across the
                                      // real numbers, stopping for all inter-
                                      // sections
-    double this_next_val  = (1 < this_size  ? points[1]->x       : kPlusInfinity);
-    double other_next_val = (1 < other_size ? other.points[1]->x : kPlusInfinity);
+    double this_next_val  = (1 < this_size  ? cpool[points[1]].x       : kPlusInfinity);
+    double other_next_val = (1 < other_size ? cpool[other.points[1]].x : kPlusInfinity);
     while (this_i < this_size && other_i < other_size) {
-      const MERTPoint& this_point = *points[this_i];
-      const MERTPoint& other_point= *other.points[other_i];
-      const double m = this_point.m + other_point.m;
-      const double b = this_point.b + other_point.b;
+      const double m = cpool[points[this_i]].m + cpool[other.points[other_i]].m;
+      const double b = cpool[points[this_i]].b + cpool[other.points[other_i]].b;
  
-      new_points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(cur_x, m, b, points[this_i], other.points[other_i])));
+      new_points.push_back(pool->Add(MERTPoint(cur_x, m, b, points[this_i], other.points[other_i])));
       int comp = 0;
       if (this_next_val < other_next_val) comp = -1; else
         if (this_next_val > other_next_val) comp = 1;
@@ -131,17 +141,17 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
         ++this_i;
 	++other_i;
         cur_x = this_next_val;  // could be other_next_val (they're equal!)
-        this_next_val  = (this_i+1  < this_size  ? points[this_i+1]->x        : kPlusInfinity);
-        other_next_val = (other_i+1 < other_size ? other.points[other_i+1]->x : kPlusInfinity);
+        this_next_val  = (this_i+1  < this_size  ? cpool[points[this_i+1]].x        : kPlusInfinity);
+        other_next_val = (other_i+1 < other_size ? cpool[other.points[other_i+1]].x : kPlusInfinity);
       } else {  // advance the i with the lower x, update cur_x
         if (-1 == comp) {
           ++this_i;
           cur_x = this_next_val;
-          this_next_val =  (this_i+1  < this_size  ? points[this_i+1]->x        : kPlusInfinity);
+          this_next_val =  (this_i+1  < this_size  ? cpool[points[this_i+1]].x        : kPlusInfinity);
         } else {
           ++other_i;
           cur_x = other_next_val;
-          other_next_val = (other_i+1 < other_size ? other.points[other_i+1]->x : kPlusInfinity);
+          other_next_val = (other_i+1 < other_size ? cpool[other.points[other_i+1]].x : kPlusInfinity);
         }
       }
     }
@@ -152,13 +162,13 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
 }
 
 // recursively construct translation
-void MERTPoint::ConstructTranslation(vector<WordID>* trans) const {
-  const MERTPoint* cur = this;
+void MERTPointPool::ConstructTranslation(int point, vector<WordID>* trans) const {
+  const MERTPoint* cur = &points_[point];
   vector<vector<WordID> > ant_trans;
   while(!cur->edge) {
     ant_trans.resize(ant_trans.size() + 1);
-    cur->p2->ConstructTranslation(&ant_trans.back());
-    cur = cur->p1.get();
+    ConstructTranslation(cur->p2, &ant_trans.back());
+    cur = &points_[cur->p1];
   }
   size_t ant_size = ant_trans.size();
   vector<const vector<WordID>*> pants(ant_size);
@@ -168,13 +178,14 @@ void MERTPoint::ConstructTranslation(vector<WordID>* trans) const {
   cur->edge->rule_->ESubstitute(pants, trans);
 }
 
-void MERTPoint::CollectEdgesUsed(std::vector<bool>* edges_used) const {
-  if (edge) {
-    assert(edge->id_ < edges_used->size());
-    (*edges_used)[edge->id_] = true;
+void MERTPointPool::CollectEdgesUsed(int point, std::vector<bool>* edges_used) const {
+  const MERTPoint& p = points_[point];
+  if (p.edge) {
+    assert(p.edge->id_ < edges_used->size());
+    (*edges_used)[p.edge->id_] = true;
   }
-  if (p1) p1->CollectEdgesUsed(edges_used);
-  if (p2) p2->CollectEdgesUsed(edges_used);
+  if (p.p1 >= 0) CollectEdgesUsed(p.p1, edges_used);
+  if (p.p2 >= 0) CollectEdgesUsed(p.p2, edges_used);
 }
 
 #else
@@ -3,7 +3,6 @@
 
 #include <vector>
 #include <iostream>
-#include <boost/shared_ptr.hpp>
 
 #include "hg.h"
 #include "sparse_vector.h"
@@ -12,70 +11,100 @@ static const double kMinusInfinity = -std::numeric_limits<double>::infinity();
 static const double kPlusInfinity = std::numeric_limits<double>::infinity();
 
 struct MERTPoint {
-  MERTPoint() : x(), m(), b(), edge() {}
+  MERTPoint() : x(), m(), b(), p1(-1), p2(-1), edge() {}
   MERTPoint(double _m, double _b) :
-    x(kMinusInfinity), m(_m), b(_b), edge() {}
-  MERTPoint(double _x, double _m, double _b, const boost::shared_ptr<MERTPoint>& p1_, const boost::shared_ptr<MERTPoint>& p2_) :
+    x(kMinusInfinity), m(_m), b(_b), p1(-1), p2(-1), edge() {}
+  MERTPoint(double _x, double _m, double _b, int p1_, int p2_) :
     x(_x), m(_m), b(_b), p1(p1_), p2(p2_), edge() {}
   MERTPoint(double _m, double _b, const Hypergraph::Edge& edge) :
-    x(kMinusInfinity), m(_m), b(_b), edge(&edge) {}
+    x(kMinusInfinity), m(_m), b(_b), p1(-1), p2(-1), edge(&edge) {}
 
   double x;                   // x intersection with previous segment in env, or -inf if none
   double m;                   // this line's slope
   double b;                   // intercept with y-axis
 
-  // we keep a pointer to the "parents" of this segment so we can reconstruct
-  // the Viterbi translation corresponding to this segment
-  boost::shared_ptr<MERTPoint> p1;
-  boost::shared_ptr<MERTPoint> p2;
+  // we keep the indices (in the MERTPointPool holding this point) of the
+  // "parents" of this segment, or -1, so we can reconstruct the Viterbi
+  // translation corresponding to this segment
+  int p1;
+  int p2;
 
   // only MERTPoints created from an edge using the ConvexHullWeightFunction
   // have rules
   // TRulePtr rule;
   const Hypergraph::Edge* edge;
+};
+
+// holds all the MERTPoints created while computing the envelope of a forest.
+// Points refer to each other (and ConvexHulls to points) by index, so the
+// semiring operations only append to a single vector instead of allocating
+// and reference counting every point.
+class MERTPointPool {
+ public:
+  int Add(const MERTPoint& p) {
+    points_.push_back(p);
+    return points_.size() - 1;
+  }
+  // NOTE: references are invalidated by Add
+  MERTPoint& operator[](int i) { return points_[i]; }
+  const MERTPoint& operator[](int i) const { return points_[i]; }
+  size_t size() const { return points_.size(); }
+  void clear() { points_.clear(); }
 
   // recursively recover the Viterbi translation that will result from setting
-  // the weights to origin + axis * x, where x is any value from this->x up
-  // until the next largest x in the containing ConvexHull
-  void ConstructTranslation(std::vector<WordID>* trans) const;
-  void CollectEdgesUsed(std::vector<bool>* edges_used) const;
+  // the weights to origin + axis * x, where x is any value from the x of the
+  // given point up until the next largest x in the containing ConvexHull
+  void ConstructTranslation(int point, std::vector<WordID>* trans) const;
+  void CollectEdgesUsed(int point, std::vector<bool>* edges_used) const;
+
+ private:
+  std::vector<MERTPoint> points_;
 };
 
 // this is the semiring value type,
 // it defines constructors for 0, 1, and the operations + and *
+// all non-zero hulls that are combined must share a pool, except for the
+// multiplicative identity, which has none (and so can only be multiplied)
 struct ConvexHull {
   // create semiring zero
-  ConvexHull() : is_sorted(true) {}  // zero
-  // for debugging:
-  ConvexHull(const std::vector<boost::shared_ptr<MERTPoint> >& s) : points(s) { Sort(); }
+  ConvexHull() : pool(), is_sorted(true) {}  // zero
+  // for debugging: the envelope of the lines (*p)[s[0]], (*p)[s[1]], ...
+  ConvexHull(MERTPointPool* p, const std::vector<int>& s) : pool(p), points(s) { Sort(); }
   // create semiring 1 or 0
   explicit ConvexHull(int i);
-  ConvexHull(int n, MERTPoint* point) : is_sorted(true), points(n, boost::shared_ptr<MERTPoint>(point)) {}
+  ConvexHull(MERTPointPool* p, int point) : pool(p), is_sorted(true), points(1, point) {}
   const ConvexHull& operator+=(const ConvexHull& other);
   const ConvexHull& operator*=(const ConvexHull& other);
   bool IsMultiplicativeIdentity() const {
-    return size() == 1 && (points[0]->b == 0.0 && points[0]->m == 0.0) && (!points[0]->edge) && (!points[0]->p1) && (!points[0]->p2); }
-  const std::vector<boost::shared_ptr<MERTPoint> >& GetSortedSegs() const {
+    return size() == 1 && points[0] < 0; }
+  // indices in GetPool() of the segments of the envelope, in order of x
+  const std::vector<int>& GetSortedSegs() const {
     if (!is_sorted) Sort();
     return points;
   }
+  const MERTPointPool& GetPool() const { return *pool; }
   size_t size() const { return points.size(); }
 
  private:
   bool IsEdgeEnvelope() const {
-    return points.size() == 1 && points[0]->edge; }
+    return points.size() == 1 && points[0] >= 0 && (*pool)[points[0]].edge; }
   void Sort() const;
+  MERTPointPool* pool;
   mutable bool is_sorted;
-  mutable std::vector<boost::shared_ptr<MERTPoint> > points;
+  mutable std::vector<int> points;
 };
 std::ostream& operator<<(std::ostream& os, const ConvexHull& env);
 
+// the points of the ConvexHulls computed with this weight function are
+// stored in pool, which must outlive them
 struct ConvexHullWeightFunction {
   ConvexHullWeightFunction(const SparseVector<double>& ori,
-                           const SparseVector<double>& dir) : origin(ori), direction(dir) {}
+                           const SparseVector<double>& dir,
+                           MERTPointPool* p) : origin(ori), direction(dir), pool(p) {}
   const ConvexHull operator()(const Hypergraph::Edge& e) const;
   const SparseVector<double> origin;
   const SparseVector<double> direction;
+  MERTPointPool* const pool;
 };
 
 #endif
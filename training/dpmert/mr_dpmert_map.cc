@@ -5,6 +5,7 @@
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "ns.h"
 #include "ns_docscorer.h"
@@ -17,6 +18,7 @@
 #include "error_surface.h"
 #include "b64tools.h"
 #include "hg_io.h"
+#include "parallel_for.h"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -28,6 +30,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("source,s",po::value<string>(), "Source file (ignored, except for AER)")
         ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric being optimized")
         ("input,i",po::value<string>()->default_value("-"), "Input file to map (- is STDIN)")
+        ("threads,t",po::value<unsigned>()->default_value(1), "Number of threads to compute error surfaces with (not used for external metrics such as METEOR)")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -65,48 +68,98 @@ bool ReadSparseVectorString(const string& s, SparseVector<double>* v) {
 #endif
 }
 
+// one line of input: a search direction through the forest of a sentence
+struct MapTask {
+  int sent_id;
+  boost::shared_ptr<Hypergraph> hg;
+  string s_origin;
+  string s_direction;
+  SparseVector<double> origin;
+  SparseVector<double> direction;
+  string es;  // serialized error surface
+};
+
+// computes the error surfaces of tasks shard, shard + shards, shard + 2 *
+// shards, ... Segment evaluators keep scratch state while scoring, so every
+// shard scores with its own DocumentScorer, and reuses one MERTPointPool.
+struct ErrorSurfaceMapper {
+  ErrorSurfaceMapper(const EvaluationMetric* m,
+                     const vector<boost::shared_ptr<DocumentScorer> >& s,
+                     vector<MapTask>* t) : metric(m), scorers(s), tasks(t) {}
+  void operator()(size_t shard) const {
+    const DocumentScorer& ds = *scorers[shard];
+    MERTPointPool pool;
+    for (size_t i = shard; i < tasks->size(); i += scorers.size()) {
+      MapTask& task = (*tasks)[i];
+      pool.clear();
+      const ConvexHullWeightFunction wf(task.origin, task.direction, &pool);
+      const ConvexHull hull = Inside<ConvexHull, ConvexHullWeightFunction>(*task.hg, NULL, wf);
+
+      ErrorSurface es;
+      ComputeErrorSurface(*ds[task.sent_id], hull, &es, metric, *task.hg);
+      //cerr << "Viterbi envelope has " << ve.size() << " segments\n";
+      // cerr << "Error surface has " << es.size() << " segments\n";
+      es.Serialize(&task.es);
+    }
+  }
+  const EvaluationMetric* metric;
+  const vector<boost::shared_ptr<DocumentScorer> >& scorers;
+  vector<MapTask>* tasks;
+};
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
   const string evaluation_metric = conf["evaluation_metric"].as<string>();
   EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
-  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
-  cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
-  Hypergraph hg;
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1 && !metric->IsThreadSafe()) {
+    cerr << evaluation_metric << " cannot be used from several threads, using one\n";
+    threads = 1;
+  }
+  if (threads == 0) threads = 1;
+  const vector<string>& refs = conf["reference"].as<vector<string> >();
+  vector<boost::shared_ptr<DocumentScorer> > scorers(threads);
+  for (unsigned t = 0; t < threads; ++t)
+    scorers[t].reset(new DocumentScorer(metric, refs));
+  cerr << "Loaded " << scorers[0]->size() << " references for scoring with " << evaluation_metric << endl;
+  boost::shared_ptr<Hypergraph> hg;
   string last_file;
   ReadFile in_read(conf["input"].as<string>());
   istream &in=*in_read.stream();
+  // mapped a batch at a time so that the output stays in input order
+  const unsigned batch_size = 16 * threads;
+  vector<MapTask> tasks;
   while(in) {
-    string line;
-    getline(in, line);
-    if (line.empty()) continue;
-    istringstream is(line);
-    int sent_id;
-    string file, s_origin, s_direction;
-    // path-to-file sent_ed starting-point search-direction
-    is >> file >> sent_id >> s_origin >> s_direction;
-    SparseVector<double> origin;
-    ReadSparseVectorString(s_origin, &origin);
-    SparseVector<double> direction;
-    ReadSparseVectorString(s_direction, &direction);
-    // cerr << "File: " << file << "\nDir: " << direction << "\n   X: " << origin << endl;
-    if (last_file != file) {
-      last_file = file;
-      ReadFile rf(file);
-      HypergraphIO::ReadFromBinary(rf.stream(), &hg);
+    tasks.clear();
+    while(tasks.size() < batch_size && in) {
+      string line;
+      getline(in, line);
+      if (line.empty()) continue;
+      istringstream is(line);
+      tasks.push_back(MapTask());
+      MapTask& task = tasks.back();
+      string file;
+      // path-to-file sent_ed starting-point search-direction
+      is >> file >> task.sent_id >> task.s_origin >> task.s_direction;
+      ReadSparseVectorString(task.s_origin, &task.origin);
+      ReadSparseVectorString(task.s_direction, &task.direction);
+      // cerr << "File: " << file << "\nDir: " << task.direction << "\n   X: " << task.origin << endl;
+      if (last_file != file) {
+        last_file = file;
+        ReadFile rf(file);
+        hg.reset(new Hypergraph);
+        HypergraphIO::ReadFromBinary(rf.stream(), hg.get());
+      }
+      task.hg = hg;
+    }
+    ParallelFor(threads, threads, ErrorSurfaceMapper(metric, scorers, &tasks));
+    for (unsigned i = 0; i < tasks.size(); ++i) {
+      const MapTask& task = tasks[i];
+      cout << 'M' << ' ' << task.s_origin << ' ' << task.s_direction << '\t';
+      B64::b64encode(task.es.c_str(), task.es.size(), &cout);
+      cout << endl << flush;
     }
-    const ConvexHullWeightFunction wf(origin, direction);
-    const ConvexHull hull = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
-
-    ErrorSurface es;
-    ComputeErrorSurface(*ds[sent_id], hull, &es, metric, hg);
-    //cerr << "Viterbi envelope has " << ve.size() << " segments\n";
-    // cerr << "Error surface has " << es.size() << " segments\n";
-    string val;
-    es.Serialize(&val);
-    cout << 'M' << ' ' << s_origin << ' ' << s_direction << '\t';
-    B64::b64encode(val.c_str(), val.size(), &cout);
-    cout << endl << flush;
   }
   return 0;
 }
@@ -3,6 +3,7 @@
 #include "kbestget.h"
 #include "ksampler.h"
 #include "pairsampling.h"
+#include "forkdecode.h"
 
 using namespace dtrain;
 
@@ -45,6 +46,8 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     ("batch",             po::value<bool>()->zero_tokens(),                                               "do batch optimization")
     ("repeat",            po::value<unsigned>()->default_value(1),          "repeat optimization over kbest list this number of times")
     ("check",             po::value<bool>()->zero_tokens(),                                  "produce list of loss differentials")
+    ("jobs",              po::value<unsigned>()->default_value(1),                  "decode with this many forked processes")
+    ("mini_batch",        po::value<unsigned>()->default_value(16),      "inputs per process between weight updates (jobs > 1); the processes are forked anew for every batch, so small values spend much of the time forking")
     ("noup",              po::value<bool>()->zero_tokens(),                                               "do not update weights");
   po::options_description cl("Command Line Options");
   cl.add_options()
@@ -97,6 +100,15 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     cerr << "Wrong 'select_weights' param: '" << (*cfg)["select_weights"].as<string>() << "', use 'last' or 'best'." << endl;
     return false;
   }
+  if ((*cfg)["jobs"].as<unsigned>() < 1 || (*cfg)["mini_batch"].as<unsigned>() < 1) {
+    cerr << "jobs and mini_batch must be >= 1" << endl;
+    return false;
+  }
+  if ((*cfg)["jobs"].as<unsigned>() > 1 && ((*cfg)["scorer"].as<string>() == "approx_bleu"
+        || (*cfg)["scorer"].as<string>() == "lc_bleu")) {
+    cerr << "The '" << (*cfg)["scorer"].as<string>() << "' scorer keeps statistics across inputs, use jobs 1." << endl;
+    return false;
+  }
   return true;
 }
 
@@ -135,6 +147,8 @@ main(int argc, char** argv)
   weight_t loss_margin = cfg["loss_margin"].as<weight_t>();
   bool batch = false;
   if (cfg.count("batch")) batch = true;
+  const unsigned jobs = cfg["jobs"].as<unsigned>();
+  const unsigned mini_batch = cfg["mini_batch"].as<unsigned>();
   if (loss_margin > 9998.) loss_margin = std::numeric_limits<float>::max();
   bool scale_bleu_diff = false;
   if (cfg.count("scale_bleu_diff")) scale_bleu_diff = true;
@@ -153,6 +167,8 @@ main(int argc, char** argv)
   if (!quiet)
     cerr << setw(25) << "cdec cfg " << "'" << cfg["decoder_config"].as<string>() << "'" << endl;
   Decoder decoder(ini_rf.stream());
+  // with a first pass cache the ids of the inputs must repeat across epochs
+  const bool cache_first_pass = decoder.GetConf().count("cache_first_pass");
 
   // scoring metric/scorer
   string scorer_str = cfg["scorer"].as<string>();
@@ -241,6 +257,29 @@ main(int argc, char** argv)
   }
 
   unsigned in_sz = std::numeric_limits<unsigned>::max(); // input index, input size
+
+  // the worker processes need all input up front
+  const bool preload = jobs > 1;
+  if (preload) {
+    string in, ref;
+    while (getline(*input, in)) {
+      if (read_bitext) {
+        vector<string> strs;
+        boost::algorithm::split_regex(strs, in, boost::regex(" \\|\\|\\| "));
+        in = strs[0];
+        ref = strs[1];
+      } else {
+        getline(*refs, ref);
+      }
+      vector<string> ref_tok;
+      vector<WordID> ref_ids;
+      boost::split(ref_tok, ref, boost::is_any_of(" "));
+      register_and_convert(ref_tok, ref_ids);
+      ref_ids_buf.push_back(ref_ids);
+      src_str_buf.push_back(in);
+    }
+    in_sz = src_str_buf.size();
+  }
   vector<pair<score_t, score_t> > all_scores;
   score_t max_score = 0.;
   unsigned best_it = 0;
@@ -254,6 +293,10 @@ main(int argc, char** argv)
     cerr << setw(25) << "N " << N << endl;
     cerr << setw(25) << "T " << T << endl;
     cerr << setw(25) << "batch " << batch << endl;
+    if (jobs > 1) {
+      cerr << setw(25) << "jobs " << jobs << endl;
+      cerr << setw(25) << "mini batch " << mini_batch << endl;
+    }
     cerr << setw(26) << "scorer '" << scorer_str << "'" << endl;
     if (scorer_str == "approx_bleu")
       cerr << setw(25) << "approx. B discount " << approx_bleu_d << endl;
@@ -295,6 +338,9 @@ main(int argc, char** argv)
   // batch
   SparseVector<weight_t> batch_updates;
   score_t batch_loss;
+  // jobs > 1: samples of the inputs [batch_begin, batch_begin+batch_samples.size())
+  vector<vector<ScoredHyp> > batch_samples;
+  unsigned batch_begin = 0;
 
   for (unsigned t = 0; t < T; t++) // T epochs
   {
@@ -305,6 +351,8 @@ main(int argc, char** argv)
   score_t model_sum(0);
   unsigned ii = 0, rank_errors = 0, margin_violations = 0, npairs = 0, f_count = 0, list_sz = 0, kbest_loss_improve = 0;
   batch_loss = 0.;
+  batch_samples.clear();
+  batch_begin = 0;
   if (!quiet) cerr << "Iteration #" << t+1 << " of " << T << "." << endl;
 
   while(true)
@@ -313,7 +361,7 @@ main(int argc, char** argv)
     string in;
     string ref;
     bool next = false, stop = false; // next iteration or premature stop
-    if (t == 0) {
+    if (t == 0 && !preload) {
       if(!getline(*input, in)) next = true;
       if(read_bitext) {
         vector<string> strs;
@@ -356,7 +404,7 @@ main(int argc, char** argv)
 
     // getting input
     vector<WordID> ref_ids; // reference as vector<WordID>
-    if (t == 0) {
+    if (t == 0 && !preload) {
       if (!read_bitext) {
         getline(*refs, ref);
       }
@@ -368,18 +416,30 @@ main(int argc, char** argv)
     } else {
       ref_ids = ref_ids_buf[ii];
     }
-    observer->SetRef(ref_ids);
-    if (t == 0)
-      decoder.Decode(in, observer);
-    else
-      decoder.Decode(src_str_buf[ii], observer);
-
-    // get (scored) samples
-    vector<ScoredHyp>* samples = observer->GetSamples();
+    vector<ScoredHyp>* samples;
+    if (jobs > 1) {
+      // the weights are updated only after each batch of jobs*mini_batch inputs
+      if (ii >= batch_begin + batch_samples.size()) {
+        unsigned end = min(ii + jobs*mini_batch, in_sz);
+        if (stop_after > 0) end = min(end, stop_after);
+        batch_begin = ii;
+        fork_decode(decoder, observer, rng, src_str_buf, ref_ids_buf, batch_begin, end, jobs, batch_samples);
+      }
+      samples = &batch_samples[ii-batch_begin];
+    } else {
+      observer->SetRef(ref_ids);
+      if (cache_first_pass) decoder.SetId(ii);
+      if (t == 0)
+        decoder.Decode(in, observer);
+      else
+        decoder.Decode(src_str_buf[ii], observer);
+      // get (scored) samples
+      samples = observer->GetSamples();
+    }
 
     if (verbose) {
       cerr << "--- ref for " << ii << ": ";
-      if (t > 0) printWordIDVec(ref_ids_buf[ii]);
+      if (t > 0 || preload) printWordIDVec(ref_ids_buf[ii]);
       else printWordIDVec(ref_ids);
       cerr << endl;
       for (unsigned u = 0; u < samples->size(); u++) {
@@ -396,8 +456,14 @@ main(int argc, char** argv)
       model_sum += (*samples)[0].model;
     }
 
-    f_count += observer->get_f_count();
-    list_sz += observer->get_sz();
+    if (jobs > 1) {
+      for (unsigned u = 0; u < samples->size(); u++)
+        f_count += (*samples)[u].f.size();
+      list_sz += samples->size();
+    } else {
+      f_count += observer->get_f_count();
+      list_sz += observer->get_sz();
+    }
 
     // weight updates
     if (!noup) {
@@ -631,7 +697,7 @@ main(int argc, char** argv)
   overall_time += time_diff;
   if (!quiet) {
     cerr << _p2 << _np << "(time " << time_diff/60. << " min, ";
-    cerr << time_diff/in_sz << " s/S)" << endl;
+    cerr << time_diff/in_sz << " s/S, " << in_sz/max(time_diff, 1.f) << " S/s)" << endl;
   }
   if (t+1 != T && !quiet) cerr << endl;
 
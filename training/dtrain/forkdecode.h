@@ -0,0 +1,175 @@
+#ifndef _DTRAIN_FORKDECODE_H_
+#define _DTRAIN_FORKDECODE_H_
+
+#include <climits>
+#include <sstream>
+
+#include "fork_workers.h"
+#include "sampler.h"
+
+namespace dtrain
+{
+
+
+/*
+ * samples are sent from the worker processes with their words and
+ * features as strings: the workers' dictionaries grow independently
+ * (OOVs, sparse features), so their ids mean nothing to the parent
+ */
+inline void
+write_string(const string& s, ostream& os)
+{
+  const unsigned len = s.size();
+  os.write(reinterpret_cast<const char*>(&len), sizeof(len));
+  os.write(s.data(), len);
+}
+
+inline bool
+read_string(istream& is, string& s)
+{
+  unsigned len;
+  if (!is.read(reinterpret_cast<char*>(&len), sizeof(len))) return false;
+  s.resize(len);
+  return !len || !is.read(&s[0], len).fail();
+}
+
+template<typename T>
+inline void
+write_pod(const T& v, ostream& os)
+{
+  os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template<typename T>
+inline bool
+read_pod(istream& is, T& v)
+{
+  return !is.read(reinterpret_cast<char*>(&v), sizeof(T)).fail();
+}
+
+inline void
+write_samples(const vector<ScoredHyp>& samples, ostream& os)
+{
+  write_pod<unsigned>(samples.size(), os);
+  for (unsigned i = 0; i < samples.size(); i++) {
+    const ScoredHyp& h = samples[i];
+    write_pod(h.model, os);
+    write_pod(h.score, os);
+    write_pod(h.rank, os);
+    write_pod<unsigned>(h.w.size(), os);
+    for (unsigned j = 0; j < h.w.size(); j++)
+      write_string(TD::Convert(h.w[j]), os);
+    write_pod<unsigned>(h.f.size(), os);
+    for (SparseVector<double>::const_iterator it = h.f.begin(); it != h.f.end(); ++it) {
+      write_string(FD::Convert(it->first), os);
+      write_pod(it->second, os);
+    }
+  }
+}
+
+inline bool
+read_samples(istream& is, vector<ScoredHyp>& samples)
+{
+  unsigned n, len;
+  string s;
+  if (!read_pod(is, n)) return false;
+  samples.resize(n);
+  for (unsigned i = 0; i < n; i++) {
+    ScoredHyp& h = samples[i];
+    if (!read_pod(is, h.model) || !read_pod(is, h.score) || !read_pod(is, h.rank)
+        || !read_pod(is, len)) return false;
+    h.w.clear();
+    for (unsigned j = 0; j < len; j++) {
+      if (!read_string(is, s)) return false;
+      h.w.push_back(TD::Convert(s));
+    }
+    if (!read_pod(is, len)) return false;
+    h.f.clear();
+    for (unsigned j = 0; j < len; j++) {
+      double v;
+      if (!read_string(is, s) || !read_pod(is, v)) return false;
+      h.f.set_value(FD::Convert(s), v);
+    }
+  }
+  return true;
+}
+
+/*
+ * worker k of fork_decode: decodes the inputs begin+k, begin+k+jobs, ...
+ * and sends their samples
+ */
+struct SampleWorker
+{
+  SampleWorker(Decoder& d, HypSampler* o, MT19937& r, const vector<uint32_t>& sd,
+               vector<string>& in, vector<vector<WordID> >& rf,
+               unsigned b, unsigned e, unsigned j)
+    : decoder(d), observer(o), rng(r), seeds(sd), src(in), refs(rf),
+      begin(b), end(e), jobs(j) {}
+  bool
+  operator()(unsigned k, ostream* out) const
+  {
+    rng.gen().seed(seeds[k]);
+    const bool set_id = decoder.GetConf().count("cache_first_pass");
+    for (unsigned i = begin + k; i < end; i += jobs) {
+      observer->SetRef(refs[i]);
+      if (set_id) decoder.SetId(i);
+      decoder.Decode(src[i], observer);
+      write_pod(i, *out);
+      write_samples(*observer->GetSamples(), *out);
+    }
+    return true;
+  }
+  Decoder& decoder;
+  HypSampler* observer;
+  MT19937& rng;
+  const vector<uint32_t>& seeds;
+  vector<string>& src;
+  vector<vector<WordID> >& refs;
+  const unsigned begin, end, jobs;
+};
+
+struct SampleReader
+{
+  SampleReader(unsigned b, unsigned e, vector<vector<ScoredHyp> >& s)
+    : begin(b), end(e), samples(s) {}
+  bool
+  operator()(unsigned, istream* in) const
+  {
+    unsigned i;
+    while (read_pod(*in, i))
+      if (i < begin || i >= end || !read_samples(*in, samples[i-begin]))
+        return false;
+    return true;
+  }
+  const unsigned begin, end;
+  vector<vector<ScoredHyp> >& samples;
+};
+
+/*
+ * decodes the inputs [begin, end) with the current weights of the decoder
+ * in jobs worker processes forked from this one (see fork_workers.h),
+ * which therefore share the loaded grammars and feature functions;
+ * samples[i-begin] receives the samples of input i. The workers reseed rng
+ * (used for forest sampling) differently.
+ */
+inline void
+fork_decode(Decoder& decoder, HypSampler* observer, MT19937& rng,
+            vector<string>& src, vector<vector<WordID> >& refs,
+            const unsigned begin, const unsigned end, const unsigned jobs,
+            vector<vector<ScoredHyp> >& samples)
+{
+  samples.clear();
+  samples.resize(end - begin);
+  vector<uint32_t> seeds(jobs);
+  for (unsigned k = 0; k < jobs; k++)
+    seeds[k] = rng.inclusive(1, INT_MAX)();
+  SampleWorker work(decoder, observer, rng, seeds, src, refs, begin, end, jobs);
+  SampleReader read(begin, end, samples);
+  ForkWorkers(jobs, work, read);
+}
+
+
+} // namespace
+
+#endif
+
@@ -0,0 +1,52 @@
+#ifndef _PRO_H_
+#define _PRO_H_
+
+#include <vector>
+#include <utility>
+
+#include "sampler.h"
+#include "sparse_vector.h"
+#include "weights.h"
+
+class EvaluationMetric;
+
+// The pair sampler and the classifier of PRO (Hopkins&May, 2011), shared by
+// mr_pro_map / mr_pro_reduce and the in-process tuning loop in pro_tune.
+namespace training {
+  class CandidateSet;
+
+  struct TrainingInstance {
+    TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
+    SparseVector<weight_t> x;
+    bool y;
+    float gdiff;
+  };
+
+  // This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011): samples
+  // gamma pairs of candidates from J_i and adds the xi with the largest
+  // metric differences to pv. rng is only used by the calling thread.
+  void Sample(const int gamma,
+              const unsigned xi,
+              const CandidateSet& J_i,
+              const EvaluationMetric* metric,
+              MT19937* rng,
+              std::vector<TrainingInstance>* pv);
+
+  // labeled feature difference vectors
+  typedef std::vector<std::pair<bool, SparseVector<weight_t> > > ProCorpus;
+
+  // trains the logistic regression classifier on the pairs in training, with
+  // l2 (C) and l1 (C1) regularization and an l2 penalty (T) on the distance
+  // to prev_x; *px holds the initial and final weights (px->at(0) is the
+  // bias). Returns the perplexity of the held-out pairs in testing (or 0).
+  double LearnParameters(const ProCorpus& training,
+                         const ProCorpus& testing,
+                         const double C,
+                         const double C1,
+                         const double T,
+                         const unsigned memory_buffers,
+                         const std::vector<weight_t>& prev_x,
+                         std::vector<weight_t>* px);
+}
+
+#endif
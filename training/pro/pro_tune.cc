@@ -0,0 +1,316 @@
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <climits>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "candidate_set.h"
+#include "pro.h"
+#include "sampler.h"
+#include "filelib.h"
+#include "fork_workers.h"
+#include "stringlib.h"
+#include "weights.h"
+#include "viterbi.h"
+#include "hg.h"
+#include "decoder.h"
+#include "ff_register.h"
+#include "sentence_metadata.h"
+#include "verbose.h"
+#include "ns.h"
+#include "ns_docscorer.h"
+#include "parallel_for.h"
+
+// PRO (Hopkins&May, 2011) with the whole tuning loop in one process: the
+// candidate sets accumulated over the iterations are kept in memory (and
+// cached on disk in binary form, so that a run can be resumed), the pairs
+// of all sentences are sampled in parallel and the classifier is trained
+// on them directly. This replaces a pro.pl iteration's decoder, mapper and
+// reducer processes and the files they exchange.
+
+using namespace std;
+using training::CandidateSet;
+using training::TrainingInstance;
+namespace po = boost::program_options;
+
+bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("decoder_config,c",po::value<string>(),"[REQD] Decoder configuration file")
+        ("input_weights,w",po::value<string>(),"[REQD] Initial feature weights file")
+        ("source,i",po::value<string>(),"[REQD] Source file for development set")
+        ("reference,r",po::value<vector<string> >(), "[REQD] Reference translation(s) (tokenized text file)")
+        ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
+        ("iterations,n",po::value<unsigned>()->default_value(30), "Number of PRO iterations")
+        ("kbest_size,k",po::value<unsigned>()->default_value(1500u), "Top k-hypotheses to extract")
+        ("candidate_pairs,G", po::value<unsigned>()->default_value(5000u), "Number of pairs to sample per hypothesis (Gamma)")
+        ("best_pairs,X", po::value<unsigned>()->default_value(50u), "Number of pairs, ranked by magnitude of objective delta, to retain (Xi)")
+        ("regularization_strength,C",po::value<double>()->default_value(500.0), "l2 regularization strength")
+        ("l1",po::value<double>()->default_value(0.0), "l1 regularization strength")
+        ("regularize_to_weights,y",po::value<double>()->default_value(5000.0), "Differences in learned weights to previous weights are penalized with an l2 penalty with this strength; 0.0 = no effect")
+        ("memory_buffers",po::value<unsigned>()->default_value(100), "Number of memory buffers (LBFGS)")
+        ("interpolate_with_weights,p",po::value<double>()->default_value(1.0), "Output weights are p*w + (1-p)*w_prev; 1.0 = no effect")
+        ("kbest_repository,K",po::value<string>()->default_value("./kbest"),"Directory in which the candidate sets are cached between iterations (and runs)")
+        ("output_dir,o",po::value<string>()->default_value("."),"Directory to write the weights of every iteration to")
+        ("jobs,j",po::value<unsigned>()->default_value(1), "Number of decoder processes to fork")
+        ("threads,t",po::value<unsigned>()->default_value(1), "Number of threads to sample pairs with")
+        ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  po::notify(*conf);
+  if (conf->count("help") || !conf->count("decoder_config") || !conf->count("input_weights") ||
+      !conf->count("source") || !conf->count("reference")) {
+    cerr << dcmdline_options << endl;
+    return false;
+  }
+  return true;
+}
+
+void ReadTrainingCorpus(const string& fname, vector<string>* c) {
+  ReadFile rf(fname);
+  istream& in = *rf.stream();
+  string line;
+  while(getline(in, line))
+    c->push_back(line);
+}
+
+// adds the k-best list of every forest to the candidate set of its sentence
+// and keeps the sufficient statistics of its 1-best translation
+struct KBestObserver : public DecoderObserver {
+  KBestObserver(unsigned k,
+                const DocumentScorer& d,
+                vector<CandidateSet>* c,
+                vector<SufficientStats>* o) : kbest_size(k), ds(d), cands(c), onebest(o) {}
+  virtual void NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg) {
+    const int sent_id = smeta.GetSentenceID();
+    vector<WordID> trans;
+    ViterbiESentence(*hg, &trans);
+    ds[sent_id]->Evaluate(trans, &(*onebest)[sent_id]);
+    (*cands)[sent_id].AddKBestCandidates(*hg, kbest_size, ds[sent_id]);
+  }
+  const unsigned kbest_size;
+  const DocumentScorer& ds;
+  vector<CandidateSet>* cands;
+  vector<SufficientStats>* onebest;
+};
+
+// worker k of ForkDecode: decodes sentences k, k + jobs, ... and sends the
+// sufficient statistics of their 1-best translations and their new
+// candidates in binary form
+struct KBestWorker {
+  KBestWorker(const vector<string>& c, unsigned j, unsigned k, const DocumentScorer& d,
+              Decoder* dec, vector<SufficientStats>* o) :
+      corpus(c), jobs(j), kbest_size(k), ds(d), decoder(dec), onebest(o) {}
+  bool operator()(unsigned k, ostream* out) const {
+    vector<CandidateSet> fresh(corpus.size());
+    KBestObserver observer(kbest_size, ds, &fresh, onebest);
+    for (unsigned i = k; i < corpus.size(); i += jobs) {
+      decoder->SetId(i);
+      decoder->Decode(corpus[i], &observer);
+      string stats;
+      (*onebest)[i].Encode(&stats);
+      const unsigned len = stats.size();
+      out->write(reinterpret_cast<const char*>(&i), sizeof(i));
+      out->write(reinterpret_cast<const char*>(&len), sizeof(len));
+      out->write(stats.data(), len);
+      fresh[i].WriteBinary(out);
+    }
+    return true;
+  }
+  const vector<string>& corpus;
+  const unsigned jobs;
+  const unsigned kbest_size;
+  const DocumentScorer& ds;
+  Decoder* decoder;
+  vector<SufficientStats>* onebest;
+};
+
+struct KBestReader {
+  KBestReader(vector<CandidateSet>* c, vector<SufficientStats>* o) : cands(c), onebest(o) {}
+  bool operator()(unsigned, istream* in) const {
+    unsigned i, len;
+    while (in->read(reinterpret_cast<char*>(&i), sizeof(i))) {
+      CandidateSet fresh;
+      string stats;
+      if (!in->read(reinterpret_cast<char*>(&len), sizeof(len))) return false;
+      stats.resize(len);
+      if ((len && !in->read(&stats[0], len)) || i >= cands->size() || !fresh.ReadBinary(in))
+        return false;
+      (*onebest)[i] = SufficientStats(stats);
+      (*cands)[i].AddCandidates(fresh);
+    }
+    return true;
+  }
+  vector<CandidateSet>* cands;
+  vector<SufficientStats>* onebest;
+};
+
+// decodes corpus with jobs worker processes forked from this one (see
+// fork_workers.h) and adds their new candidates to cands
+void ForkDecode(const vector<string>& corpus,
+                unsigned jobs,
+                unsigned kbest_size,
+                const DocumentScorer& ds,
+                Decoder* decoder,
+                vector<CandidateSet>* cands,
+                vector<SufficientStats>* onebest) {
+  KBestWorker work(corpus, jobs, kbest_size, ds, decoder, onebest);
+  KBestReader read(cands, onebest);
+  ForkWorkers(jobs, work, read);
+}
+
+// samples the training pairs of sentence i with its own random number
+// generator, so that the sentences can be sampled in any order
+struct PairSampler {
+  PairSampler(unsigned g,
+              unsigned x,
+              const EvaluationMetric* m,
+              const vector<CandidateSet>& c,
+              const vector<uint32_t>& s,
+              vector<vector<TrainingInstance> >* p) :
+    gamma(g), xi(x), metric(m), cands(c), seeds(s), pairs(p) {}
+  void operator()(size_t i) const {
+    (*pairs)[i].clear();
+    if (cands[i].size() < 2) return;
+    MT19937 rng(seeds[i]);
+    training::Sample(gamma, xi, cands[i], metric, &rng, &(*pairs)[i]);
+  }
+  const unsigned gamma;
+  const unsigned xi;
+  const EvaluationMetric* metric;
+  const vector<CandidateSet>& cands;
+  const vector<uint32_t>& seeds;
+  vector<vector<TrainingInstance> >* pairs;
+};
+
+string CacheFile(const string& repo, unsigned i) {
+  ostringstream os;
+  os << repo << "/kbest." << i << ".bin.gz";
+  return os.str();
+}
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  if (!InitCommandLine(argc, argv, &conf)) return 1;
+  SetSilent(true);  // turn off verbose decoder output
+  register_feature_functions();
+  MT19937 rng(conf.count("random_seed") ? conf["random_seed"].as<uint32_t>() : 0);
+
+  vector<string> corpus;
+  ReadTrainingCorpus(conf["source"].as<string>(), &corpus);
+  const string evaluation_metric = conf["evaluation_metric"].as<string>();
+  EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
+  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
+  const unsigned num_refs = ds.size();
+  cerr << "Loaded " << num_refs << " references for scoring with " << evaluation_metric << endl;
+  if (num_refs != corpus.size()) {
+    cerr << "Mismatched number of references (" << num_refs << ") and sources (" << corpus.size() << ")\n";
+    return 1;
+  }
+
+  ReadFile ini_rf(conf["decoder_config"].as<string>());
+  Decoder decoder(ini_rf.stream());
+  vector<weight_t>& weights = decoder.CurrentWeightVector();
+  Weights::InitFromFile(conf["input_weights"].as<string>(), &weights);
+
+  const unsigned iterations = conf["iterations"].as<unsigned>();
+  const unsigned kbest_size = conf["kbest_size"].as<unsigned>();
+  const unsigned gamma = conf["candidate_pairs"].as<unsigned>();
+  const unsigned xi = conf["best_pairs"].as<unsigned>();
+  const double C = conf["regularization_strength"].as<double>();
+  const double C1 = conf["l1"].as<double>();
+  const double T = conf["regularize_to_weights"].as<double>();
+  const unsigned memory_buffers = conf["memory_buffers"].as<unsigned>();
+  const double psi = conf["interpolate_with_weights"].as<double>();
+  if (psi < 0.0 || psi > 1.0) { cerr << "Invalid interpolation weight: " << psi << endl; return 1; }
+  const unsigned jobs = conf["jobs"].as<unsigned>();
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1 && !metric->IsThreadSafe()) {
+    cerr << evaluation_metric << " cannot be used from several threads, using one\n";
+    threads = 1;
+  }
+  const string output_dir = conf["output_dir"].as<string>();
+  MkDirP(output_dir);
+
+  // candidate sets cached by a previous run
+  const string kbest_repo = conf["kbest_repository"].as<string>();
+  MkDirP(kbest_repo);
+  vector<CandidateSet> cands(corpus.size());
+  unsigned cached = 0;
+  for (unsigned i = 0; i < corpus.size(); ++i) {
+    const string file = CacheFile(kbest_repo, i);
+    if (!FileExists(file)) continue;
+    ReadFile rf(file);
+    if (!cands[i].ReadBinary(rf.stream())) {
+      cerr << "Bad candidate cache " << file << endl;
+      return 1;
+    }
+    ++cached;
+  }
+  if (cached) cerr << "Read cached candidates for " << cached << " sentences\n";
+
+  vector<SufficientStats> onebest(corpus.size());
+  vector<size_t> cached_size(corpus.size());
+  vector<uint32_t> seeds(corpus.size());
+  vector<vector<TrainingInstance> > pairs(corpus.size());
+  for (unsigned iter = 1; iter <= iterations; ++iter) {
+    cerr << "\nITERATION " << iter << "\n==========\n";
+    for (unsigned i = 0; i < corpus.size(); ++i) cached_size[i] = cands[i].size();
+    if (jobs > 1) {
+      ForkDecode(corpus, jobs, kbest_size, ds, &decoder, &cands, &onebest);
+    } else {
+      KBestObserver observer(kbest_size, ds, &cands, &onebest);
+      for (unsigned i = 0; i < corpus.size(); ++i) {
+        decoder.SetId(i);
+        decoder.Decode(corpus[i], &observer);
+      }
+    }
+    SufficientStats corpus_stats;
+    for (unsigned i = 0; i < corpus.size(); ++i) corpus_stats += onebest[i];
+    cerr << "1-best: " << metric->DetailedScore(corpus_stats) << endl;
+
+    // only the sets that grew are written back
+    unsigned updated = 0;
+    for (unsigned i = 0; i < corpus.size(); ++i) {
+      if (cands[i].size() == cached_size[i]) continue;
+      WriteFile wf(CacheFile(kbest_repo, i));
+      cands[i].WriteBinary(wf.stream());
+      ++updated;
+    }
+    cerr << "Updated the candidates of " << updated << " sentences\n";
+
+    for (unsigned i = 0; i < corpus.size(); ++i)
+      seeds[i] = rng.inclusive(1, INT_MAX)();
+    ParallelFor(corpus.size(), threads, PairSampler(gamma, xi, metric, cands, seeds, &pairs));
+    training::ProCorpus training, testing;
+    for (unsigned i = 0; i < corpus.size(); ++i) {
+      for (unsigned j = 0; j < pairs[i].size(); ++j) {
+        const TrainingInstance& vi = pairs[i][j];
+        training.push_back(make_pair(vi.y, vi.x));
+        training.push_back(make_pair(!vi.y, vi.x * -1.0));
+      }
+    }
+    cerr << "Number of training examples: " << training.size() << endl;
+
+    weights.resize(FD::NumFeats());
+    const vector<weight_t> prev_x = weights;
+    vector<weight_t> x = weights;
+    training::LearnParameters(training, testing, C, C1, T, memory_buffers, prev_x, &x);
+    for (unsigned i = 1; i < x.size(); ++i)
+      x[i] = (x[i] * psi) + prev_x[i] * (1.0 - psi);
+    weights.swap(x);
+    Weights::ShowLargestFeatures(weights);
+    ostringstream os;
+    os << output_dir << "/weights." << iter;
+    Weights::WriteToFile(os.str(), weights);
+  }
+  Weights::WriteToFile(output_dir + "/weights.final", weights);
+  cerr << "\nFINAL WEIGHTS: " << output_dir << "/weights.final\n(Use -w <this file> with the decoder)\n";
+  return 0;
+}
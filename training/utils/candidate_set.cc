@@ -2,11 +2,14 @@
 
 #ifndef HAVE_OLD_CPP
 # include <unordered_set>
+# include <unordered_map>
 #else
 # include <tr1/unordered_set>
-namespace std { using std::tr1::unordered_set; }
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_set; using std::tr1::unordered_map; }
 #endif
 
+#include <sstream>
 #include <boost/functional/hash.hpp>
 
 #include "verbose.h"
@@ -14,6 +17,7 @@ namespace std { using std::tr1::unordered_set; }
 #include "filelib.h"
 #include "wordid.h"
 #include "tdict.h"
+#include "fdict.h"
 #include "hg.h"
 #include "kbest.h"
 #include "viterbi.h"
@@ -142,6 +146,139 @@ void CandidateSet::ReadFromFile(const string& file) {
   if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
 }
 
+namespace {
+
+template <typename T>
+void WriteValue(const T& v, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(istream* in, T* v) {
+  return static_cast<bool>(in->read(reinterpret_cast<char*>(v), sizeof(T)));
+}
+
+void WriteString(const string& s, ostream* out) {
+  WriteValue<uint32_t>(s.size(), out);
+  out->write(s.data(), s.size());
+}
+
+bool ReadString(istream* in, string* s) {
+  uint32_t len;
+  if (!ReadValue(in, &len)) return false;
+  s->resize(len);
+  return len == 0 || static_cast<bool>(in->read(&(*s)[0], len));
+}
+
+// maps the ids of a dictionary to consecutive local ids, in order of use
+struct LocalIds {
+  uint32_t operator()(int id) {
+    unordered_map<int, uint32_t>::iterator it = ids.find(id);
+    if (it != ids.end()) return it->second;
+    ids[id] = order.size();
+    order.push_back(id);
+    return order.size() - 1;
+  }
+  unordered_map<int, uint32_t> ids;
+  vector<int> order;
+};
+
+}  // namespace
+
+// Layout: the words and feature names used by the set, the metric id, then
+// the candidates as local word ids, (local feature id, value) pairs and the
+// fields of their sufficient statistics.
+void CandidateSet::WriteBinary(ostream* out) const {
+  LocalIds words, feats;
+  string body;
+  {
+    ostringstream os;
+    for (unsigned i = 0; i < cs.size(); ++i) {
+      const Candidate& c = cs[i];
+      WriteValue<uint32_t>(c.ewords.size(), &os);
+      for (unsigned j = 0; j < c.ewords.size(); ++j)
+        WriteValue(words(c.ewords[j]), &os);
+      WriteValue<uint32_t>(c.fmap.size(), &os);
+      for (SparseVector<double>::const_iterator it = c.fmap.begin(); it != c.fmap.end(); ++it) {
+        WriteValue(feats(it->first), &os);
+        WriteValue(it->second, &os);
+      }
+      WriteValue<uint32_t>(c.eval_feats.fields.size(), &os);
+      if (c.eval_feats.fields.size())
+        os.write(reinterpret_cast<const char*>(&c.eval_feats.fields[0]),
+                 c.eval_feats.fields.size() * sizeof(float));
+    }
+    body = os.str();
+  }
+  WriteValue<uint32_t>(words.order.size(), out);
+  for (unsigned i = 0; i < words.order.size(); ++i)
+    WriteString(TD::Convert(words.order[i]), out);
+  WriteValue<uint32_t>(feats.order.size(), out);
+  for (unsigned i = 0; i < feats.order.size(); ++i)
+    WriteString(FD::Convert(feats.order[i]), out);
+  WriteString(cs.empty() ? string() : cs[0].eval_feats.id_, out);
+  WriteValue<uint32_t>(cs.size(), out);
+  out->write(body.data(), body.size());
+}
+
+// reads a candidate written by WriteBinary; words and feats map the local
+// ids of the set, which must be in range
+static bool ReadCandidate(istream* in, const vector<WordID>& words, const vector<int>& feats, Candidate* c) {
+  uint32_t len, id;
+  if (!ReadValue(in, &len)) return false;
+  c->ewords.resize(len);
+  for (unsigned j = 0; j < len; ++j) {
+    if (!ReadValue(in, &id) || id >= words.size()) return false;
+    c->ewords[j] = words[id];
+  }
+  if (!ReadValue(in, &len)) return false;
+  for (unsigned j = 0; j < len; ++j) {
+    double val;
+    if (!ReadValue(in, &id) || id >= feats.size() || !ReadValue(in, &val)) return false;
+    c->fmap.set_value(feats[id], val);
+  }
+  if (!ReadValue(in, &len)) return false;
+  c->eval_feats.fields.resize(len);
+  return len == 0 ||
+      static_cast<bool>(in->read(reinterpret_cast<char*>(&c->eval_feats.fields[0]), len * sizeof(float)));
+}
+
+bool CandidateSet::ReadBinary(istream* in) {
+  uint32_t n;
+  string s;
+  if (!ReadValue(in, &n)) return false;
+  vector<WordID> words(n);
+  for (unsigned i = 0; i < n; ++i) {
+    if (!ReadString(in, &s)) return false;
+    words[i] = TD::Convert(s);
+  }
+  if (!ReadValue(in, &n)) return false;
+  vector<int> feats(n);
+  for (unsigned i = 0; i < n; ++i) {
+    if (!ReadString(in, &s)) return false;
+    feats[i] = FD::Convert(s);
+  }
+  string metric_id;
+  if (!ReadString(in, &metric_id)) return false;
+  if (!ReadValue(in, &n)) return false;
+  const size_t start = cs.size();
+  cs.resize(start + n);
+  for (unsigned i = 0; i < n; ++i) {
+    Candidate& c = cs[start + i];
+    if (!ReadCandidate(in, words, feats, &c)) {
+      cs.resize(start);
+      return false;
+    }
+    c.eval_feats.id_ = metric_id;
+  }
+  return true;
+}
+
+void CandidateSet::AddCandidates(const CandidateSet& other) {
+  cs.insert(cs.end(), other.cs.begin(), other.cs.end());
+  Dedup();
+}
+
 void CandidateSet::Dedup() {
   if(!SILENT) cerr << "Dedup in=" << cs.size();
   unordered_set<Candidate, CandidateHasher, CandidateCompare> u;
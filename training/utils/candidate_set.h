@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <iostream>
 
 #include "ns.h"
 #include "wordid.h"
@@ -46,6 +47,15 @@ class CandidateSet {
 
   void ReadFromFile(const std::string& file);
   void WriteToFile(const std::string& file) const;
+  // a compact binary form, in which every word and feature name is written
+  // once per set (so that sets can be exchanged by processes whose
+  // dictionaries differ); like ReadFromFile, ReadBinary appends to the set.
+  // It returns false, leaving the set as it was, if in is truncated or
+  // refers to words or features it does not define.
+  bool ReadBinary(std::istream* in);
+  void WriteBinary(std::ostream* out) const;
+  // adds the candidates of other that are not already in the set
+  void AddCandidates(const CandidateSet& other);
   void AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   void AddUniqueKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   // TODO add code to draw k samples
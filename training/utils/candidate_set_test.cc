@@ -0,0 +1,121 @@
+#define BOOST_TEST_MODULE CandidateSetTest
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "candidate_set.h"
+#include "fdict.h"
+#include "tdict.h"
+
+using namespace std;
+using training::CandidateSet;
+
+// a set of two candidates, read from a temporary text file
+static void MakeSet(CandidateSet* cs) {
+  char fname[] = "/tmp/candidate_set_test.XXXXXX";
+  const int fd = mkstemp(fname);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+  {
+    ofstream out(fname);
+    SparseVector<double> f1, f2;
+    f1.set_value(FD::Convert("LanguageModel"), -4.5);
+    f1.set_value(FD::Convert("WordPenalty"), -2);
+    f2.set_value(FD::Convert("WordPenalty"), -3);
+    string ss;
+    out << "a small house" << endl << f1 << endl;
+    SufficientStats(string("IBM_BLEU"), vector<float>(8, 1.5f)).Encode(&ss);
+    out << ss << endl;
+    out << "a very small house" << endl << f2 << endl;
+    SufficientStats(string("IBM_BLEU"), vector<float>(8, 2.0f)).Encode(&ss);
+    out << ss << endl;
+  }
+  cs->ReadFromFile(fname);
+  unlink(fname);
+  BOOST_REQUIRE_EQUAL(cs->size(), 2u);
+}
+
+template <typename T>
+static void Put(const T& v, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+static void PutString(const string& s, ostream* out) {
+  Put<uint32_t>(s.size(), out);
+  out->write(s.data(), s.size());
+}
+
+BOOST_AUTO_TEST_CASE(BinaryRoundTrip) {
+  CandidateSet cs;
+  MakeSet(&cs);
+  ostringstream os;
+  cs.WriteBinary(&os);
+  istringstream is(os.str());
+  CandidateSet read;
+  BOOST_REQUIRE(read.ReadBinary(&is));
+  BOOST_REQUIRE_EQUAL(read.size(), cs.size());
+  for (unsigned i = 0; i < cs.size(); ++i) {
+    BOOST_CHECK(read[i].ewords == cs[i].ewords);
+    BOOST_CHECK(read[i].fmap == cs[i].fmap);
+    BOOST_CHECK_EQUAL(read[i].eval_feats.id_, cs[i].eval_feats.id_);
+    BOOST_CHECK(read[i].eval_feats.fields == cs[i].eval_feats.fields);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TruncatedBinary) {
+  CandidateSet cs;
+  MakeSet(&cs);
+  ostringstream os;
+  cs.WriteBinary(&os);
+  const string buf = os.str();
+  CandidateSet read;
+  MakeSet(&read);
+  for (unsigned len = 0; len < buf.size(); len += 7) {
+    istringstream is(buf.substr(0, len));
+    BOOST_CHECK(!read.ReadBinary(&is));
+    BOOST_CHECK_EQUAL(read.size(), 2u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CorruptIds) {
+  // one word and one feature, and a candidate that refers to word 5
+  ostringstream words;
+  Put<uint32_t>(1, &words);
+  PutString("house", &words);
+  Put<uint32_t>(1, &words);
+  PutString("WordPenalty", &words);
+  PutString("IBM_BLEU", &words);
+  Put<uint32_t>(1, &words);
+  Put<uint32_t>(1, &words);
+  Put<uint32_t>(5, &words);
+  Put<uint32_t>(0, &words);
+  Put<uint32_t>(0, &words);
+  CandidateSet read;
+  istringstream is(words.str());
+  BOOST_CHECK(!read.ReadBinary(&is));
+  BOOST_CHECK_EQUAL(read.size(), 0u);
+
+  // the same with feature 3
+  ostringstream feats;
+  Put<uint32_t>(1, &feats);
+  PutString("house", &feats);
+  Put<uint32_t>(1, &feats);
+  PutString("WordPenalty", &feats);
+  PutString("IBM_BLEU", &feats);
+  Put<uint32_t>(1, &feats);
+  Put<uint32_t>(1, &feats);
+  Put<uint32_t>(0, &feats);
+  Put<uint32_t>(1, &feats);
+  Put<uint32_t>(3, &feats);
+  Put<double>(-1.0, &feats);
+  Put<uint32_t>(0, &feats);
+  istringstream is2(feats.str());
+  BOOST_CHECK(!read.ReadBinary(&is2));
+  BOOST_CHECK_EQUAL(read.size(), 0u);
+}
@@ -0,0 +1,70 @@
+#ifndef _FORK_WORKERS_H_
+#define _FORK_WORKERS_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Runs jobs worker processes forked from this one. They share the loaded
+// grammars and models with it (copy-on-write), but none of the state either
+// side changes afterwards (e.g. the dictionaries, so any words or features
+// in the results should be sent as strings), and need no locks.
+// Worker k calls work(k, &out), which serializes its results into out;
+// they are sent to this process through a pipe, and read(k, &in) is called
+// with the results of every worker in worker order. Both return false on
+// failure, in which case (or if a worker dies) this process exits.
+//
+// Every call forks the workers anew, which costs a few milliseconds plus
+// the page faults of the copy-on-write memory they touch, so callers should
+// give each worker more than a sentence or two of work.
+template <class Work, class Read>
+void ForkWorkers(unsigned jobs, Work& work, Read& read) {
+  std::vector<pid_t> pids(jobs);
+  std::vector<FILE*> pipes(jobs);
+  std::cout.flush();
+  std::cerr.flush();
+  for (unsigned k = 0; k < jobs; ++k) {
+    int fd[2];
+    if (pipe(fd) < 0) { perror("pipe"); exit(1); }
+    pids[k] = fork();
+    if (pids[k] < 0) { perror("fork"); exit(1); }
+    if (pids[k] == 0) {  // worker
+      close(fd[0]);
+      std::ostringstream os;
+      bool ok = work(k, &os);
+      const std::string buf = os.str();
+      FILE* out = fdopen(fd[1], "w");
+      ok = ok && fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+      ok = (fclose(out) == 0) && ok;
+      _exit(ok ? 0 : 1);
+    }
+    close(fd[1]);
+    pipes[k] = fdopen(fd[0], "r");
+  }
+  bool failed = false;
+  for (unsigned k = 0; k < jobs; ++k) {
+    std::string buf;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), pipes[k])) > 0)
+      buf.append(chunk, n);
+    fclose(pipes[k]);
+    int status = 0;
+    waitpid(pids[k], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) failed = true;
+    if (failed) continue;
+    std::istringstream is(buf);
+    if (!read(k, &is)) failed = true;
+  }
+  if (failed) {
+    std::cerr << "A worker process failed, exiting\n";
+    exit(1);
+  }
+}
+
+#endif
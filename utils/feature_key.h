@@ -0,0 +1,56 @@
+#ifndef FEATURE_KEY_H_
+#define FEATURE_KEY_H_
+
+#include <string>
+#include <vector>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include <boost/functional/hash.hpp>
+
+#include "fdict.h"
+
+// Interns sparse features by a key made of small integers (usually a
+// template number chosen by the feature function followed by WordIDs,
+// categories or sizes) instead of by their names, so that a feature
+// function only formats the name of a feature (and looks it up in FD) the
+// first time it sees the key, e.g.
+//
+//   key.clear(); key.push_back(kBigram); key.push_back(w1); key.push_back(w2);
+//   int fid = fkeys.Find(key);
+//   if (fid < 0) fid = fkeys.Insert(key, "BI:" + TD::Convert(w1) + ...);
+//
+// The name is still registered in FD when the key is first seen (not only
+// when weights are written), so that the feature gets the same id as a
+// feature of that name read from a weights file.
+class FeatureKeyMap {
+ public:
+  typedef std::vector<int> Key;
+
+  // returns the id of the feature with key, or -1 if it has not been inserted
+  int Find(const Key& key) const {
+    const Map::const_iterator it = map_.find(key);
+    return it == map_.end() ? -1 : it->second;
+  }
+
+  // registers the feature with key and name; returns its id (0 if FD is
+  // frozen and does not contain name)
+  int Insert(const Key& key, const std::string& name) {
+    const int fid = FD::Convert(name);
+    map_[key] = fid;
+    return fid;
+  }
+
+  unsigned size() const { return map_.size(); }
+  void clear() { map_.clear(); }
+
+ private:
+  typedef std::unordered_map<Key, int, boost::hash<Key> > Map;
+  Map map_;
+};
+
+#endif
@@ -73,10 +73,11 @@ gzstreambuf * gzstreambuf::close() {
     if ( is_open()) {
         sync();
         opened = 0;
+        // gzclose frees file even when it fails (e.g. on a truncated input),
+        // so the error cannot be looked up; the stream's close() sets
+        // badbit, and the destructors do not throw
         if ( gzclose( file) == Z_OK)
             return this;
-        else
-            handle_gzerror();
     }
     return (gzstreambuf*)0;
 }
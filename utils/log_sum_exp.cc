@@ -0,0 +1,63 @@
+#include "log_sum_exp.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+#ifdef CDEC_FAST_LOG_SUM_EXP
+bool use_fast = true;
+#else
+bool use_fast = false;
+#endif
+
+inline double MaxOf(const double* x, unsigned n) {
+  double m = x[0];
+  for (unsigned i = 1; i < n; ++i)
+    if (x[i] > m) m = x[i];
+  return m;
+}
+}
+
+void SetFastLogSumExp(bool fast) { use_fast = fast; }
+
+bool FastLogSumExp() { return use_fast; }
+
+double LogSumExpExact(const double* x, unsigned n) {
+  if (!n) return -std::numeric_limits<double>::infinity();
+  const double m = MaxOf(x, n);
+  if (m == -std::numeric_limits<double>::infinity()) return m;
+  double sum = 0;
+  for (unsigned i = 0; i < n; ++i)
+    sum += std::exp(x[i] - m);
+  return m + std::log(sum);
+}
+
+double LogSumExpFast(const double* x, unsigned n) {
+  if (!n) return -std::numeric_limits<double>::infinity();
+  const double m = MaxOf(x, n);
+  if (m == -std::numeric_limits<double>::infinity()) return m;
+  // the exps are computed into a buffer (a loop without dependencies between
+  // iterations, which vectorizes) and summed with four accumulators
+  const unsigned kCHUNK = 64;
+  double e[kCHUNK];
+  double sum[4] = { 0, 0, 0, 0 };
+  for (unsigned b = 0; b < n; b += kCHUNK) {
+    const unsigned len = n - b < kCHUNK ? n - b : kCHUNK;
+    const double* xb = x + b;
+    for (unsigned i = 0; i < len; ++i)
+      e[i] = FastExp(xb[i] - m);
+    unsigned i = 0;
+    for (; i + 4 <= len; i += 4) {
+      sum[0] += e[i];
+      sum[1] += e[i + 1];
+      sum[2] += e[i + 2];
+      sum[3] += e[i + 3];
+    }
+    for (; i < len; ++i) sum[0] += e[i];
+  }
+  return m + std::log((sum[0] + sum[1]) + (sum[2] + sum[3]));
+}
+
+double LogSumExp(const double* x, unsigned n) {
+  return use_fast ? LogSumExpFast(x, n) : LogSumExpExact(x, n);
+}
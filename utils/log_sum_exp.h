@@ -0,0 +1,59 @@
+#ifndef LOG_SUM_EXP_H_
+#define LOG_SUM_EXP_H_
+
+#include <cstring>
+#include <stdint.h>
+
+// log(exp(x[0]) + ... + exp(x[n-1])), computed in one pass over x after
+// shifting by max_i x[i], so that it costs one exp() per value and a single
+// log() rather than a log1p(exp()) per addition (as a chain of LogVal +=
+// does). Values may be -infinity (log 0); the result is -infinity if all are.
+double LogSumExp(const double* x, unsigned n);
+
+// the two implementations LogSumExp chooses between:
+//  - LogSumExpExact uses std::exp
+//  - LogSumExpFast uses FastExp (below), written as a branch-free loop over
+//    x so that the compiler can vectorize it
+double LogSumExpExact(const double* x, unsigned n);
+double LogSumExpFast(const double* x, unsigned n);
+
+// selects the implementation used by LogSumExp (default: exact). It can
+// also be made the default at build time with -DCDEC_FAST_LOG_SUM_EXP.
+void SetFastLogSumExp(bool fast);
+bool FastLogSumExp();
+
+// exp(x) for x <= 0 with a relative error below 1e-11 for x > -708 (and 0
+// for smaller x, where exp underflows anyway): x = k*ln(2) + r with
+// |r| <= ln(2)/2, exp(r) by a degree 10 Taylor polynomial (truncation error
+// < |r|^11/11! < 2.3e-13), and 2^k by writing the exponent bits.
+inline double FastExp(double x) {
+  const double kLOG2E = 1.4426950408889634;
+  const double kLN2_HI = 6.93145751953125e-1;
+  const double kLN2_LO = 1.42860682030941723212e-6;
+  const double kROUND = 6755399441055744.0;  // 1.5 * 2^52
+  const double xc = x < -708.0 ? -708.0 : x;
+  // round x/ln(2) to the nearest integer k in the low bits of kt
+  const double kt = xc * kLOG2E + kROUND;
+  const double k = kt - kROUND;
+  const double r = (xc - k * kLN2_HI) - k * kLN2_LO;
+  double p = 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  int64_t bits;
+  std::memcpy(&bits, &kt, sizeof(bits));
+  // the mantissa of kt holds 2^51 + k; the exponent of 2^k is k + 1023
+  const int64_t e = ((bits & 0xfffffffffffffLL) - (1LL << 51) + 1023) << 52;
+  double scale;
+  std::memcpy(&scale, &e, sizeof(scale));
+  return x < -708.0 ? 0.0 : p * scale;
+}
+
+#endif
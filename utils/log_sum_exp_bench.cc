@@ -0,0 +1,53 @@
+#include "log_sum_exp.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include "logval.h"
+
+using namespace std;
+
+// compares the cost of summing n log probabilities with LogVal +=, with
+// LogSumExpExact and with LogSumExpFast
+int main(int argc, char** argv) {
+  if (argc > 3) {
+    cerr << "Usage: " << argv[0] << " [values per sum (32)] [sums (100000)]\n";
+    return 1;
+  }
+  const unsigned kN = argc > 1 ? atoi(argv[1]) : 32;
+  const unsigned kREPS = argc > 2 ? atoi(argv[2]) : 100000;
+  if (!kN || !kREPS) {
+    cerr << "Both counts must be positive\n";
+    return 1;
+  }
+  vector<double> x(kN);
+  for (unsigned i = 0; i < kN; ++i) x[i] = -0.37 * i - 1.0 / (i + 1);
+  double sink = 0;
+  clock_t t = clock();
+  for (unsigned r = 0; r < kREPS; ++r) {
+    LogVal<double> sum;
+    x[r % kN] -= 1e-9;
+    for (unsigned i = 0; i < kN; ++i) sum += LogVal<double>(x[i], false);
+    sink += log(sum);
+  }
+  const double t_logval = double(clock() - t) / CLOCKS_PER_SEC;
+  t = clock();
+  for (unsigned r = 0; r < kREPS; ++r) {
+    x[r % kN] -= 1e-9;
+    sink += LogSumExpExact(&x[0], kN);
+  }
+  const double t_exact = double(clock() - t) / CLOCKS_PER_SEC;
+  t = clock();
+  for (unsigned r = 0; r < kREPS; ++r) {
+    x[r % kN] -= 1e-9;
+    sink += LogSumExpFast(&x[0], kN);
+  }
+  const double t_fast = double(clock() - t) / CLOCKS_PER_SEC;
+  cout << kREPS << " sums of " << kN << " values: LogVal += " << t_logval
+       << "s, LogSumExpExact " << t_exact << "s, LogSumExpFast " << t_fast
+       << "s (" << sink << ")\n";
+  return 0;
+}
@@ -0,0 +1,51 @@
+#include "log_sum_exp.h"
+#define BOOST_TEST_MODULE LogSumExpTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "logval.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(FastExpError) {
+  double max_err = 0;
+  for (double x = -707.9; x <= 0; x += 0.0137) {
+    const double err = fabs(FastExp(x) - exp(x)) / exp(x);
+    if (err > max_err) max_err = err;
+  }
+  cerr << "max relative error of FastExp: " << max_err << endl;
+  BOOST_CHECK_LT(max_err, 1e-11);
+  BOOST_CHECK_EQUAL(FastExp(0), 1.0);
+  BOOST_CHECK_EQUAL(FastExp(-800), 0.0);
+  BOOST_CHECK_EQUAL(FastExp(-numeric_limits<double>::infinity()), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(Sums) {
+  const double kLOG0 = -numeric_limits<double>::infinity();
+  vector<double> x;
+  x.push_back(-3.2);
+  x.push_back(-1000.5);
+  x.push_back(kLOG0);
+  x.push_back(-2.1);
+  x.push_back(-4.0);
+  LogVal<double> ref;
+  for (unsigned i = 0; i < x.size(); ++i) ref += LogVal<double>(x[i], false);
+  BOOST_CHECK_CLOSE(LogSumExpExact(&x[0], x.size()), log(ref), 1e-12);
+  BOOST_CHECK_CLOSE(LogSumExpFast(&x[0], x.size()), log(ref), 1e-9);
+  const double zeros[] = { kLOG0, kLOG0 };
+  BOOST_CHECK_EQUAL(LogSumExpExact(zeros, 2), kLOG0);
+  BOOST_CHECK_EQUAL(LogSumExpFast(zeros, 2), kLOG0);
+  BOOST_CHECK_EQUAL(LogSumExp(zeros, 0), kLOG0);
+  // values far from 0 do not overflow
+  const double big[] = { 2000.0, 2000.0 };
+  BOOST_CHECK_CLOSE(LogSumExp(big, 2), 2000.0 + log(2.0), 1e-12);
+  SetFastLogSumExp(true);
+  BOOST_CHECK(FastLogSumExp());
+  BOOST_CHECK_CLOSE(LogSumExp(big, 2), 2000.0 + log(2.0), 1e-12);
+  SetFastLogSumExp(false);
+}
+
@@ -604,6 +604,20 @@ vector<double> ME_Model::classify(ME_Sample& mes) const {
   return vp;
 }
 
+void ME_Model::classify(const vector<int>& feature_ids,
+                        vector<double>& membp) const {
+  // the reference model needs the feature strings
+  assert(_ref_modelp == NULL);
+  Sample s;
+  s.positive_features.reserve(feature_ids.size());
+  for (vector<int>::const_iterator j = feature_ids.begin();
+       j != feature_ids.end(); j++) {
+    if (*j >= 0) s.positive_features.push_back(*j);
+  }
+  membp.resize(_num_classes);
+  classify(s, membp);
+}
+
 // template<class FuncGrad>
 // std::vector<double>
 // perform_LBFGS(FuncGrad func_grad, const std::vector<double> & x0);
@@ -137,11 +137,18 @@ class ME_Model {
   void add_training_sample(const ME_Sample& s);
   int train();
   std::vector<double> classify(ME_Sample& s) const;
+  // classify a sample whose features were already mapped with
+  // get_feature_id(); ids < 0 (unknown features) are ignored.
+  void classify(const std::vector<int>& feature_ids,
+                std::vector<double>& membp) const;
   bool load_from_file(const std::string& filename);
   bool save_to_file(const std::string& filename, const double th = 0) const;
   int num_classes() const { return _num_classes; }
   std::string get_class_label(int i) const { return _label_bag.Str(i); }
   int get_class_id(const std::string& s) const { return _label_bag.Id(s); }
+  int get_feature_id(const std::string& s) const {
+    return _featurename_bag.Id(s);
+  }
   void get_features(
       std::list<std::pair<std::pair<std::string, std::string>, double> >& fl);
   void set_heldout(const int h, const int n = 0) {
@@ -0,0 +1,38 @@
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <boost/thread.hpp>
+
+// Calls f(i) for every i in [0, n) using up to threads threads (including
+// the calling one). The indices are handed out in order from a shared
+// counter, so an idle thread always takes the next pending item and uneven
+// work (long sentences, large k-best lists) stays balanced. f must be safe
+// to call concurrently for different indices; results should be written to
+// slot i of a preallocated vector so that the caller can consume them in
+// order once ParallelFor returns.
+template <class F>
+void ParallelFor(size_t n, unsigned threads, F f) {
+  if (threads > n) threads = n;
+  if (threads <= 1) {
+    for (size_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  struct Worker {
+    std::atomic<size_t>* next;
+    size_t n;
+    F* f;
+    void operator()() const {
+      for (size_t i = (*next)++; i < n; i = (*next)++) (*f)(i);
+    }
+  } worker = { &next, n, &f };
+  boost::thread_group group;
+  for (unsigned t = 1; t < threads; ++t)
+    group.create_thread(worker);
+  worker();
+  group.join_all();
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 #include <cmath>
 #include <utility>
 #ifndef HAVE_OLD_CPP
@@ -19,6 +20,7 @@ namespace std { using std::tr1::unordered_map; }
 #include "ttables.h"
 #include "tdict.h"
 #include "da.h"
+#include "parallel_for.h"
 
 namespace po = boost::program_options;
 using namespace std;
@@ -42,6 +44,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("hide_training_alignments,H", "Hide training alignments (only useful if you want to use -x option and just compute testset statistics)")
         ("testset,x", po::value<string>(), "After training completes, compute the log likelihood of this set of sentence pairs under the learned model")
         ("no_add_viterbi,V","When writing model parameters, do not add Viterbi alignment points (may generate a grammar where some training sentence pairs are unreachable)")
+        ("threads,j",po::value<unsigned>()->default_value(1),"Number of threads to run the E-step (and to align --batch input) with")
+        ("batch,b","With --force_align or --testset, read batches of sentence pairs, each a line with the number n of pairs followed by n pairs (which may be empty lines), and answer every batch with its n alignments; for use as a persistent alignment server over a pipe")
 		("force_align,f",po::value<string>(), "Load previously written parameters to 'force align' input. Set --diagonal_tension and --mean_srclen_multiplier as estimated during training.")
 		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier");
   po::options_description clo("Command line options");
@@ -67,6 +71,207 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   return true;
 }
 
+// the training corpus as integer arrays: the words of sentence s are
+// src[src_start[s]] ... src[src_start[s+1]-1] (and likewise for trg)
+struct ParallelCorpus {
+  ParallelCorpus() : src_start(1, 0), trg_start(1, 0) {}
+  size_t size() const { return src_start.size() - 1; }
+  vector<WordID> src;
+  vector<WordID> trg;
+  vector<size_t> src_start;
+  vector<size_t> trg_start;
+};
+
+// the alignment distribution
+struct AlignmentModel {
+  bool use_null;
+  bool favor_diagonal;
+  double prob_align_null;
+  double prob_align_not_null;
+  double diagonal_tension;
+  WordID kNULL;
+};
+
+// what one thread accumulates in an iteration of EM
+struct EStepStats {
+  EStepStats() : likelihood(), c0(), emp_feat() {}
+  vector<double> counts;  // indexed like the parameters of the ttable
+  vector<char> viterbi;   // parameters used by a Viterbi alignment
+  double likelihood;
+  double c0;
+  double emp_feat;
+};
+
+// runs the E-step (or, in the final iteration, finds the Viterbi alignments)
+// for the sentences of a block; the block is split into one contiguous
+// shard per thread, so the results do not depend on scheduling
+struct EStep {
+  EStep(const ParallelCorpus& c, size_t b, size_t e, const TTable& t,
+        const AlignmentModel& m, bool r, bool fi, bool wa,
+        vector<EStepStats>* s, vector<string>* o) :
+      corpus(c), begin(b), end(e), s2t(t), model(m), reverse(r),
+      final_iteration(fi), write_alignments(wa), stats(s), out(o) {}
+
+  void operator()(size_t t) const {
+    const size_t n = stats->size();
+    const size_t sb = begin + (end - begin) * t / n;
+    const size_t se = begin + (end - begin) * (t + 1) / n;
+    EStepStats& st = (*stats)[t];
+    ostringstream os;
+    vector<double> probs;
+    vector<int> params;
+    for (size_t s = sb; s < se; ++s) {
+      const WordID* src = &corpus.src[corpus.src_start[s]];
+      const WordID* trg = &corpus.trg[corpus.trg_start[s]];
+      const unsigned src_size = corpus.src_start[s + 1] - corpus.src_start[s];
+      const unsigned trg_size = corpus.trg_start[s + 1] - corpus.trg_start[s];
+      probs.resize(src_size + 1);
+      params.resize(src_size + 1);
+      bool first_al = true;  // used for write_alignments
+      for (unsigned j = 0; j < trg_size; ++j) {
+        const WordID& f_j = trg[j];
+        double sum = 0;
+        double prob_a_i = 1.0 / (src_size + model.use_null);  // uniform (model 1)
+        if (model.use_null) {
+          if (model.favor_diagonal) prob_a_i = model.prob_align_null;
+          params[0] = s2t.index(model.kNULL, f_j);
+          probs[0] = s2t.param(params[0]) * prob_a_i;
+          sum += probs[0];
+        }
+        double az = 0;
+        if (model.favor_diagonal)
+          az = DiagonalAlignment::ComputeZ(j+1, trg_size, src_size, model.diagonal_tension) / model.prob_align_not_null;
+        for (unsigned i = 1; i <= src_size; ++i) {
+          if (model.favor_diagonal)
+            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg_size, src_size, model.diagonal_tension) / az;
+          params[i] = s2t.index(src[i-1], f_j);
+          probs[i] = s2t.param(params[i]) * prob_a_i;
+          sum += probs[i];
+        }
+        if (final_iteration) {
+          if (st.viterbi.size()) {
+            double max_p = -1;
+            int max_index = -1;
+            if (model.use_null) {
+              max_index = 0;
+              max_p = probs[0];
+            }
+            for (unsigned i = 1; i <= src_size; ++i) {
+              if (probs[i] > max_p) {
+                max_index = i;
+                max_p = probs[i];
+              }
+            }
+            if (write_alignments) {
+              if (max_index > 0) {
+                if (first_al) first_al = false; else os << ' ';
+                if (reverse)
+                  os << j << '-' << (max_index - 1);
+                else
+                  os << (max_index - 1) << '-' << j;
+              }
+            }
+            st.viterbi[params[max_index]] = 1;
+          }
+        } else {
+          if (model.use_null) {
+            double count = probs[0] / sum;
+            st.c0 += count;
+            st.counts[params[0]] += count;
+          }
+          for (unsigned i = 1; i <= src_size; ++i) {
+            const double p = probs[i] / sum;
+            st.counts[params[i]] += p;
+            st.emp_feat += DiagonalAlignment::Feature(j, i, trg_size, src_size) * p;
+          }
+        }
+        st.likelihood += log(sum);
+      }
+      if (write_alignments) os << endl;
+    }
+    if (write_alignments) (*out)[t] = os.str();
+  }
+
+  const ParallelCorpus& corpus;
+  const size_t begin;
+  const size_t end;
+  const TTable& s2t;
+  const AlignmentModel& model;
+  const bool reverse;
+  const bool final_iteration;
+  const bool write_alignments;
+  vector<EStepStats>* stats;
+  vector<string>* out;
+};
+
+// a sentence pair of a test set (or of --force_align input)
+struct TestPair {
+  vector<WordID> src;
+  vector<WordID> trg;
+  string out;  // src ||| trg ||| Viterbi alignment ||| log p(trg|src)
+  double log_prob;
+};
+
+struct TestAligner {
+  TestAligner(const TTable& t, const AlignmentModel& m, double msm, bool r,
+              bool wa, vector<TestPair>* p) :
+      s2t(t), model(m), mean_srclen_multiplier(msm), reverse(r),
+      write_alignments(wa), pairs(p) {}
+
+  void operator()(size_t n) const {
+    TestPair& pair = (*pairs)[n];
+    ostringstream os;
+    os << TD::GetString(pair.src) << " ||| " << TD::GetString(pair.trg) << " |||";
+    const vector<WordID>& src = reverse ? pair.trg : pair.src;
+    const vector<WordID>& trg = reverse ? pair.src : pair.trg;
+    double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
+
+    // compute likelihood
+    for (unsigned j = 0; j < trg.size(); ++j) {
+      const WordID& f_j = trg[j];
+      double sum = 0;
+      int a_j = 0;
+      double max_pat = 0;
+      double prob_a_i = 1.0 / (src.size() + model.use_null);  // uniform (model 1)
+      if (model.use_null) {
+        if (model.favor_diagonal) prob_a_i = model.prob_align_null;
+        max_pat = s2t.prob(model.kNULL, f_j) * prob_a_i;
+        sum += max_pat;
+      }
+      double az = 0;
+      if (model.favor_diagonal)
+        az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), model.diagonal_tension) / model.prob_align_not_null;
+      for (unsigned i = 1; i <= src.size(); ++i) {
+        if (model.favor_diagonal)
+          prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), model.diagonal_tension) / az;
+        double pat = s2t.prob(src[i-1], f_j) * prob_a_i;
+        if (pat > max_pat) { max_pat = pat; a_j = i; }
+        sum += pat;
+      }
+      log_prob += log(sum);
+      if (write_alignments) {
+        if (a_j > 0) {
+          os << ' ';
+          if (reverse)
+            os << j << '-' << (a_j - 1);
+          else
+            os << (a_j - 1) << '-' << j;
+        }
+      }
+    }
+    os << " ||| " << log_prob << endl;
+    pair.log_prob = log_prob;
+    pair.out = os.str();
+  }
+
+  const TTable& s2t;
+  const AlignmentModel& model;
+  const double mean_srclen_multiplier;
+  const bool reverse;
+  const bool write_alignments;
+  vector<TestPair>* pairs;
+};
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   if (!InitCommandLine(argc, argv, &conf)) return 1;
@@ -83,6 +288,7 @@ int main(int argc, char** argv) {
   bool optimize_tension = conf.count("optimize_tension");
   bool hide_training_alignments = (conf.count("hide_training_alignments") > 0);
   const bool write_alignments = (conf.count("force_align")) ? true : !hide_training_alignments;
+  const bool batch_mode = conf.count("batch");
   string testset;
   if (conf.count("testset")) testset = conf["testset"].as<string>();
   if (conf.count("force_align")) testset = fname;
@@ -97,11 +303,11 @@ int main(int argc, char** argv) {
   
   
   TTable s2t, t2s;
-  TTable::Word2Word2Double s2t_viterbi;
+  vector<char> s2t_viterbi;
   unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > size_counts;
   double tot_len_ratio = 0;
   double mean_srclen_multiplier = 0;
-  vector<double> probs;
+  const unsigned threads = max(1u, conf["threads"].as<unsigned>());
   
   if (conf.count("force_align")) {
 	// load model parameters
@@ -109,22 +315,19 @@ int main(int argc, char** argv) {
 	s2t.DeserializeLogProbsFromText(s2t_f.stream());
 	mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
   }
-  
-  for (int iter = 0; iter < ITERATIONS; ++iter) {
-    const bool final_iteration = (iter == (ITERATIONS - 1));
-    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+
+  // the corpus is read once; the parameters of the ttable are the pairs
+  // of words that co-occur in it, all equally likely at first
+  ParallelCorpus corpus;
+  double toks = 0;
+  if (ITERATIONS > 0) {
     ReadFile rf(fname);
     istream& in = *rf.stream();
-    double likelihood = 0;
-    double denom = 0.0;
+    TTable::Word2Word2Double cooc;
     int lc = 0;
     bool flag = false;
     string line;
-    string ssrc, strg;
     vector<WordID> src, trg;
-    double c0 = 0;
-    double emp_feat = 0;
-    double toks = 0;
     while(true) {
       getline(in, line);
       if (!in) break;
@@ -138,84 +341,76 @@ int main(int argc, char** argv) {
         cerr << "Error: " << lc << "\n" << line << endl;
         return 1;
       }
-      if (iter == 0)
-        tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
-      denom += trg.size();
-      probs.resize(src.size() + 1);
-      if (iter == 0)
-        ++size_counts[make_pair<short,short>(trg.size(), src.size())];
-      bool first_al = true;  // used for write_alignments
+      tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
+      ++size_counts[make_pair<short,short>(trg.size(), src.size())];
       toks += trg.size();
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          probs[0] = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += probs[0];
-        }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
-          sum += probs[i];
-        }
-        if (final_iteration) {
-          if (add_viterbi || write_alignments) {
-            WordID max_i = 0;
-            double max_p = -1;
-            int max_index = -1;
-            if (use_null) {
-              max_i = kNULL;
-              max_index = 0;
-              max_p = probs[0];
-            }
-            for (unsigned i = 1; i <= src.size(); ++i) {
-              if (probs[i] > max_p) {
-                max_index = i;
-                max_p = probs[i];
-                max_i = src[i-1];
-              }
-            }
-            if (!hide_training_alignments && write_alignments) {
-              if (max_index > 0) {
-                if (first_al) first_al = false; else cout << ' ';
-                if (reverse)
-                  cout << j << '-' << (max_index - 1);
-                else
-                  cout << (max_index - 1) << '-' << j;
-              }
-            }
-            if (s2t_viterbi.size() <= static_cast<unsigned>(max_i)) s2t_viterbi.resize(max_i + 1);
-            s2t_viterbi[max_i][f_j] = 1.0;
-          }
-        } else {
-          if (use_null) {
-            double count = probs[0] / sum;
-            c0 += count;
-            s2t.Increment(kNULL, f_j, count);
-          }
-          for (unsigned i = 1; i <= src.size(); ++i) {
-            const double p = probs[i] / sum;
-            s2t.Increment(src[i-1], f_j, p);
-            emp_feat += DiagonalAlignment::Feature(j, i, trg.size(), src.size()) * p;
-          }
-        }
-        likelihood += log(sum);
+      corpus.src.insert(corpus.src.end(), src.begin(), src.end());
+      corpus.trg.insert(corpus.trg.end(), trg.begin(), trg.end());
+      corpus.src_start.push_back(corpus.src.size());
+      corpus.trg_start.push_back(corpus.trg.size());
+      for (unsigned i = 0; i <= src.size(); ++i) {
+        if (i == 0 && !use_null) continue;
+        const WordID e = (i == 0 ? kNULL : src[i-1]);
+        if (e >= static_cast<int>(cooc.size())) cooc.resize(e + 1);
+        for (unsigned j = 0; j < trg.size(); ++j)
+          cooc[e][trg[j]] = 1e-9;
       }
-      if (write_alignments && final_iteration && !hide_training_alignments) cout << endl;
+    }
+    if (flag) { cerr << endl; }
+    s2t.Assign(cooc);
+    cerr << "Loaded " << corpus.size() << " sentence pairs, " << s2t.size() << " translation parameters\n";
+  }
+  const double denom = toks;
+
+  AlignmentModel model;
+  model.use_null = use_null;
+  model.favor_diagonal = favor_diagonal;
+  model.kNULL = kNULL;
+  // a block of sentences is aligned before its alignments are written
+  const size_t kBLOCK_SIZE = 100000;
+  vector<EStepStats> stats(threads);
+  vector<string> out(threads);
+  for (int iter = 0; iter < ITERATIONS; ++iter) {
+    const bool final_iteration = (iter == (ITERATIONS - 1));
+    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+    model.prob_align_null = prob_align_null;
+    model.prob_align_not_null = prob_align_not_null;
+    model.diagonal_tension = diagonal_tension;
+    const bool write_training_alignments = final_iteration && write_alignments && !hide_training_alignments;
+    for (unsigned t = 0; t < threads; ++t) {
+      stats[t] = EStepStats();
+      if (!final_iteration)
+        stats[t].counts.resize(s2t.size(), 0.0);
+      else if (add_viterbi || write_alignments)
+        stats[t].viterbi.resize(s2t.size(), 0);
+    }
+    for (size_t b = 0; b < corpus.size(); b += kBLOCK_SIZE) {
+      const size_t e = min(corpus.size(), b + kBLOCK_SIZE);
+      ParallelFor(threads, threads, EStep(corpus, b, e, s2t, model, reverse, final_iteration, write_training_alignments, &stats, &out));
+      if (write_training_alignments)
+        for (unsigned t = 0; t < threads; ++t) cout << out[t];
     }
 
+    // merge the statistics of the threads
+    EStepStats& st = stats[0];
+    for (unsigned t = 1; t < threads; ++t) {
+      st.likelihood += stats[t].likelihood;
+      st.c0 += stats[t].c0;
+      st.emp_feat += stats[t].emp_feat;
+      for (unsigned k = 0; k < st.counts.size(); ++k)
+        st.counts[k] += stats[t].counts[k];
+      for (unsigned k = 0; k < st.viterbi.size(); ++k)
+        st.viterbi[k] |= stats[t].viterbi[k];
+    }
+    const double likelihood = st.likelihood;
+    const double c0 = st.c0;
+    double emp_feat = st.emp_feat;
+
     // log(e) = 1.0
     double base2_likelihood = likelihood / log(2);
 
-    if (flag) { cerr << endl; }
     if (iter == 0) {
-      mean_srclen_multiplier = tot_len_ratio / lc;
+      mean_srclen_multiplier = tot_len_ratio / corpus.size();
       cerr << "expected target length = source length * " << mean_srclen_multiplier << endl;
     }
     emp_feat /= toks;
@@ -246,80 +441,69 @@ int main(int argc, char** argv) {
         cerr << "     final tension: " << diagonal_tension << endl;
       }
       if (variational_bayes)
-        s2t.NormalizeVB(alpha);
+        s2t.NormalizeVB(st.counts, alpha);
       else
-        s2t.Normalize();
+        s2t.Normalize(st.counts);
       //prob_align_null *= 0.8; // XXX
       //prob_align_null += (c0 / toks) * 0.2;
       prob_align_not_null = 1.0 - prob_align_null;
+    } else {
+      s2t_viterbi.swap(st.viterbi);
     }
   }
+  stats.clear();
   if (testset.size()) {
+    model.prob_align_null = prob_align_null;
+    model.prob_align_not_null = prob_align_not_null;
+    model.diagonal_tension = diagonal_tension;
     ReadFile rf(testset);
     istream& in = *rf.stream();
-    int lc = 0;
     double tlp = 0;
     string line;
-    while (getline(in, line)) {
-      ++lc;
-      vector<WordID> src, trg;
-      CorpusTools::ReadLine(line, &src, &trg);
-      cout << TD::GetString(src) << " ||| " << TD::GetString(trg) << " |||";
-      if (reverse) swap(src, trg);
-      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
-
-      // compute likelihood
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        int a_j = 0;
-        double max_pat = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          max_pat = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += max_pat;
-        }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          double pat = s2t.prob(src[i-1], f_j) * prob_a_i;
-          if (pat > max_pat) { max_pat = pat; a_j = i; }
-          sum += pat;
-        }
-        log_prob += log(sum);
-        if (write_alignments) {
-          if (a_j > 0) {
-            cout << ' ';
-            if (reverse)
-              cout << j << '-' << (a_j - 1);
-            else
-              cout << (a_j - 1) << '-' << j;
-          }
+    vector<TestPair> batch;
+    while (true) {
+      // the dictionary is only updated here, never while aligning
+      batch.clear();
+      unsigned n = 1;
+      if (batch_mode) {
+        // a batch is the number of its sentence pairs on a line of its
+        // own, followed by the pairs (any of which may be empty)
+        if (!getline(in, line)) break;
+        istringstream is(line);
+        if (!(is >> n)) {
+          cerr << "Expected the number of sentence pairs of a batch, got: " << line << endl;
+          return 1;
         }
       }
-      tlp += log_prob;
-      cout << " ||| " << log_prob << endl << flush;
-    } // loop over test set sentences
+      while (batch.size() < n && getline(in, line)) {
+        batch.push_back(TestPair());
+        CorpusTools::ReadLine(line, &batch.back().src, &batch.back().trg);
+      }
+      const bool more = batch.size() == n;
+      if (!more && batch_mode)
+        cerr << "Input ended after " << batch.size() << " of the " << n << " sentence pairs of a batch\n";
+      ParallelFor(batch.size(), threads, TestAligner(s2t, model, mean_srclen_multiplier, reverse, write_alignments, &batch));
+      for (unsigned i = 0; i < batch.size(); ++i) {
+        tlp += batch[i].log_prob;
+        cout << batch[i].out;
+      }
+      cout << flush;
+      if (!more) break;
+    } // loop over test set sentences (or batches)
     cerr << "TOTAL LOG PROB " << tlp << endl;
   }
 
   if (output_parameters) {
     WriteFile params_out(conf["output_parameters"].as<string>());
-    for (unsigned eind = 1; eind < s2t.ttable.size(); ++eind) {
-      const auto& cpd = s2t.ttable[eind];
-      const TTable::Word2Double& vit = s2t_viterbi[eind];
+    for (unsigned eind = 1; eind < s2t.rows(); ++eind) {
       const string& esym = TD::Convert(eind);
       double max_p = -1;
-      for (auto& fi : cpd)
-        if (fi.second > max_p) max_p = fi.second;
+      for (unsigned k = s2t.row_begin(eind); k < s2t.row_end(eind); ++k)
+        if (s2t.param(k) > max_p) max_p = s2t.param(k);
       const double threshold = max_p * BEAM_THRESHOLD;
-      for (auto& fi : cpd) {
-        if (fi.second > threshold || (vit.find(fi.first) != vit.end())) {
-          *params_out << esym << ' ' << TD::Convert(fi.first) << ' ' << log(fi.second) << endl;
+      for (unsigned k = s2t.row_begin(eind); k < s2t.row_end(eind); ++k) {
+        if (s2t.param(k) > threshold || (s2t_viterbi.size() && s2t_viterbi[k])) {
+          *params_out << esym << ' ' << TD::Convert(s2t.col(k)) << ' ' << log(s2t.param(k)) << endl;
         }
       } 
     }
@@ -0,0 +1,77 @@
+#define BOOST_TEST_MODULE FastAlignTest
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+// runs fast_align (the path of which is the argument of the test) with the
+// given arguments on input and returns the lines it writes
+struct FastAlign {
+  FastAlign() {
+    bin = boost::unit_test::framework::master_test_suite().argc == 2 ?
+        boost::unit_test::framework::master_test_suite().argv[1] : "./fast_align";
+    char d[] = "/tmp/fast_align_test.XXXXXX";
+    BOOST_REQUIRE(mkdtemp(d));
+    dir = d;
+    ofstream corpus((dir + "/corpus").c_str());
+    corpus << "das haus ||| the house\n"
+              "das buch ||| the book\n"
+              "ein buch ||| a book\n"
+              "ein haus ||| a house\n";
+  }
+  ~FastAlign() {
+    const string files[] = { "corpus", "params", "in", "out" };
+    for (unsigned i = 0; i < 4; ++i) unlink((dir + "/" + files[i]).c_str());
+    rmdir(dir.c_str());
+  }
+
+  vector<string> Run(const string& args, const string& input) {
+    {
+      ofstream in((dir + "/in").c_str());
+      in << input;
+    }
+    const string cmd = bin + " " + args + " < " + dir + "/in > " + dir + "/out 2> /dev/null";
+    BOOST_REQUIRE_EQUAL(system(cmd.c_str()), 0);
+    ifstream out((dir + "/out").c_str());
+    vector<string> lines;
+    string line;
+    while (getline(out, line)) lines.push_back(line);
+    return lines;
+  }
+
+  string bin;
+  string dir;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, FastAlign);
+
+BOOST_AUTO_TEST_CASE(BatchWithEmptyPair) {
+  Run("-i " + dir + "/corpus -d -o -v -p " + dir + "/params", "");
+  const string force = "-i - -d -o -v -f " + dir + "/params";
+  const string pairs[] = { "das haus ||| the house", "", "ein buch ||| a book" };
+
+  // one pair per line
+  string lines;
+  for (unsigned i = 0; i < 3; ++i) lines += pairs[i] + "\n";
+  const vector<string> single = Run(force, lines);
+  BOOST_REQUIRE_EQUAL(single.size(), 3u);
+  BOOST_CHECK_EQUAL(single[1].substr(0, 11), " |||  ||| |");
+
+  // the same pairs in two batches, the first of which holds the empty pair;
+  // each pair gets its own line of output and the batches stay in step
+  ostringstream batches;
+  batches << "2\n" << pairs[0] << '\n' << pairs[1] << '\n'
+          << "1\n" << pairs[2] << '\n' << "0\n";
+  const vector<string> batched = Run(force + " -b -j 2", batches.str());
+  BOOST_REQUIRE_EQUAL(batched.size(), 3u);
+  for (unsigned i = 0; i < 3; ++i)
+    BOOST_CHECK_EQUAL(batched[i], single[i]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,11 +6,29 @@
 
 using namespace std;
 
+void TTable::Assign(const Word2Word2Double& t) {
+  row_.assign(t.size() + 1, 0);
+  for (unsigned e = 0; e < t.size(); ++e)
+    row_[e + 1] = row_[e] + t[e].size();
+  cols_.resize(row_.back());
+  probs_.resize(row_.back());
+  vector<pair<WordID, double> > cpd;
+  for (unsigned e = 0; e < t.size(); ++e) {
+    cpd.assign(t[e].begin(), t[e].end());
+    sort(cpd.begin(), cpd.end());
+    for (unsigned i = 0; i < cpd.size(); ++i) {
+      cols_[row_[e] + i] = cpd[i].first;
+      probs_[row_[e] + i] = cpd[i].second;
+    }
+  }
+}
+
 void TTable::DeserializeProbsFromText(std::istream* in) {
   int c = 0;
   string e;
   string f;
   double p;
+  Word2Word2Double ttable;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
@@ -19,6 +37,7 @@ void TTable::DeserializeProbsFromText(std::istream* in) {
     if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
     ttable[ie][TD::Convert(f)] = p;
   }
+  Assign(ttable);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
@@ -27,6 +46,7 @@ void TTable::DeserializeLogProbsFromText(std::istream* in) {
   string e;
   string f;
   double p;
+  Word2Word2Double ttable;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
@@ -35,14 +55,6 @@ void TTable::DeserializeLogProbsFromText(std::istream* in) {
     if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
     ttable[ie][TD::Convert(f)] = exp(p);
   }
+  Assign(ttable);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
-
-void TTable::SerializeHelper(string* out, const Word2Word2Double& o) {
-  assert(!"not implemented");
-}
-
-void TTable::DeserializeHelper(const string& in, Word2Word2Double* o) {
-  assert(!"not implemented");
-}
-
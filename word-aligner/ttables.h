@@ -1,6 +1,7 @@
 #ifndef _TTABLES_H_
 #define _TTABLES_H_
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #ifndef HAVE_OLD_CPP
@@ -10,98 +11,83 @@
 namespace std { using std::tr1::unordered_map; }
 #endif
 
-#include "sparse_vector.h"
 #include "m.h"
 #include "wordid.h"
 #include "tdict.h"
 
+// Translation table p(f|e). The set of (e, f) pairs with a parameter is
+// fixed when the table is assigned (e.g. all pairs that co-occur in the
+// training corpus), after which the parameters are stored in compressed
+// sparse row form: the f's of row e are cols_[row_[e]] ... cols_[row_[e+1]-1]
+// in increasing order. Expected counts are kept outside the table in
+// vectors indexed like its parameters (see index()), so that every thread
+// can accumulate its own without locking.
 class TTable {
  public:
-  TTable() {}
   typedef std::unordered_map<WordID, double> Word2Double;
   typedef std::vector<Word2Double> Word2Word2Double;
-  inline double prob(const int& e, const int& f) const {
-    if (e < static_cast<int>(ttable.size())) {
-      const Word2Double& cpd = ttable[e];
-      const Word2Double::const_iterator it = cpd.find(f);
-      if (it == cpd.end()) return 1e-9;
-      return it->second;
-    } else {
-      return 1e-9;
-    }
-  }
-  inline void Increment(const int& e, const int& f) {
-    if (e >= static_cast<int>(ttable.size())) counts.resize(e + 1);
-    counts[e][f] += 1.0;
+  TTable() : row_(1, 0) {}
+
+  // replaces the table with the parameters in t
+  void Assign(const Word2Word2Double& t);
+
+  // the number of parameters, i.e. the size of a count vector
+  unsigned size() const { return cols_.size(); }
+  unsigned rows() const { return row_.size() - 1; }
+  unsigned row_begin(int e) const { return row_[e]; }
+  unsigned row_end(int e) const { return row_[e + 1]; }
+  WordID col(unsigned k) const { return cols_[k]; }
+  double param(unsigned k) const { return probs_[k]; }
+
+  // returns the index of p(f|e), or -1 if it is not a parameter
+  inline int index(const int& e, const int& f) const {
+    if (e >= static_cast<int>(rows())) return -1;
+    const WordID* b = cols_.data() + row_[e];
+    const WordID* end = cols_.data() + row_[e + 1];
+    const WordID* it = std::lower_bound(b, end, f);
+    if (it == end || *it != f) return -1;
+    return it - cols_.data();
   }
-  inline void Increment(const int& e, const int& f, double x) {
-    if (e >= static_cast<int>(counts.size())) counts.resize(e + 1);
-    counts[e][f] += x;
+  inline double prob(const int& e, const int& f) const {
+    const int k = index(e, f);
+    if (k < 0) return 1e-9;
+    return probs_[k];
   }
-  void NormalizeVB(const double alpha) {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
+
+  void NormalizeVB(const std::vector<double>& counts, const double alpha) {
+    for (unsigned e = 0; e < rows(); ++e) {
       double tot = 0;
-      Word2Double& cpd = ttable[i];
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        tot += it->second + alpha;
+      for (unsigned k = row_[e]; k < row_[e + 1]; ++k)
+        tot += counts[k] + alpha;
       if (!tot) tot = 1;
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        it->second = exp(Md::digamma(it->second + alpha) - Md::digamma(tot));
+      for (unsigned k = row_[e]; k < row_[e + 1]; ++k)
+        probs_[k] = exp(Md::digamma(counts[k] + alpha) - Md::digamma(tot));
     }
-    counts.clear();
   }
-  void Normalize() {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
+  void Normalize(const std::vector<double>& counts) {
+    for (unsigned e = 0; e < rows(); ++e) {
       double tot = 0;
-      Word2Double& cpd = ttable[i];
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        tot += it->second;
+      for (unsigned k = row_[e]; k < row_[e + 1]; ++k)
+        tot += counts[k];
       if (!tot) tot = 1;
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        it->second /= tot;
+      for (unsigned k = row_[e]; k < row_[e + 1]; ++k)
+        probs_[k] = counts[k] / tot;
     }
-    counts.clear();
-  }
-  // adds counts from another TTable - probabilities remain unchanged
-  TTable& operator+=(const TTable& rhs) {
-    if (rhs.counts.size() > counts.size()) counts.resize(rhs.counts.size());
-    for (unsigned i = 0; i < rhs.counts.size(); ++i) {
-      const Word2Double& cpd = rhs.counts[i];
-      Word2Double& tgt = counts[i];
-      for (auto p : cpd) tgt[p.first] += p.second;
-    }
-    return *this;
   }
   void ShowTTable() const {
-    for (unsigned it = 0; it < ttable.size(); ++it) {
-      const Word2Double& cpd = ttable[it];
-      for (auto& p : cpd) {
-        std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
-      }
-    }
-  }
-  void ShowCounts() const {
-    for (unsigned it = 0; it < counts.size(); ++it) {
-      const Word2Double& cpd = counts[it];
-      for (auto& p : cpd) {
-        std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
+    for (unsigned e = 0; e < rows(); ++e) {
+      for (unsigned k = row_[e]; k < row_[e + 1]; ++k) {
+        std::cerr << "c(" << TD::Convert(cols_[k]) << '|' << TD::Convert(e) << ") = " << probs_[k] << std::endl;
       }
     }
   }
   void DeserializeProbsFromText(std::istream* in);
   void DeserializeLogProbsFromText(std::istream* in);
-  void SerializeCounts(std::string* out) const { SerializeHelper(out, counts); }
-  void DeserializeCounts(const std::string& in) { DeserializeHelper(in, &counts); }
-  void SerializeProbs(std::string* out) const { SerializeHelper(out, ttable); }
-  void DeserializeProbs(const std::string& in) { DeserializeHelper(in, &ttable); }
+
  private:
-  static void SerializeHelper(std::string*, const Word2Word2Double& o);
-  static void DeserializeHelper(const std::string&, Word2Word2Double* o);
- public:
-  Word2Word2Double ttable;
-  Word2Word2Double counts;
+  std::vector<unsigned> row_;
+  std::vector<WordID> cols_;
+  std::vector<double> probs_;
 };
 
 #endif